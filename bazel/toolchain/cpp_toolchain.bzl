@@ -233,6 +233,9 @@ def _impl(ctx):
 
     opt_feature = feature(name = "opt")
 
+    # Builds C++ as C++20 instead of C++17. Enable with `--config=cpp20`.
+    cpp20_feature = feature(name = "c++20")
+
     fastbuild_feature = feature(name = "fastbuild")
 
     user_compile_flags_feature = feature(
@@ -368,7 +371,6 @@ def _impl(ctx):
                         flag_group(
                             flags = [
                                 "-Werror",
-                                "-std=c++17",
                                 "-Wall",
                                 "-B/usr/bin",
                                 "-B/usr/bin",
@@ -379,6 +381,16 @@ def _impl(ctx):
                         ),
                     ],
                 ),
+                flag_set(
+                    actions = all_cpp_compile_actions + [ACTION_NAMES.lto_backend],
+                    flag_groups = [flag_group(flags = ["-std=c++17"])],
+                    with_features = [with_feature_set(not_features = ["c++20"])],
+                ),
+                flag_set(
+                    actions = all_cpp_compile_actions + [ACTION_NAMES.lto_backend],
+                    flag_groups = [flag_group(flags = ["-std=c++20"])],
+                    with_features = [with_feature_set(features = ["c++20"])],
+                ),
             ],
         )
     else:
@@ -395,6 +407,7 @@ def _impl(ctx):
         supports_pic_feature,
         objcopy_embed_flags_feature,
         opt_feature,
+        cpp20_feature,
         dbg_feature,
         fastbuild_feature,
         user_compile_flags_feature,
@@ -0,0 +1,83 @@
+// Benchmark for building and discarding scratch maps, on the heap and in an
+// arena, and for building scratch keys, as std::string and in a StringArena.
+//
+// Run with: bazel run -c opt //bench:arena_bench
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "nectar/arena.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+// Keys long enough to defeat the small-string optimization.
+std::vector<std::string> MakeKeys(size_t n) {
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < n; ++i)
+    keys.push_back("scratch/key/" + std::to_string(i * 7919) + "/abcdefghij");
+  return keys;
+}
+
+void BM_StringMap(benchmark::State& state) {
+  auto keys = MakeKeys(state.range(0));
+  for (auto _ : state) {
+    StringMap<int> m;
+    for (auto& key : keys) MakeMapKey(m, std::string_view(key)).Assign(1);
+    benchmark::DoNotOptimize(m);
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_StringMap)->RangeMultiplier(4)->Range(16, 4096);
+
+void BM_ArenaStringMap(benchmark::State& state) {
+  auto keys = MakeKeys(state.range(0));
+  Arena arena;
+  for (auto _ : state) {
+    {
+      ArenaStringMap<int> m(&arena);
+      for (auto& key : keys) MakeMapKey(m, std::string_view(key)).Assign(1);
+      benchmark::DoNotOptimize(m);
+    }
+    arena.Reset();
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_ArenaStringMap)->RangeMultiplier(4)->Range(16, 4096);
+
+// Concatenated and formatted keys, as made per request.
+void BM_StringKeys(benchmark::State& state) {
+  auto keys = MakeKeys(state.range(0));
+  for (auto _ : state) {
+    std::vector<std::string> built;
+    built.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      built.push_back(keys[i] + ":" + std::to_string(i));
+      benchmark::DoNotOptimize(built.back().c_str());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_StringKeys)->RangeMultiplier(4)->Range(16, 4096);
+
+void BM_StringArenaKeys(benchmark::State& state) {
+  auto keys = MakeKeys(state.range(0));
+  StringArena strings;
+  for (auto _ : state) {
+    std::vector<cstring_view> built;
+    built.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      auto builder = strings.Build();
+      builder.Append(keys[i]).Append(':').AppendInt(i);
+      built.push_back(builder.Finish());
+      benchmark::DoNotOptimize(built.back().c_str());
+    }
+    strings.Reset();
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+BENCHMARK(BM_StringArenaKeys)->RangeMultiplier(4)->Range(16, 4096);
+
+}  // namespace
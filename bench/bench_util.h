@@ -0,0 +1,126 @@
+// Shared workloads for benchmarks: realistic keys and access patterns.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace beeswax::nectar::bench {
+
+// Returns `n` distinct keys of varied length, from `min_len` to `max_len`,
+// skewed towards the short end, as identifiers, hostnames and paths are. Each
+// starts with a shared prefix, as keys from one source tend to, and ends with
+// its index, so they're distinct.
+inline std::vector<std::string> MakeKeys(size_t n,
+                                         size_t min_len = 8,
+                                         size_t max_len = 64,
+                                         uint64_t seed = 1) {
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> unit(0, 1);
+  std::vector<std::string> keys;
+  keys.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    auto id = std::to_string(i);
+    auto u = unit(rng);
+    auto len = min_len + static_cast<size_t>(u * u * (max_len - min_len));
+    std::string key = "seg/";
+    while (key.size() + id.size() < len)
+      key.push_back("abcdefghijklmnopqrstuvwxyz-_"[rng() % 28]);
+    key += id;
+    keys.push_back(std::move(key));
+  }
+  return keys;
+}
+
+// Draws ranks from 0 to n - 1 following Zipf's law with exponent `s`, so that
+// rank k is drawn in proportion to 1 / (k + 1)^s. Web traffic, ad campaigns
+// and cache keys typically have s close to 1.
+//
+// Uses rejection-inversion sampling, which takes constant time and memory,
+// however large n is. See Hörmann and Derflinger, "Rejection-inversion to
+// generate variates from monotone discrete distributions", 1996.
+class ZipfDistribution {
+ public:
+  ZipfDistribution(size_t n, double s = 0.99)
+      : n_(n),
+        s_(s),
+        h_x1_(H(1.5) - 1),
+        h_n_(H(n + 0.5)),
+        cut_(2 - HInverse(H(2.5) - std::exp(-s * std::log(2.0)))) {}
+
+  template <typename Rng>
+  size_t operator()(Rng& rng) {
+    std::uniform_real_distribution<double> unit(0, 1);
+    while (true) {
+      double u = h_n_ + unit(rng) * (h_x1_ - h_n_);
+      double x = HInverse(u);
+      auto k = static_cast<double>(static_cast<uint64_t>(x + 0.5));
+      k = std::clamp(k, 1.0, static_cast<double>(n_));
+      if (k - x <= cut_ || u >= H(k + 0.5) - std::exp(-s_ * std::log(k)))
+        return static_cast<size_t>(k) - 1;
+    }
+  }
+
+ private:
+  // Integral of x^-s, shifted so that it's well-behaved as s approaches 1.
+  double H(double x) const {
+    double log_x = std::log(x);
+    return ExpM1Over((1 - s_) * log_x) * log_x;
+  }
+
+  double HInverse(double x) const {
+    double t = std::max(x * (1 - s_), -1.0);
+    return std::exp(Log1POver(t) * x);
+  }
+
+  // Returns expm1(x) / x, and log1p(x) / x, accurately near 0.
+  static double ExpM1Over(double x) {
+    return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1 + x / 2;
+  }
+  static double Log1POver(double x) {
+    return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1 - x / 2;
+  }
+
+  size_t n_;
+  double s_;
+  double h_x1_;
+  double h_n_;
+  double cut_;
+};
+
+// Key distributions for benchmark arguments.
+enum class Distribution { kUniform, kZipf };
+
+// Returns `count` indexes into `n` keys, drawn from distribution. For Zipf,
+// ranks are shuffled over the keys, so that the hot keys are scattered rather
+// than being the first inserted.
+inline std::vector<size_t> MakeIndexes(size_t n,
+                                       size_t count,
+                                       Distribution dist,
+                                       uint64_t seed = 2) {
+  std::mt19937_64 rng(seed);
+  std::vector<size_t> indexes;
+  indexes.reserve(count);
+  if (dist == Distribution::kUniform) {
+    std::uniform_int_distribution<size_t> uniform(0, n - 1);
+    for (size_t i = 0; i < count; ++i) indexes.push_back(uniform(rng));
+  } else {
+    std::vector<size_t> by_rank(n);
+    std::iota(by_rank.begin(), by_rank.end(), 0);
+    std::shuffle(by_rank.begin(), by_rank.end(), rng);
+    ZipfDistribution zipf(n);
+    for (size_t i = 0; i < count; ++i) indexes.push_back(by_rank[zipf(rng)]);
+  }
+  return indexes;
+}
+
+inline const char* DistributionName(Distribution dist) {
+  return dist == Distribution::kUniform ? "uniform" : "zipf";
+}
+
+}  // namespace beeswax::nectar::bench
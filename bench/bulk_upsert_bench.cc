@@ -0,0 +1,83 @@
+// Benchmark for loading a sorted feed into a StringMap: BulkUpsert, against
+// MakeMapKey for each key, both into an empty map and reloading over a full
+// one.
+//
+// Run with: bazel run -c opt //bench:bulk_upsert_bench
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "nectar/collections.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+using Feed = std::vector<std::pair<std::string, int>>;
+
+Feed MakeFeed(size_t n) {
+  Feed feed;
+  for (size_t i = 0; i < n; ++i)
+    feed.emplace_back("campaign-" + std::to_string(1000000 + i), i);
+  return feed;
+}
+
+template <bool kReload>
+void BM_MapKey(benchmark::State& state) {
+  const auto feed = MakeFeed(state.range(0));
+  for (auto _ : state) {
+    state.PauseTiming();
+    StringMap<int> m;
+    if (kReload) m.insert(feed.begin(), feed.end());
+    state.ResumeTiming();
+    for (auto& [k, v] : feed) MakeMapKey(m, k).Assign(v);
+    benchmark::DoNotOptimize(m);
+    state.PauseTiming();
+    m = {};
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * feed.size());
+}
+
+template <bool kReload>
+void BM_BulkUpsert(benchmark::State& state) {
+  const auto feed = MakeFeed(state.range(0));
+  for (auto _ : state) {
+    state.PauseTiming();
+    StringMap<int> m;
+    if (kReload) m.insert(feed.begin(), feed.end());
+    state.ResumeTiming();
+    BulkUpsert(m, feed);
+    benchmark::DoNotOptimize(m);
+    state.PauseTiming();
+    m = {};
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * feed.size());
+}
+
+BENCHMARK_TEMPLATE(BM_MapKey, false)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_BulkUpsert, false)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_MapKey, true)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_BulkUpsert, true)->Range(1 << 10, 1 << 20);
+
+// Merging two maps, half of whose keys overlap.
+void BM_MergeInto(benchmark::State& state) {
+  const auto feed = MakeFeed(state.range(0));
+  StringMap<int> src(feed.begin() + feed.size() / 2, feed.end());
+  for (auto _ : state) {
+    state.PauseTiming();
+    StringMap<int> dst(feed.begin(), feed.begin() + feed.size() * 3 / 4);
+    state.ResumeTiming();
+    MergeInto(dst, src);
+    benchmark::DoNotOptimize(dst);
+    state.PauseTiming();
+    dst = {};
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_MergeInto)->Range(1 << 10, 1 << 20);
+
+}  // namespace
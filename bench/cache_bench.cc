@@ -0,0 +1,110 @@
+// Benchmark for memoizing an expensive computation in a shared, bounded
+// cache: ConcurrentStringCache, against the usual LRU of a list and a hash map
+// behind one mutex, as threads scale.
+//
+// Keys are drawn from 64K following Zipf's law, into a cache of 8K entries,
+// and a miss costs hashing a few KB, as a stand-in for evaluating targeting.
+//
+// Run with: bazel run -c opt //bench:cache_bench
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "bench/bench_util.h"
+#include "benchmark/benchmark.h"
+#include "nectar/cache.h"
+#include "nectar/collections.h"
+#include "nectar/hash.h"
+#include "nectar/hash_map.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+constexpr size_t kKeys = 1 << 16;
+constexpr size_t kCapacity = 1 << 13;
+constexpr size_t kQueries = 1 << 16;
+
+const std::vector<std::string>& Keys() {
+  static const auto* keys =
+      new std::vector<std::string>(bench::MakeKeys(kKeys));
+  return *keys;
+}
+
+const std::vector<size_t>& Queries() {
+  static const auto* queries = new std::vector<size_t>(
+      bench::MakeIndexes(kKeys, kQueries, bench::Distribution::kZipf));
+  return *queries;
+}
+
+uint64_t Evaluate(std::string_view key) {
+  static const std::string kRules(4096, 'r');
+  return Hash64(kRules, Hash64(key));
+}
+
+// The whole cache behind one mutex, with hits moving their entry to the
+// front of the list.
+class LockedLruCache {
+ public:
+  template <typename Cb>
+  uint64_t GetOrCompute(std::string_view k, Cb cb) {
+    {
+      std::lock_guard lock(mutex_);
+      if (auto* it = FindPtr(index_, k)) {
+        order_.splice(order_.begin(), order_, *it);
+        return (*it)->second;
+      }
+    }
+    auto value = cb();
+    std::lock_guard lock(mutex_);
+    if (FindPtr(index_, k)) return value;
+    if (order_.size() >= kCapacity) {
+      index_.erase(order_.back().first);
+      order_.pop_back();
+    }
+    order_.emplace_front(std::string(k), value);
+    index_.try_emplace(order_.front().first, order_.begin());
+    return value;
+  }
+
+ private:
+  using Order = std::list<std::pair<std::string, uint64_t>>;
+
+  std::mutex mutex_;
+  Order order_;
+  StringHashMap<Order::iterator> index_;
+};
+
+template <typename CacheT>
+void BM_GetOrCompute(benchmark::State& state) {
+  static CacheT* c;
+  if (state.thread_index() == 0) {
+    if constexpr (std::is_same_v<CacheT, LockedLruCache>)
+      c = new CacheT;
+    else
+      c = new CacheT(kCapacity);
+  }
+  const auto& keys = Keys();
+  const auto& queries = Queries();
+  size_t i = state.thread_index() * 7919;
+  for (auto _ : state) {
+    std::string_view k = keys[queries[i++ % kQueries]];
+    benchmark::DoNotOptimize(c->GetOrCompute(k, [&] { return Evaluate(k); }));
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) delete c;
+}
+
+BENCHMARK_TEMPLATE(BM_GetOrCompute, LockedLruCache)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_GetOrCompute, ConcurrentStringCache<uint64_t>)
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,276 @@
+// Benchmark for the everyday operations in collections.h, FindPtr,
+// FindOrDefault, MapKey upsert, erase_if and RetainKeys, on nectar's
+// string-keyed maps against std::map and std::unordered_map, and the same key
+// looked up in several maps, hashing it once with HashedStringView. Also,
+// sequential integer ids in FlatHashMap against std::unordered_map.
+//
+// Keys vary in length, from 8 to 64 bytes, and are looked up either uniformly
+// or following Zipf's law, over maps from 10 to 10M entries. Lookups are by
+// std::string_view, as when parsing requests, so maps without transparent
+// lookup pay for making a std::string each time.
+//
+// Run with: bazel run -c opt //bench:collections_bench
+// For JSON results, see bench/run_benchmarks.sh.
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bench/bench_util.h"
+#include "benchmark/benchmark.h"
+#include "nectar/collections.h"
+#include "nectar/cpp20.h"
+#include "nectar/flat_map.h"
+#include "nectar/hash_map.h"
+
+namespace {
+
+using namespace beeswax::nectar;         // NOLINT
+using namespace beeswax::nectar::bench;  // NOLINT
+
+using StdMap = std::map<std::string, uint64_t>;
+using StdUnorderedMap = std::unordered_map<std::string, uint64_t>;
+
+// Lookups cycle through this many precomputed keys.
+constexpr size_t kQueries = 1 << 20;
+
+// Whether map can be searched by std::string_view without making a key.
+template <typename MapT, typename = void>
+constexpr bool kTransparent = false;
+
+template <typename MapT>
+constexpr bool kTransparent<
+    MapT,
+    std::void_t<decltype(std::declval<const MapT&>().find(
+        std::declval<std::string_view>()))>> = true;
+
+// Returns the key to search with, as the caller would have to.
+template <typename MapT>
+auto AsKey(std::string_view k) {
+  if constexpr (kTransparent<MapT>)
+    return k;
+  else
+    return std::string(k);
+}
+
+template <typename MapT>
+MapT MakeMap(const std::vector<std::string>& keys) {
+  MapT m;
+  if constexpr (std::is_same_v<MapT, StringFlatMap<uint64_t>>) {
+    std::vector<std::pair<std::string, uint64_t>> items;
+    for (size_t i = 0; i < keys.size(); ++i) items.emplace_back(keys[i], i);
+    m = MapT(items.begin(), items.end());
+  } else {
+    for (size_t i = 0; i < keys.size(); ++i) m.try_emplace(keys[i], i);
+  }
+  return m;
+}
+
+// A map of the keys, and queries into separate copies of them, drawn from
+// the distribution. A `miss_rate` of the queries are for keys not in the map.
+template <typename MapT>
+struct Fixture {
+  Fixture(benchmark::State& state, double miss_rate = 0)
+      : keys(MakeKeys(state.range(0))), map(MakeMap<MapT>(keys)) {
+    auto dist = static_cast<Distribution>(state.range(1));
+    state.SetLabel(DistributionName(dist));
+    auto misses = MakeKeys(keys.size(), 8, 64, 3);
+    for (auto& k : misses) k.insert(0, "miss/");
+    std::mt19937_64 rng(4);
+    std::uniform_real_distribution<double> unit(0, 1);
+    for (auto i : MakeIndexes(keys.size(), kQueries, dist)) {
+      const auto& k = unit(rng) < miss_rate ? misses[i] : keys[i];
+      queries.push_back(k);
+    }
+  }
+
+  std::vector<std::string> keys;
+  MapT map;
+  std::vector<std::string> queries;
+};
+
+template <typename MapT>
+void BM_FindPtr(benchmark::State& state) {
+  const Fixture<MapT> f(state);
+  size_t i = 0;
+  for (auto _ : state) {
+    std::string_view k = f.queries[i++ % kQueries];
+    benchmark::DoNotOptimize(FindPtr(f.map, AsKey<MapT>(k)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+template <typename MapT>
+void BM_FindOrDefault(benchmark::State& state) {
+  const Fixture<MapT> f(state, 0.2);
+  size_t i = 0;
+  for (auto _ : state) {
+    std::string_view k = f.queries[i++ % kQueries];
+    benchmark::DoNotOptimize(FindOrDefault(f.map, AsKey<MapT>(k)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Counting hits, as for frequency caps: starts empty, so that the first hit
+// on each key inserts and the rest update.
+template <typename MapT>
+void BM_MapKeyUpsert(benchmark::State& state) {
+  Fixture<MapT> f(state);
+  f.map = MapT();
+  size_t i = 0;
+  for (auto _ : state) {
+    std::string_view k = f.queries[i++ % kQueries];
+    auto key = AsKey<MapT>(k);
+    ++*BasicMapKey<MapT, decltype(key)>(f.map, std::move(key));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Erasing every other entry.
+template <typename MapT>
+void BM_EraseIf(benchmark::State& state) {
+  const auto keys = MakeKeys(state.range(0));
+  auto odd = [](const auto& kv) { return kv.second % 2; };
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto m = MakeMap<MapT>(keys);
+    state.ResumeTiming();
+    if constexpr (std::is_same_v<MapT, StdMap> ||
+                  std::is_same_v<MapT, StringMap<uint64_t>>) {
+      erase_if(m, odd);
+    } else {
+      for (auto it = m.begin(); it != m.end();) {
+        if (odd(*it))
+          it = m.erase(it);
+        else
+          ++it;
+      }
+    }
+    benchmark::DoNotOptimize(m);
+    state.PauseTiming();
+    m = MapT();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+// Pruning against the active ids, a tenth of the keys having gone: by
+// erase_if with a search of the ids for each entry, or RetainKeys, merging
+// with ordered ids, or looking up hashed ones.
+enum class Prune { kEraseIf, kMerge, kHashed };
+
+template <Prune kPrune>
+void BM_RetainKeys(benchmark::State& state) {
+  const auto keys = MakeKeys(state.range(0));
+  std::set<std::string, TransparentLessString> active;
+  StringUnorderedSet<> hashed;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (i % 10 == 3) continue;
+    active.insert(keys[i]);
+    hashed.insert(keys[i]);
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto m = MakeMap<StringMap<uint64_t>>(keys);
+    state.ResumeTiming();
+    if constexpr (kPrune == Prune::kEraseIf)
+      erase_if(m, [&](auto& kv) { return !contains(active, kv.first); });
+    else if constexpr (kPrune == Prune::kMerge)
+      RetainKeys(m, active);
+    else
+      RetainKeys(m, hashed);
+    benchmark::DoNotOptimize(m);
+    state.PauseTiming();
+    m = StringMap<uint64_t>();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+BENCHMARK_TEMPLATE(BM_RetainKeys, Prune::kEraseIf)->Range(1000, 1000000);
+BENCHMARK_TEMPLATE(BM_RetainKeys, Prune::kMerge)->Range(1000, 1000000);
+BENCHMARK_TEMPLATE(BM_RetainKeys, Prune::kHashed)->Range(1000, 1000000);
+
+// Each query looked up in five maps, as when a request key is checked against
+// several tables: hashed by each map, or once up front.
+template <bool kHashed>
+void BM_FindInMaps(benchmark::State& state) {
+  constexpr size_t kMaps = 5;
+  const Fixture<StringHashMap<uint64_t>> f(state, 0.2);
+  std::vector<StringHashMap<uint64_t>> maps(kMaps, f.map);
+  size_t i = 0;
+  for (auto _ : state) {
+    std::string_view k = f.queries[i++ % kQueries];
+    uint64_t total = 0;
+    if constexpr (kHashed) {
+      const HashedStringView key(k);
+      for (auto& m : maps) total += FindOrDefault(m, key);
+    } else {
+      for (auto& m : maps) total += FindOrDefault(m, k);
+    }
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_FindInMaps, false)->Args({1000, 0})->Args({100000, 0});
+BENCHMARK_TEMPLATE(BM_FindInMaps, true)->Args({1000, 0})->Args({100000, 0});
+
+// Sequential integer ids, as from an auto-increment column, counted with
+// MapKey and then looked up. std::hash leaves them as they are, so a map that
+// indexes by the hash's bits without mixing them piles them into a few groups.
+template <typename MapT>
+void BM_SequentialIds(benchmark::State& state) {
+  const auto n = static_cast<uint64_t>(state.range(0));
+  for (auto _ : state) {
+    MapT m;
+    for (uint64_t id = 0; id < n; ++id)
+      ++*BasicMapKey<MapT, const uint64_t&>(m, id);
+    uint64_t total = 0;
+    for (uint64_t id = 0; id < n; ++id) total += FindOrDefault(m, id);
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+using StdIdMap = std::unordered_map<uint64_t, uint64_t>;
+using IdHashMap = FlatHashMap<uint64_t, uint64_t>;
+
+BENCHMARK_TEMPLATE(BM_SequentialIds, StdIdMap)->Range(1000, 1000000);
+BENCHMARK_TEMPLATE(BM_SequentialIds, IdHashMap)->Range(1000, 1000000);
+
+// Sizes from 10 to 10M, for each distribution.
+void Sizes(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"size", "dist"});
+  for (int64_t dist : {0, 1}) {
+    for (int64_t n = 10; n <= 10000000; n *= 10) b->Args({n, dist});
+  }
+}
+
+#define NECTAR_LOOKUP_BENCHMARKS(MapT)                      \
+  BENCHMARK_TEMPLATE(BM_FindPtr, MapT)->Apply(Sizes);       \
+  BENCHMARK_TEMPLATE(BM_FindOrDefault, MapT)->Apply(Sizes); \
+  BENCHMARK_TEMPLATE(BM_MapKeyUpsert, MapT)->Apply(Sizes)
+
+NECTAR_LOOKUP_BENCHMARKS(StdMap);
+NECTAR_LOOKUP_BENCHMARKS(StringMap<uint64_t>);
+NECTAR_LOOKUP_BENCHMARKS(StdUnorderedMap);
+NECTAR_LOOKUP_BENCHMARKS(StringUnorderedMap<uint64_t>);
+NECTAR_LOOKUP_BENCHMARKS(StringHashMap<uint64_t>);
+
+// StringFlatMap is only searched, since inserting into and erasing from the
+// middle is linear.
+BENCHMARK_TEMPLATE(BM_FindPtr, StringFlatMap<uint64_t>)->Apply(Sizes);
+BENCHMARK_TEMPLATE(BM_FindOrDefault, StringFlatMap<uint64_t>)->Apply(Sizes);
+
+BENCHMARK_TEMPLATE(BM_EraseIf, StdMap)->Range(10, 1000000);
+BENCHMARK_TEMPLATE(BM_EraseIf, StringMap<uint64_t>)->Range(10, 1000000);
+BENCHMARK_TEMPLATE(BM_EraseIf, StdUnorderedMap)->Range(10, 1000000);
+BENCHMARK_TEMPLATE(BM_EraseIf, StringHashMap<uint64_t>)->Range(10, 1000000);
+
+}  // namespace
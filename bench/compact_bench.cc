@@ -0,0 +1,105 @@
+// Benchmark for erasing from vectors of trivially copyable elements by
+// predicate, as in filter passes: std::remove_if against erase_if, which
+// compacts in batches, and a structure of arrays filtered on one column, by
+// hand against EraseRowsIf.
+//
+// Values are random, so that the predicate's result can't be predicted, and
+// the selectivity, the per mille of elements erased, ranges from none to all.
+//
+// Run with: bazel run -c opt //bench:compact_bench
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "nectar/compact.h"
+#include "nectar/cpp20.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+constexpr size_t kSize = 1 << 20;
+
+// Returns values from 0 to 999.
+template <typename T>
+std::vector<T> MakeValues(size_t n) {
+  std::mt19937_64 rng(1);
+  std::uniform_int_distribution<int> value(0, 999);
+  std::vector<T> v(n);
+  for (auto& e : v) e = value(rng);
+  return v;
+}
+
+template <typename T, bool kCompact>
+void BM_EraseIf(benchmark::State& state) {
+  const auto values = MakeValues<T>(kSize);
+  const T per_mille = state.range(0);
+  auto erased = [=](T e) { return e < per_mille; };
+  std::vector<T> v;
+  v.reserve(kSize);
+  for (auto _ : state) {
+    state.PauseTiming();
+    v.assign(values.begin(), values.end());
+    state.ResumeTiming();
+    if constexpr (kCompact)
+      erase_if(v, erased);
+    else
+      v.erase(std::remove_if(v.begin(), v.end(), erased), v.end());
+    benchmark::DoNotOptimize(v.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kSize);
+}
+
+// Bids as columns, filtered by price.
+template <bool kCompact>
+void BM_EraseRowsIf(benchmark::State& state) {
+  const auto prices = MakeValues<int64_t>(kSize);
+  const auto campaigns = MakeValues<int32_t>(kSize);
+  const auto scores = MakeValues<double>(kSize);
+  const int64_t per_mille = state.range(0);
+  std::vector<int64_t> price;
+  std::vector<int32_t> campaign;
+  std::vector<double> score;
+  for (auto _ : state) {
+    state.PauseTiming();
+    price = prices;
+    campaign = campaigns;
+    score = scores;
+    state.ResumeTiming();
+    if constexpr (kCompact) {
+      EraseRowsIf(
+          price, [=](int64_t p) { return p < per_mille; }, campaign, score);
+    } else {
+      size_t k = 0;
+      for (size_t i = 0; i < price.size(); ++i) {
+        if (price[i] < per_mille) continue;
+        price[k] = price[i];
+        campaign[k] = campaign[i];
+        score[k++] = score[i];
+      }
+      price.resize(k);
+      campaign.resize(k);
+      score.resize(k);
+    }
+    benchmark::DoNotOptimize(price.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kSize);
+}
+
+void Selectivities(benchmark::internal::Benchmark* b) {
+  b->ArgName("per_mille");
+  for (int64_t s : {0, 10, 100, 500, 900, 990, 1000}) b->Arg(s);
+}
+
+BENCHMARK_TEMPLATE(BM_EraseIf, int64_t, false)->Apply(Selectivities);
+BENCHMARK_TEMPLATE(BM_EraseIf, int64_t, true)->Apply(Selectivities);
+BENCHMARK_TEMPLATE(BM_EraseIf, int32_t, false)->Apply(Selectivities);
+BENCHMARK_TEMPLATE(BM_EraseIf, int32_t, true)->Apply(Selectivities);
+BENCHMARK_TEMPLATE(BM_EraseIf, int16_t, false)->Apply(Selectivities);
+BENCHMARK_TEMPLATE(BM_EraseIf, int16_t, true)->Apply(Selectivities);
+BENCHMARK_TEMPLATE(BM_EraseRowsIf, false)->Apply(Selectivities);
+BENCHMARK_TEMPLATE(BM_EraseRowsIf, true)->Apply(Selectivities);
+
+}  // namespace
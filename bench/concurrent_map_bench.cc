@@ -0,0 +1,83 @@
+// Benchmark for a map shared between threads: ConcurrentStringMap, against a
+// StringHashMap behind one reader/writer lock, as threads scale from 1 to 64.
+//
+// Each thread does a mix of 90% lookups and 10% upserts over 64K keys.
+//
+// Run with: bazel run -c opt //bench:concurrent_map_bench
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "nectar/collections.h"
+#include "nectar/concurrent_map.h"
+#include "nectar/hash_map.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+constexpr size_t kKeys = 1 << 16;
+
+const std::vector<std::string>& Keys() {
+  static const auto* keys = [] {
+    auto* keys = new std::vector<std::string>;
+    for (size_t i = 0; i < kKeys; ++i)
+      keys->push_back("campaign-" + std::to_string(i));
+    return keys;
+  }();
+  return *keys;
+}
+
+// The whole map behind one lock, as before.
+class LockedStringMap {
+ public:
+  std::optional<int64_t> Find(const std::string& k) const {
+    std::shared_lock lock(mutex_);
+    if (auto* v = FindPtr(map_, k)) return *v;
+    return std::nullopt;
+  }
+
+  bool Upsert(const std::string& k, int64_t v) {
+    std::unique_lock lock(mutex_);
+    return MakeMapKey(map_, k).Assign(v);
+  }
+
+ private:
+  mutable std::shared_mutex mutex_;
+  StringHashMap<int64_t> map_;
+};
+
+template <typename MapT>
+void BM_Mixed(benchmark::State& state) {
+  static MapT* m;
+  if (state.thread_index() == 0) {
+    m = new MapT;
+    for (auto& k : Keys()) m->Upsert(k, 0);
+  }
+  const auto& keys = Keys();
+  std::mt19937_64 rng(state.thread_index());
+  for (auto _ : state) {
+    auto r = rng();
+    auto& k = keys[r % kKeys];
+    if ((r >> 32) % 10 == 0)
+      m->Upsert(k, static_cast<int64_t>(r));
+    else
+      benchmark::DoNotOptimize(m->Find(k));
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) delete m;
+}
+
+BENCHMARK_TEMPLATE(BM_Mixed, LockedStringMap)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Mixed, ConcurrentStringMap<int64_t>)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,85 @@
+// Benchmark for constructing cstring_view, against std::string_view and
+// copying into a std::string, the usual way to get a terminated string, over
+// key lengths. ToCString makes the same copy without allocating, for short
+// keys.
+//
+// Run with: bazel run -c opt //bench:cstring_view_bench
+#include <string>
+#include <string_view>
+
+#include "bench/bench_util.h"
+#include "benchmark/benchmark.h"
+#include "nectar/cstring_view.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+std::string MakeKey(size_t len) {
+  return bench::MakeKeys(1, len, len).front();
+}
+
+// From a C string, which has to find the length.
+void BM_StringViewFromCStr(benchmark::State& state) {
+  auto key = MakeKey(state.range(0));
+  const char* p = key.c_str();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(p);
+    benchmark::DoNotOptimize(std::string_view(p));
+  }
+}
+BENCHMARK(BM_StringViewFromCStr)->Range(8, 1024);
+
+void BM_CStringViewFromCStr(benchmark::State& state) {
+  auto key = MakeKey(state.range(0));
+  const char* p = key.c_str();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(p);
+    benchmark::DoNotOptimize(cstring_view(p));
+  }
+}
+BENCHMARK(BM_CStringViewFromCStr)->Range(8, 1024);
+
+// From a pointer and length, which checks for the terminator.
+void BM_CStringViewFromPtrLen(benchmark::State& state) {
+  auto key = MakeKey(state.range(0));
+  const char* p = key.c_str();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(p);
+    benchmark::DoNotOptimize(cstring_view(p, key.size()));
+  }
+}
+BENCHMARK(BM_CStringViewFromPtrLen)->Range(8, 1024);
+
+void BM_CStringViewFromString(benchmark::State& state) {
+  auto key = MakeKey(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(key);
+    benchmark::DoNotOptimize(cstring_view(key));
+  }
+}
+BENCHMARK(BM_CStringViewFromString)->Range(8, 1024);
+
+// Terminating a std::string_view the hard way.
+void BM_StringFromStringView(benchmark::State& state) {
+  auto key = MakeKey(state.range(0));
+  std::string_view sv = key;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(sv);
+    benchmark::DoNotOptimize(std::string(sv));
+  }
+}
+BENCHMARK(BM_StringFromStringView)->Range(8, 1024);
+
+void BM_ToCString(benchmark::State& state) {
+  auto key = MakeKey(state.range(0));
+  std::string_view sv = key;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(sv);
+    auto copy = ToCString(sv);
+    benchmark::DoNotOptimize(copy.c_str());
+  }
+}
+BENCHMARK(BM_ToCString)->Range(8, 1024);
+
+}  // namespace
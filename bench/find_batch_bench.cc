@@ -0,0 +1,95 @@
+// Benchmark for batched lookups with FindPtrBatch, against a loop of FindPtr,
+// on maps that fit in cache and maps that don't.
+//
+// Run with: bazel run -c opt //bench:find_batch_bench
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "nectar/collections.h"
+#include "nectar/flat_map.h"
+#include "nectar/hash_map.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+constexpr size_t kBatchSize = 256;
+constexpr size_t kBatches = 64;
+
+// Integer keys are sequential ids, as from an auto-increment column, and left
+// for the map's hashing to spread out.
+template <typename KeyT>
+KeyT MakeKey(uint64_t i) {
+  if constexpr (std::is_same_v<KeyT, std::string>)
+    return "segment-" + std::to_string(i);
+  else
+    return i;
+}
+
+// A map of `n` entries, and batches of random keys, about 90% of them present.
+template <typename MapT, typename KeyT>
+struct Fixture {
+  explicit Fixture(size_t n) : batches(kBatches) {
+    std::vector<std::pair<KeyT, uint64_t>> items;
+    for (size_t i = 0; i < n; ++i) items.emplace_back(MakeKey<KeyT>(i), i);
+    map = MapT(items.begin(), items.end());
+    std::mt19937_64 rng(42);
+    for (auto& batch : batches) {
+      for (size_t i = 0; i < kBatchSize; ++i)
+        batch.push_back(MakeKey<KeyT>(rng() % (n + n / 9)));
+    }
+  }
+
+  MapT map;
+  std::vector<std::vector<KeyT>> batches;
+};
+
+template <typename MapT, typename KeyT>
+void BM_Loop(benchmark::State& state) {
+  const Fixture<MapT, KeyT> f(state.range(0));
+  std::vector<const uint64_t*> out(kBatchSize);
+  size_t b = 0;
+  for (auto _ : state) {
+    const auto& keys = f.batches[b++ % kBatches];
+    for (size_t i = 0; i < kBatchSize; ++i) out[i] = FindPtr(f.map, keys[i]);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+template <typename MapT, typename KeyT>
+void BM_Batch(benchmark::State& state) {
+  const Fixture<MapT, KeyT> f(state.range(0));
+  std::vector<const uint64_t*> out(kBatchSize);
+  size_t b = 0;
+  for (auto _ : state) {
+    FindPtrBatch(f.map, f.batches[b++ % kBatches], out);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+using IntHashMap = FlatHashMap<uint64_t, uint64_t>;
+using IntMap = std::map<uint64_t, uint64_t>;
+
+BENCHMARK_TEMPLATE(BM_Loop, IntHashMap, uint64_t)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_Batch, IntHashMap, uint64_t)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_Loop, StringHashMap<uint64_t>, std::string)
+    ->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_Batch, StringHashMap<uint64_t>, std::string)
+    ->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_Loop, StringFlatMap<uint64_t>, std::string)
+    ->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_Batch, StringFlatMap<uint64_t>, std::string)
+    ->Range(1 << 10, 1 << 20);
+// No batched lookup, so these should be the same.
+BENCHMARK_TEMPLATE(BM_Loop, IntMap, uint64_t)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_Batch, IntMap, uint64_t)->Range(1 << 10, 1 << 20);
+
+}  // namespace
@@ -0,0 +1,62 @@
+// Benchmark for lookups in a small fixed table of header names.
+//
+// Run with: bazel run -c opt //bench:frozen_map_bench
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "nectar/collections.h"
+#include "nectar/frozen_map.h"
+#include "nectar/hash_map.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+constexpr auto kHeaders = MakeFrozenMap<int>({
+    {"accept"_sz, 1},          {"accept-encoding"_sz, 2},
+    {"accept-language"_sz, 3}, {"cache-control"_sz, 4},
+    {"connection"_sz, 5},      {"content-length"_sz, 6},
+    {"content-type"_sz, 7},    {"cookie"_sz, 8},
+    {"host"_sz, 9},            {"origin"_sz, 10},
+    {"referer"_sz, 11},        {"user-agent"_sz, 12},
+    {"x-forwarded-for"_sz, 13}, {"x-request-id"_sz, 14},
+});
+
+// Every header, plus as many misses.
+std::vector<std::string> MakeQueries() {
+  std::vector<std::string> queries;
+  for (auto& [k, v] : kHeaders) {
+    queries.emplace_back(k);
+    queries.push_back("x-custom-" + std::string(k));
+  }
+  return queries;
+}
+
+template <typename MapT>
+void Lookup(benchmark::State& state, const MapT& m) {
+  auto queries = MakeQueries();
+  for (auto _ : state) {
+    for (auto& q : queries)
+      benchmark::DoNotOptimize(FindOrDefault(m, std::string_view(q)));
+  }
+  state.SetItemsProcessed(state.iterations() * queries.size());
+}
+
+void BM_FrozenMap(benchmark::State& state) { Lookup(state, kHeaders); }
+BENCHMARK(BM_FrozenMap);
+
+void BM_StringMap(benchmark::State& state) {
+  Lookup(state, StringMap<int>(kHeaders.begin(), kHeaders.end()));
+}
+BENCHMARK(BM_StringMap);
+
+void BM_StringHashMap(benchmark::State& state) {
+  StringHashMap<int> m;
+  for (auto& [k, v] : kHeaders) m.try_emplace(k, v);
+  Lookup(state, m);
+}
+BENCHMARK(BM_StringHashMap);
+
+}  // namespace
@@ -0,0 +1,82 @@
+// Benchmark for PersistentStringMap: lookups against StringMap and
+// StringHashMap, and the cost of making a new version against copying.
+//
+// Run with: bazel run -c opt //bench:hamt_map_bench
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "nectar/collections.h"
+#include "nectar/hamt_map.h"
+#include "nectar/hash_map.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+std::vector<std::string> MakeKeys(size_t n) {
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < n; ++i)
+    keys.push_back("campaign-" + std::to_string(i));
+  return keys;
+}
+
+template <typename MapT>
+MapT MakeMap(const std::vector<std::string>& keys) {
+  MapT m;
+  for (size_t i = 0; i < keys.size(); ++i) m.try_emplace(keys[i], i);
+  return m;
+}
+
+template <>
+PersistentStringMap<size_t> MakeMap(const std::vector<std::string>& keys) {
+  PersistentStringMap<size_t> m;
+  for (size_t i = 0; i < keys.size(); ++i) m = m.Set(keys[i], i);
+  return m;
+}
+
+template <typename MapT>
+void BM_Lookup(benchmark::State& state) {
+  auto keys = MakeKeys(state.range(0));
+  const auto m = MakeMap<MapT>(keys);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(FindPtr(m, keys[i]));
+    i = (i + 7919) % keys.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Lookup, PersistentStringMap<size_t>)
+    ->Range(1 << 10, 1 << 18);
+BENCHMARK_TEMPLATE(BM_Lookup, StringMap<size_t>)->Range(1 << 10, 1 << 18);
+BENCHMARK_TEMPLATE(BM_Lookup, StringHashMap<size_t>)->Range(1 << 10, 1 << 18);
+
+// One change to a table, published as a new version.
+void BM_NewVersion(benchmark::State& state) {
+  auto keys = MakeKeys(state.range(0));
+  auto m = MakeMap<PersistentStringMap<size_t>>(keys);
+  size_t i = 0;
+  for (auto _ : state) {
+    m = m.Set(keys[i], i);
+    i = (i + 7919) % keys.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_NewVersion)->Range(1 << 10, 1 << 18);
+
+// The same, by copying the whole table.
+void BM_CopyAndChange(benchmark::State& state) {
+  auto keys = MakeKeys(state.range(0));
+  auto m = MakeMap<StringHashMap<size_t>>(keys);
+  size_t i = 0;
+  for (auto _ : state) {
+    auto next = m;
+    next[keys[i]] = i;
+    m = std::move(next);
+    i = (i + 7919) % keys.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CopyAndChange)->Range(1 << 10, 1 << 18);
+
+}  // namespace
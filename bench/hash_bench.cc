@@ -0,0 +1,51 @@
+// Benchmark for Hash64 against std::hash, across key lengths.
+//
+// Run with: bazel run -c opt //bench:hash_bench
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "benchmark/benchmark.h"
+#include "nectar/hash.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+std::string MakeKey(size_t len) {
+  std::string s;
+  for (size_t i = 0; i < len; ++i) s.push_back('a' + i * 7 % 26);
+  return s;
+}
+
+void BM_Hash64(benchmark::State& state) {
+  auto key = MakeKey(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(key.data());
+    benchmark::DoNotOptimize(Hash64(key));
+  }
+  state.SetBytesProcessed(state.iterations() * key.size());
+}
+BENCHMARK(BM_Hash64)->RangeMultiplier(2)->Range(8, 4096);
+
+void BM_Hasher64(benchmark::State& state) {
+  auto key = MakeKey(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(key.data());
+    benchmark::DoNotOptimize(Hasher64().Update(key).Digest());
+  }
+  state.SetBytesProcessed(state.iterations() * key.size());
+}
+BENCHMARK(BM_Hasher64)->RangeMultiplier(2)->Range(8, 4096);
+
+void BM_StdHash(benchmark::State& state) {
+  auto key = MakeKey(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(key.data());
+    benchmark::DoNotOptimize(std::hash<std::string_view>{}(key));
+  }
+  state.SetBytesProcessed(state.iterations() * key.size());
+}
+BENCHMARK(BM_StdHash)->RangeMultiplier(2)->Range(8, 4096);
+
+}  // namespace
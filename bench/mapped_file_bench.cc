@@ -0,0 +1,67 @@
+// Benchmark for loading a file and scanning it once, as when ingesting a
+// lookup file at startup: reading it into a std::string, to get a terminated
+// copy, against mapping it with MappedFile. The file is in the page cache, so
+// this measures the copy, not the disk.
+//
+// Run with: bazel run -c opt //bench:mapped_file_bench
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "nectar/mapped_file.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+// Returns the path of a file of `size` bytes of 100-byte lines.
+std::string MakeFile(size_t size) {
+  std::string path = "/tmp/mapped_file_bench." + std::to_string(::getpid()) +
+                     "." + std::to_string(size);
+  std::string line(99, 'x');
+  line += '\n';
+  FILE* f = std::fopen(path.c_str(), "wb");
+  for (size_t n = 0; n < size; n += line.size())
+    std::fwrite(line.data(), 1, line.size(), f);
+  std::fclose(f);
+  return path;
+}
+
+// Counts lines, as a stand-in for parsing.
+size_t CountLines(const char* p) {
+  size_t lines = 0;
+  while ((p = std::strchr(p, '\n'))) {
+    ++lines;
+    ++p;
+  }
+  return lines;
+}
+
+template <bool kMapped>
+void BM_Load(benchmark::State& state) {
+  const auto path = MakeFile(state.range(0));
+  for (auto _ : state) {
+    if constexpr (kMapped) {
+      MappedFile file(path);
+      file.Advise(MappedFile::Advice::kSequential);
+      benchmark::DoNotOptimize(CountLines(file.view().c_str()));
+    } else {
+      std::ifstream in(path, std::ios::binary | std::ios::ate);
+      std::string contents(in.tellg(), '\0');
+      in.seekg(0);
+      in.read(contents.data(), contents.size());
+      benchmark::DoNotOptimize(CountLines(contents.c_str()));
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+  std::remove(path.c_str());
+}
+
+BENCHMARK_TEMPLATE(BM_Load, false)->Range(1 << 16, 1 << 28);
+BENCHMARK_TEMPLATE(BM_Load, true)->Range(1 << 16, 1 << 28);
+
+}  // namespace
@@ -0,0 +1,58 @@
+// Benchmark for recording metrics: Counter and Histogram from one or many
+// threads, against a single shared atomic, and the cost of a ScopedTimer.
+//
+// Run with: bazel run -c opt //bench:metrics_bench
+#include <atomic>
+#include <cstdint>
+
+#include "benchmark/benchmark.h"
+#include "nectar/metrics.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+std::atomic<int64_t> g_shared{0};
+
+void BM_SharedAtomic(benchmark::State& state) {
+  for (auto _ : state) g_shared.fetch_add(1, std::memory_order_relaxed);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SharedAtomic)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_CounterAdd(benchmark::State& state) {
+  static Counter counter;
+  for (auto _ : state) counter.Add();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CounterAdd)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_HistogramRecord(benchmark::State& state) {
+  static Histogram histogram;
+  uint64_t v = state.thread_index() + 1;
+  for (auto _ : state) {
+    histogram.Record(v);
+    v = v * 3 % 1000003;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HistogramRecord)->ThreadRange(1, 16)->UseRealTime();
+
+void BM_ScopedTimer(benchmark::State& state) {
+  static Histogram histogram;
+  for (auto _ : state) {
+    ScopedTimer timer(histogram);
+    benchmark::DoNotOptimize(timer);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ScopedTimer);
+
+void BM_Snapshot(benchmark::State& state) {
+  static Histogram histogram;
+  for (uint64_t v = 0; v < 100000; ++v) histogram.Record(v);
+  for (auto _ : state) benchmark::DoNotOptimize(histogram.Snapshot());
+}
+BENCHMARK(BM_Snapshot);
+
+}  // namespace
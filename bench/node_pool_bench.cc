@@ -0,0 +1,90 @@
+// Benchmark for insert/erase churn on a StringMap, as in a session table where
+// the oldest entry expires as each new one arrives: plain erase and MakeMapKey,
+// against recycling nodes through a NodePool.
+//
+// Run with: bazel run -c opt //bench:node_pool_bench
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "nectar/collections.h"
+#include "nectar/cpp20.h"
+#include "nectar/node_pool.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+// Fixed width, and long enough that std::string allocates.
+std::vector<std::string> MakeIds(size_t n) {
+  std::vector<std::string> ids;
+  for (size_t i = 0; i < n; ++i) {
+    auto digits = std::to_string(i);
+    ids.push_back("session-" + std::string(24 - digits.size(), '0') + digits);
+  }
+  return ids;
+}
+
+template <bool kPooled>
+void BM_Churn(benchmark::State& state) {
+  const size_t live = state.range(0);
+  const auto ids = MakeIds(live * 4);
+  const std::string value(64, 'x');
+  StringMap<std::string> m;
+  NodePool<StringMap<std::string>> pool;
+  for (size_t i = 0; i < live; ++i) m.emplace(ids[i], value);
+
+  size_t oldest = 0;
+  for (auto _ : state) {
+    const auto& expired = ids[oldest % ids.size()];
+    const auto& arrived = ids[(oldest + live) % ids.size()];
+    if constexpr (kPooled) {
+      pool.Erase(m, expired);
+      MakeMapKey(m, arrived, pool).Assign(value);
+    } else {
+      m.erase(expired);
+      MakeMapKey(m, arrived).Assign(value);
+    }
+    ++oldest;
+  }
+  benchmark::DoNotOptimize(m);
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_Churn, false)->Range(1 << 6, 1 << 18);
+BENCHMARK_TEMPLATE(BM_Churn, true)->Range(1 << 6, 1 << 18);
+
+// Expiring a tenth of the entries at once, by last digit, then refilling.
+template <bool kPooled>
+void BM_Expire(benchmark::State& state) {
+  const size_t live = state.range(0);
+  const auto ids = MakeIds(live);
+  const std::string value(64, 'x');
+  StringMap<std::string> m;
+  NodePool<StringMap<std::string>> pool(live);
+  for (auto& id : ids) m.emplace(id, value);
+
+  size_t wave = 0;
+  for (auto _ : state) {
+    const char digit = '0' + wave;
+    auto expired = [&](auto& kv) { return kv.first.back() == digit; };
+    if constexpr (kPooled)
+      erase_if(m, expired, pool);
+    else
+      erase_if(m, expired);
+    for (size_t i = wave; i < live; i += 10) {
+      if constexpr (kPooled)
+        insert(m, ids[i], value, pool);
+      else
+        m.try_emplace(ids[i], value);
+    }
+    wave = (wave + 1) % 10;
+  }
+  benchmark::DoNotOptimize(m);
+  state.SetItemsProcessed(state.iterations() * live / 10);
+}
+
+BENCHMARK_TEMPLATE(BM_Expire, false)->Range(1 << 10, 1 << 18);
+BENCHMARK_TEMPLATE(BM_Expire, true)->Range(1 << 10, 1 << 18);
+
+}  // namespace
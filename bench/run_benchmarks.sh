@@ -0,0 +1,27 @@
+#!/bin/bash
+# Runs every benchmark in //bench, writing one JSON file per target, tagged
+# with the commit, so that results can be compared release to release, such as
+# with Google Benchmark's tools/compare.py.
+#
+# Usage: bench/run_benchmarks.sh [out_dir] [benchmark flags...]
+#    bench/run_benchmarks.sh results --benchmark_filter=size:1000/
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+out=${1:-bench_results}
+shift || true
+mkdir -p "$out"
+out=$(cd "$out" && pwd)
+commit=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+targets=$(bazel query 'kind(cc_binary, //bench:*)')
+bazel build -c opt $targets
+for target in $targets; do
+  name=${target##*:}
+  echo "Running $name" >&2
+  "bazel-bin/bench/$name" \
+      --benchmark_out="$out/$name.json" \
+      --benchmark_out_format=json \
+      --benchmark_context=commit="$commit" \
+      "$@"
+done
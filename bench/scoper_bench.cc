@@ -0,0 +1,121 @@
+// Benchmark for ScopeGuard against Scoper, with a closer small enough for
+// std::function's inline buffer and one that isn't, and for ScopeStack against
+// a stack of Scopers.
+//
+// Run with: bazel run -c opt //bench:scoper_bench
+#include <cstdint>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "nectar/scoper.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+// A request's worth of state for the closer to capture by value, like a
+// metrics sample.
+struct Sample {
+  int64_t start = 0;
+  int64_t bytes = 0;
+  int64_t items = 0;
+  int64_t status = 0;
+};
+
+void BM_ScoperSmall(benchmark::State& state) {
+  int64_t total = 0;
+  for (auto _ : state) {
+    Scoper scope{[&total] { ++total; }};
+    benchmark::DoNotOptimize(scope);
+  }
+  benchmark::DoNotOptimize(total);
+}
+BENCHMARK(BM_ScoperSmall);
+
+void BM_ScopeGuardSmall(benchmark::State& state) {
+  int64_t total = 0;
+  for (auto _ : state) {
+    ScopeGuard scope{[&total] { ++total; }};
+    benchmark::DoNotOptimize(scope);
+  }
+  benchmark::DoNotOptimize(total);
+}
+BENCHMARK(BM_ScopeGuardSmall);
+
+void BM_ScoperLarge(benchmark::State& state) {
+  int64_t total = 0;
+  Sample sample;
+  for (auto _ : state) {
+    ++sample.items;
+    Scoper scope{[&total, sample] { total += sample.items + sample.bytes; }};
+    benchmark::DoNotOptimize(scope);
+  }
+  benchmark::DoNotOptimize(total);
+}
+BENCHMARK(BM_ScoperLarge);
+
+void BM_ScopeGuardLarge(benchmark::State& state) {
+  int64_t total = 0;
+  Sample sample;
+  for (auto _ : state) {
+    ++sample.items;
+    ScopeGuard scope{
+        [&total, sample] { total += sample.items + sample.bytes; }};
+    benchmark::DoNotOptimize(scope);
+  }
+  benchmark::DoNotOptimize(total);
+}
+BENCHMARK(BM_ScopeGuardLarge);
+
+void BM_ScoperCancel(benchmark::State& state) {
+  int64_t total = 0;
+  for (auto _ : state) {
+    Scoper scope{[&total] { ++total; }};
+    scope.Cancel();
+    benchmark::DoNotOptimize(scope);
+  }
+  benchmark::DoNotOptimize(total);
+}
+BENCHMARK(BM_ScoperCancel);
+
+void BM_ScopeGuardCancel(benchmark::State& state) {
+  int64_t total = 0;
+  for (auto _ : state) {
+    ScopeGuard scope{[&total] { ++total; }};
+    scope.Cancel();
+    benchmark::DoNotOptimize(scope);
+  }
+  benchmark::DoNotOptimize(total);
+}
+BENCHMARK(BM_ScopeGuardCancel);
+
+
+// A request that takes a number of resources, releasing them all at the end.
+void BM_ScoperStack(benchmark::State& state) {
+  int64_t total = 0;
+  Sample sample;
+  std::vector<Scoper> scopes;
+  for (auto _ : state) {
+    for (int64_t i = 0; i < state.range(0); ++i)
+      scopes.emplace_back([&total, sample] { total += sample.items; });
+    scopes.clear();
+  }
+  benchmark::DoNotOptimize(total);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ScoperStack)->RangeMultiplier(4)->Range(4, 64);
+
+void BM_ScopeStack(benchmark::State& state) {
+  int64_t total = 0;
+  Sample sample;
+  for (auto _ : state) {
+    ScopeStack cleanup;
+    for (int64_t i = 0; i < state.range(0); ++i)
+      cleanup.Push([&total, sample] { total += sample.items; });
+  }
+  benchmark::DoNotOptimize(total);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ScopeStack)->RangeMultiplier(4)->Range(4, 64);
+
+}  // namespace
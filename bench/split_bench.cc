@@ -0,0 +1,76 @@
+// Benchmark for splitting delimited lines into terminated fields: copying each
+// field into a std::string, by std::getline or by searching with
+// std::string_view, against SplitInPlace, which terminates them in place.
+//
+// Lines are CSV with short fields, some too long for std::string's inline
+// buffer, and tab-separated logs with longer ones.
+//
+// Run with: bazel run -c opt //bench:split_bench
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "nectar/split.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+enum class Splitter { kGetline, kFind, kInPlace };
+
+// Returns lines of `fields` fields, each from 1 to `max_len` characters.
+std::vector<std::string> MakeLines(size_t fields, size_t max_len, char delim) {
+  std::mt19937 rng(1);
+  std::vector<std::string> lines(64);
+  for (auto& line : lines) {
+    for (size_t f = 0; f < fields; ++f) {
+      if (f) line += delim;
+      line.append(1 + rng() % max_len, "abcdefghijklmnop"[rng() % 16]);
+    }
+  }
+  return lines;
+}
+
+template <Splitter kSplitter>
+void BM_Split(benchmark::State& state) {
+  const size_t max_len = state.range(0);
+  const char delim = max_len < 32 ? ',' : '\t';
+  const auto lines = MakeLines(20, max_len, delim);
+  // The line is copied each time, since splitting in place overwrites it.
+  std::string line;
+  size_t i = 0;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    line = lines[i++ % lines.size()];
+    bytes += line.size();
+    size_t total = 0;
+    if constexpr (kSplitter == Splitter::kGetline) {
+      std::istringstream in(line);
+      for (std::string field; std::getline(in, field, delim);)
+        total += field.size() + *field.c_str();
+    } else if constexpr (kSplitter == Splitter::kFind) {
+      std::string_view rest = line;
+      for (size_t end = 0; end != rest.npos; rest.remove_prefix(end + 1)) {
+        end = rest.find(delim);
+        std::string field(rest.substr(0, end));
+        total += field.size() + *field.c_str();
+        if (end == rest.npos) break;
+      }
+    } else {
+      for (cstring_view field : SplitInPlace(line, delim))
+        total += field.size() + *field.c_str();
+    }
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetBytesProcessed(bytes);
+}
+
+// Maximum field lengths, short for CSV and long for logs.
+BENCHMARK_TEMPLATE(BM_Split, Splitter::kGetline)->Arg(24)->Arg(200);
+BENCHMARK_TEMPLATE(BM_Split, Splitter::kFind)->Arg(24)->Arg(200);
+BENCHMARK_TEMPLATE(BM_Split, Splitter::kInPlace)->Arg(24)->Arg(200);
+
+}  // namespace
@@ -0,0 +1,116 @@
+// Benchmark for string search against std::string_view, on user agents and
+// URLs.
+//
+// Run with: bazel run -c opt //bench:string_search_bench
+#include <string>
+#include <string_view>
+
+#include "benchmark/benchmark.h"
+#include "nectar/cstring_view.h"
+#include "nectar/string_search.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+// A user agent padded to the given length, with the token near the end.
+std::string MakeUserAgent(size_t len) {
+  std::string ua = "Mozilla/5.0 (Windows NT 10.0; Win64; x64) ";
+  while (ua.size() + 40 < len) ua += "AppleWebKit/537.36 (KHTML, like Gecko) ";
+  ua.resize(len - 20, ' ');
+  return ua + "Chrome/120.0 Safari/";
+}
+
+// A URL padded to the given length, with the query near the end.
+std::string MakeUrl(size_t len) {
+  std::string url = "https://example.com";
+  while (url.size() + 20 < len) url += "/segment";
+  url.resize(len - 10, 'x');
+  return url + "?q=1#frag0";
+}
+
+// The first character of "Chrome/" is rare in a user agent, so std::find,
+// which looks for it with memchr, is at its best, and so is Find, which does
+// the same.
+void BM_Find(benchmark::State& state) {
+  auto ua = MakeUserAgent(state.range(0));
+  for (auto _ : state) benchmark::DoNotOptimize(Find(ua, "Chrome/"));
+  state.SetBytesProcessed(state.iterations() * ua.size());
+}
+BENCHMARK(BM_Find)->RangeMultiplier(4)->Range(64, 4096);
+
+void BM_StdFind(benchmark::State& state) {
+  auto ua = MakeUserAgent(state.range(0));
+  std::string_view sv(ua);
+  for (auto _ : state) benchmark::DoNotOptimize(sv.find("Chrome/"));
+  state.SetBytesProcessed(state.iterations() * ua.size());
+}
+BENCHMARK(BM_StdFind)->RangeMultiplier(4)->Range(64, 4096);
+
+// The first character of "/120" is common, so std::find, which stops at each
+// one, is at its worst.
+void BM_FindCommonFirst(benchmark::State& state) {
+  auto ua = MakeUserAgent(state.range(0));
+  for (auto _ : state) benchmark::DoNotOptimize(Find(ua, "/120"));
+  state.SetBytesProcessed(state.iterations() * ua.size());
+}
+BENCHMARK(BM_FindCommonFirst)->RangeMultiplier(4)->Range(64, 4096);
+
+void BM_StdFindCommonFirst(benchmark::State& state) {
+  auto ua = MakeUserAgent(state.range(0));
+  std::string_view sv(ua);
+  for (auto _ : state) benchmark::DoNotOptimize(sv.find("/120"));
+  state.SetBytesProcessed(state.iterations() * ua.size());
+}
+BENCHMARK(BM_StdFindCommonFirst)->RangeMultiplier(4)->Range(64, 4096);
+
+void BM_RFind(benchmark::State& state) {
+  auto ua = MakeUserAgent(state.range(0));
+  for (auto _ : state) benchmark::DoNotOptimize(RFind(ua, "Mozilla/"));
+  state.SetBytesProcessed(state.iterations() * ua.size());
+}
+BENCHMARK(BM_RFind)->RangeMultiplier(4)->Range(64, 4096);
+
+void BM_StdRFind(benchmark::State& state) {
+  auto ua = MakeUserAgent(state.range(0));
+  std::string_view sv(ua);
+  for (auto _ : state) benchmark::DoNotOptimize(sv.rfind("Mozilla/"));
+  state.SetBytesProcessed(state.iterations() * ua.size());
+}
+BENCHMARK(BM_StdRFind)->RangeMultiplier(4)->Range(64, 4096);
+
+void BM_FindFirstOf(benchmark::State& state) {
+  auto url = MakeUrl(state.range(0));
+  for (auto _ : state) benchmark::DoNotOptimize(FindFirstOf(url, "?#"));
+  state.SetBytesProcessed(state.iterations() * url.size());
+}
+BENCHMARK(BM_FindFirstOf)->RangeMultiplier(4)->Range(64, 4096);
+
+void BM_StdFindFirstOf(benchmark::State& state) {
+  auto url = MakeUrl(state.range(0));
+  std::string_view sv(url);
+  for (auto _ : state) benchmark::DoNotOptimize(sv.find_first_of("?#"));
+  state.SetBytesProcessed(state.iterations() * url.size());
+}
+BENCHMARK(BM_StdFindFirstOf)->RangeMultiplier(4)->Range(64, 4096);
+
+// A set too large for SIMD, on a terminated string.
+constexpr std::string_view kUnsafe = "?#&=%+ <>\"{}|\\^`";
+
+void BM_FindFirstOfTerminated(benchmark::State& state) {
+  auto url = MakeUrl(state.range(0));
+  cstring_view sz(url);
+  for (auto _ : state) benchmark::DoNotOptimize(FindFirstOf(sz, kUnsafe));
+  state.SetBytesProcessed(state.iterations() * url.size());
+}
+BENCHMARK(BM_FindFirstOfTerminated)->RangeMultiplier(4)->Range(64, 4096);
+
+void BM_StdFindFirstOfLargeSet(benchmark::State& state) {
+  auto url = MakeUrl(state.range(0));
+  std::string_view sv(url);
+  for (auto _ : state) benchmark::DoNotOptimize(sv.find_first_of(kUnsafe));
+  state.SetBytesProcessed(state.iterations() * url.size());
+}
+BENCHMARK(BM_StdFindFirstOfLargeSet)->RangeMultiplier(4)->Range(64, 4096);
+
+}  // namespace
@@ -0,0 +1,451 @@
+// Arena allocation for short-lived containers.
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <new>
+#include <scoped_allocator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "collections.h"
+#include "cstring_view.h"
+
+namespace beeswax::nectar {
+
+// An Arena hands out memory by bumping a pointer through large blocks, and
+// frees it all at once.
+//
+// This makes allocation a few instructions, and deallocation free, so it's a
+// good fit for scratch containers that are built up and thrown away together,
+// such as those that live for the length of a request. Call Reset to reuse the
+// blocks for the next request, without going back to the heap.
+//
+// Usage:
+//    Arena arena;
+//    for (auto& request : requests) {
+//      {
+//        ArenaStringMap<int> scratch(&arena);
+//        ...
+//      }
+//      arena.Reset();
+//    }
+//
+// Memory is never returned to the arena individually, so anything that grows by
+// reallocating, such as a vector, leaves its old buffers behind until Reset.
+//
+// This is not thread-safe.
+class Arena {
+ public:
+  static constexpr size_t kDefaultBlockSize = 4096;
+  static constexpr size_t kMaxBlockSize = 1 << 20;
+
+  // Constructs an empty arena, whose first block will be of the specified size.
+  // Each block after that is twice as large, up to kMaxBlockSize.
+  explicit Arena(size_t block_size = kDefaultBlockSize)
+      : first_block_size_(std::max(block_size, sizeof(void*))),
+        next_block_size_(first_block_size_) {}
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  ~Arena() { Release(); }
+
+  // Returns the specified number of bytes with the specified alignment, which
+  // must be a power of two.
+  void* Allocate(size_t bytes, size_t align = alignof(std::max_align_t)) {
+    void* p = ptr_;
+    size_t space = end_ - ptr_;
+    if (std::align(align, bytes, p, space) && p) {
+      ptr_ = static_cast<char*>(p) + bytes;
+      return p;
+    }
+    return AllocateSlow(bytes, align);
+  }
+
+  // Makes all memory available again, keeping the blocks for reuse.
+  //
+  // Everything allocated from the arena is invalidated, so containers using
+  // it must be destroyed first.
+  void Reset() noexcept {
+    current_ = head_;
+    if (current_) SetBlock(current_);
+  }
+
+  // Returns all blocks to the heap.
+  //
+  // Everything allocated from the arena is invalidated, so containers using
+  // it must be destroyed first.
+  void Release() noexcept {
+    while (head_) {
+      auto next = head_->next;
+      ::operator delete(head_);
+      head_ = next;
+    }
+    current_ = nullptr;
+    ptr_ = end_ = nullptr;
+    reserved_ = 0;
+    next_block_size_ = first_block_size_;
+  }
+
+  // Returns the total size of the blocks held, whether in use or not.
+  size_t BytesReserved() const noexcept { return reserved_; }
+
+ private:
+  // Header at the start of each block, followed by its memory.
+  struct alignas(std::max_align_t) Block {
+    Block* next;
+    size_t size;
+  };
+
+  void SetBlock(Block* block) noexcept {
+    ptr_ = reinterpret_cast<char*>(block + 1);
+    end_ = ptr_ + block->size;
+  }
+
+  // Moves on to the next block that fits, reusing any kept by Reset before
+  // allocating a new one.
+  void* AllocateSlow(size_t bytes, size_t align) {
+    if (bytes > std::numeric_limits<size_t>::max() - align - sizeof(Block))
+      throw std::bad_alloc();
+    const size_t needed = bytes + align - 1;
+    while (current_ && current_->next) {
+      current_ = current_->next;
+      if (current_->size >= needed) {
+        SetBlock(current_);
+        return Allocate(bytes, align);
+      }
+    }
+
+    const size_t size = std::max(needed, next_block_size_);
+    auto block = static_cast<Block*>(::operator new(sizeof(Block) + size));
+    block->next = nullptr;
+    block->size = size;
+    (current_ ? current_->next : head_) = block;
+    current_ = block;
+    reserved_ += size;
+    next_block_size_ = std::min(next_block_size_ * 2, kMaxBlockSize);
+    SetBlock(block);
+    return Allocate(bytes, align);
+  }
+
+  const size_t first_block_size_;
+  size_t next_block_size_;
+  size_t reserved_{};
+  Block* head_{};
+  Block* current_{};
+  char* ptr_{};
+  char* end_{};
+};
+
+// Standard allocator that allocates from an Arena.
+//
+// A default-constructed ArenaAllocator has no arena, so it allocates from the
+// heap like std::allocator. This lets temporaries, such as a key converted for
+// `map::operator[]`, work without an arena. Allocators compare equal when they
+// share an arena, so moving between containers on different arenas copies.
+//
+// Usage:
+//    Arena arena;
+//    std::vector<int, ArenaAllocator<int>> v(&arena);
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  ArenaAllocator() noexcept = default;
+
+  // Implicit, like std::pmr::polymorphic_allocator, so that containers can be
+  // constructed from just the arena.
+  ArenaAllocator(Arena* arena) noexcept : arena_(arena) {}  // NOLINT
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept  // NOLINT
+      : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    if (!arena_) return std::allocator<T>().allocate(n);
+    if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+      throw std::bad_array_new_length();
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  // Does nothing for an arena, which frees everything at once.
+  void deallocate(T* p, size_t n) noexcept {
+    if (!arena_) std::allocator<T>().deallocate(p, n);
+  }
+
+  Arena* arena() const noexcept { return arena_; }
+
+  template <typename U>
+  friend bool operator==(const ArenaAllocator& l, const ArenaAllocator<U>& r) {
+    return l.arena() == r.arena();
+  }
+
+  template <typename U>
+  friend bool operator!=(const ArenaAllocator& l, const ArenaAllocator<U>& r) {
+    return l.arena() != r.arena();
+  }
+
+ private:
+  Arena* arena_{};
+};
+
+// A std::string whose characters are allocated from an Arena.
+using ArenaString =
+    std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+// An ArenaStringMap is a StringMap whose nodes and key characters are both
+// allocated from an Arena, where the value defaults to std::string but can be
+// specified. If the value is an ArenaString, or another allocator-aware type
+// using ArenaAllocator, it goes in the arena too.
+//
+// Lookup is transparent, as with StringMap. To build keys in place in the
+// arena, insert with `emplace`, `MakeMapKey` or a key that's already an
+// ArenaString. Other insertions, such as `m["key"]`, convert the key to a
+// temporary ArenaString on the heap first, then copy it into the arena.
+//
+// Usage:
+//    Arena arena;
+//    ArenaStringMap<int> m(&arena);
+//    m.emplace(key, 1);
+//    MakeMapKey(m, other_key).Assign(2);
+template <typename V = std::string>
+using ArenaStringMap =
+    std::map<ArenaString,
+             V,
+             TransparentLessString,
+             std::scoped_allocator_adaptor<
+                 ArenaAllocator<std::pair<const ArenaString, V>>>>;
+
+// A StringArena builds terminated strings in an Arena, for the short-lived
+// strings made while handling a request, such as concatenated keys and
+// formatted IDs, which would otherwise each be a std::string on the heap.
+//
+// Strings are written directly into large chunks, each followed by a NUL, and
+// handed back as cstring_view, which stays valid until Reset. Reset is O(1),
+// and keeps the chunks for the next request.
+//
+// Usage:
+//    StringArena strings;
+//    cstring_view key = strings.Concat(campaign, ":", creative);
+//    cstring_view id = strings.Format("%s-%08x", prefix, seq);
+//    auto b = strings.Build();
+//    b.Append(host).Append('/').AppendInt(port);
+//    cstring_view url = b.Finish();
+//    ...
+//    strings.Reset();
+//
+// Example without helper:
+//    std::string key = std::string(campaign) + ":" + std::string(creative);
+//    char id[64];
+//    snprintf(id, sizeof(id), "%s-%08x", prefix, seq);
+//
+// The strings make good keys for maps whose nodes are in the same arena, since
+// they're freed together. See StringArenaMap.
+//
+// Only one Builder may be in progress at a time, and nothing else may be
+// stored until it's finished, since it writes at the end of the current chunk.
+// This is not thread-safe.
+class StringArena {
+ public:
+  static constexpr size_t kChunkSize = 4096;
+
+  // Builds a string in place at the end of the arena.
+  class Builder {
+   public:
+    Builder(const Builder&) = delete;
+    Builder& operator=(const Builder&) = delete;
+
+    Builder& Append(std::string_view s) {
+      std::memcpy(Grow(s.size()), s.data(), s.size());
+      return *this;
+    }
+
+    Builder& Append(char c) {
+      *Grow(1) = c;
+      return *this;
+    }
+
+    // Numbers would otherwise convert to char; use AppendInt.
+    template <typename T,
+              typename = std::enable_if_t<std::is_arithmetic_v<T>>>
+    Builder& Append(T) = delete;
+
+    // Appends an integer in decimal.
+    template <typename T,
+              typename = std::enable_if_t<std::is_integral_v<T> &&
+                                          !std::is_same_v<T, bool>>>
+    Builder& AppendInt(T value) {
+      constexpr size_t kMaxDigits = std::numeric_limits<T>::digits10 + 2;
+      char* p = Reserve(kMaxDigits);
+      size_ = std::to_chars(p, p + kMaxDigits, value).ptr - arena_->ptr_;
+      return *this;
+    }
+
+    // Appends as printf would.
+    Builder& AppendFormat(const char* format, ...)
+        __attribute__((format(printf, 2, 3))) {
+      va_list args;
+      va_start(args, format);
+      AppendFormatV(format, args);
+      va_end(args);
+      return *this;
+    }
+
+    Builder& AppendFormatV(const char* format, va_list args) {
+      va_list retry;
+      va_copy(retry, args);
+      // Try the space left in the chunk first, and only measure on overflow.
+      char* p = Reserve(0);
+      const size_t room = arena_->end_ - p;
+      const int n = std::vsnprintf(p, room, format, args);
+      if (n < 0) {
+        va_end(retry);
+        throw std::invalid_argument("StringArena: invalid format");
+      }
+      if (static_cast<size_t>(n) >= room)
+        std::vsnprintf(Reserve(n), n + 1, format, retry);
+      va_end(retry);
+      size_ += n;
+      return *this;
+    }
+
+    size_t size() const noexcept { return size_; }
+
+    // Terminates the string and returns it. The builder must not be used
+    // after this.
+    cstring_view Finish() {
+      Reserve(0);
+      char* p = arena_->ptr_;
+      p[size_] = '\0';
+      arena_->ptr_ += size_ + 1;
+      return cstring_view(p, size_);
+    }
+
+   private:
+    friend class StringArena;
+
+    explicit Builder(StringArena* arena) noexcept : arena_(arena) {}
+
+    // Returns space for `n` more characters and the terminator, past the end
+    // of the string so far.
+    char* Reserve(size_t n) {
+      if (n + 1 > static_cast<size_t>(arena_->end_ - arena_->ptr_) - size_)
+        arena_->NextChunk(size_, n + 1);
+      return arena_->ptr_ + size_;
+    }
+
+    // Returns space for exactly `n` more characters, which are added to the
+    // string.
+    char* Grow(size_t n) {
+      char* p = Reserve(n);
+      size_ += n;
+      return p;
+    }
+
+    StringArena* arena_;
+    size_t size_ = 0;
+  };
+
+  // Constructs an empty arena, whose blocks start at the specified size, as
+  // for Arena.
+  explicit StringArena(size_t block_size = Arena::kDefaultBlockSize)
+      : arena_(block_size) {}
+
+  StringArena(const StringArena&) = delete;
+  StringArena& operator=(const StringArena&) = delete;
+
+  // Copies the string into the arena.
+  cstring_view Store(std::string_view s) {
+    return Build().Append(s).Finish();
+  }
+
+  // Concatenates the pieces, each of which must convert to std::string_view
+  // or be a char, into the arena.
+  template <typename... Pieces>
+  cstring_view Concat(const Pieces&... pieces) {
+    auto builder = Build();
+    (builder.Append(pieces), ...);
+    return builder.Finish();
+  }
+
+  // Formats into the arena, as printf would.
+  cstring_view Format(const char* format, ...)
+      __attribute__((format(printf, 2, 3))) {
+    auto builder = Build();
+    va_list args;
+    va_start(args, format);
+    builder.AppendFormatV(format, args);
+    va_end(args);
+    return builder.Finish();
+  }
+
+  // Starts a string at the end of the arena.
+  Builder Build() noexcept { return Builder(this); }
+
+  // Makes all memory available again, invalidating every string returned.
+  // Containers using arena() must be destroyed first.
+  void Reset() noexcept {
+    arena_.Reset();
+    ptr_ = end_ = nullptr;
+  }
+
+  // Returns the arena the chunks come from, for containers that should be
+  // freed along with the strings.
+  Arena* arena() noexcept { return &arena_; }
+
+  // Returns the total size of the blocks held, whether in use or not.
+  size_t BytesReserved() const noexcept { return arena_.BytesReserved(); }
+
+ private:
+  // Moves on to a new chunk with room for `needed` bytes after the `used`
+  // bytes of the string in progress, which are moved over. The rest of the
+  // old chunk is abandoned.
+  void NextChunk(size_t used, size_t needed) {
+    if (needed > std::numeric_limits<size_t>::max() / 2 - used)
+      throw std::bad_alloc();
+    const size_t size = std::max(kChunkSize, 2 * (used + needed));
+    auto chunk = static_cast<char*>(arena_.Allocate(size, 1));
+    if (used) std::memcpy(chunk, ptr_, used);
+    ptr_ = chunk;
+    end_ = chunk + size;
+  }
+
+  Arena arena_;
+  // The unused part of the current chunk.
+  char* ptr_{};
+  char* end_{};
+};
+
+// A StringArenaMap is a std::map keyed on strings stored in a StringArena,
+// whose nodes are allocated from the same arena, so that the whole map, keys
+// and all, is freed by StringArena::Reset. Lookup is transparent.
+//
+// Unlike ArenaStringMap, the key is stored by the caller, so the node holds
+// just a view, and a key that's already present need not be stored at all.
+//
+// Usage:
+//    StringArena strings;
+//    StringArenaMap<int> counts(strings.arena());
+//    auto it = counts.find(name);
+//    if (it == counts.end()) it = counts.emplace(strings.Store(name), 0).first;
+//    ++it->second;
+template <typename V>
+using StringArenaMap =
+    std::map<cstring_view,
+             V,
+             TransparentLessString,
+             ArenaAllocator<std::pair<const cstring_view, V>>>;
+
+}  // namespace beeswax::nectar
@@ -0,0 +1,351 @@
+// Bounded, thread-safe cache for memoizing expensive computations.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "collections.h"
+#include "hash_map.h"
+#include "metrics.h"
+
+namespace beeswax::nectar {
+
+// Counts of a ConcurrentStringCache's lookups and removals, since it was
+// constructed.
+struct CacheStats {
+  int64_t hits = 0;
+  int64_t misses = 0;
+  // Entries dropped to make room for others.
+  int64_t evictions = 0;
+  // Entries replaced after outliving their TTL.
+  int64_t expirations = 0;
+};
+
+// A ConcurrentStringCache is a thread-safe cache keyed on std::string, holding
+// at most a fixed number of entries, for memoizing expensive computations with
+// predictable memory use.
+//
+// Entries are spread over shards by hash, as in ConcurrentStringMap, each with
+// its own reader/writer lock. When a shard is full, the CLOCK algorithm picks
+// the entry to evict: a hit just sets the entry's reference bit, under the
+// shared lock, and the shard's hand sweeps over its entries, clearing the bits
+// it finds set and evicting the first entry whose bit is clear. This keeps
+// recently used entries about as well as LRU does, without every hit taking an
+// exclusive lock to move its entry to the front of a list.
+//
+// Entries may have a time to live, after which they're treated as missing.
+// Lookup is transparent, and each key is hashed once, to pick its shard and to
+// search it, or not at all if it carries its hash, as HashedStringView does.
+//
+// Usage:
+//    ConcurrentStringCache<Score> scores(100000, std::chrono::minutes(5));
+//    auto score = scores.GetOrCompute(key, [&] { return Evaluate(key); });
+//    metrics.Report(scores.stats());
+//
+// Example without helper:
+//    std::lock_guard lock(mutex);
+//    auto it = scores.find(key);
+//    if (it == scores.end() || it->second.expires < Now()) {
+//      if (scores.size() >= kMaxSize) scores.erase(scores.begin());
+//      it = scores.insert_or_assign(key, {Evaluate(key), Now() + kTtl}).first;
+//    }
+//    auto score = it->second.score;
+//
+// GetOrCompute has FindOrDefault's callback semantics: it returns a copy of
+// the value if found, or else the result of the callback, which it also
+// stores. Unlike ConcurrentStringMap's DefaultValueCb, the callback runs with
+// no lock held, so a slow computation doesn't stall the rest of its shard,
+// and it may use the cache itself. The flip side is that threads that miss on
+// the same key at the same time may each run it, and the first to finish
+// stores its result.
+//
+// `Clock` is std::chrono::steady_clock, unless replaced for testing.
+template <typename V, typename Clock = std::chrono::steady_clock>
+class ConcurrentStringCache {
+ public:
+  using key_type = std::string;
+  using mapped_type = V;
+  using size_type = std::size_t;
+  using duration = typename Clock::duration;
+
+  static constexpr size_type kDefaultShards = 16;
+
+  // Constructs an empty cache for up to `capacity` entries, which are kept for
+  // `ttl`, or if zero, until evicted. The number of shards, if more than the
+  // capacity, is cut to it, and is then rounded up to a power of two, as for
+  // ConcurrentStringMap. Capacity is divided evenly over the shards, rounding
+  // up.
+  explicit ConcurrentStringCache(size_type capacity,
+                                 duration ttl = duration::zero(),
+                                 size_type shards = kDefaultShards)
+      : shard_bits_(details::ShardBits(std::min(shards, capacity))),
+        shard_capacity_((capacity + shard_count() - 1) >> shard_bits_),
+        ttl_(ttl),
+        shards_(new Shard[shard_count()]) {
+    if (!capacity)
+      throw std::invalid_argument("ConcurrentStringCache: zero capacity");
+    for (size_type i = 0; i < shard_count(); ++i)
+      shards_[i].index.reserve(shard_capacity_);
+  }
+
+  ConcurrentStringCache(const ConcurrentStringCache&) = delete;
+  ConcurrentStringCache& operator=(const ConcurrentStringCache&) = delete;
+
+  size_type shard_count() const noexcept { return size_type{1} << shard_bits_; }
+
+  // Returns the most entries the cache will hold.
+  size_type capacity() const noexcept {
+    return shard_capacity_ << shard_bits_;
+  }
+
+  // Returns the number of entries, including any that have expired but not
+  // yet been replaced. Under concurrent changes, this is only a snapshot.
+  size_type size() const {
+    size_type n = 0;
+    for (size_type i = 0; i < shard_count(); ++i) {
+      std::shared_lock lock(shards_[i].mutex);
+      n += shards_[i].index.size();
+    }
+    return n;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  // Returns a copy of the value, or nullopt if not found or expired. Counts a
+  // hit or a miss.
+  template <typename K>
+  std::optional<V> Find(const K& k) const {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    std::shared_lock lock(shard.mutex);
+    if (auto* slot = Lookup(shard, hk)) return slot->value;
+    return std::nullopt;
+  }
+
+  // Returns a copy of the value. If not found or expired, first sets value to
+  // return from callback, which is run without holding any lock. See above.
+  template <typename K,
+            typename Cb,
+            std::enable_if_t<std::is_invocable_r_v<V, Cb>, int> = 0>
+  V GetOrCompute(const K& k, Cb cb) {
+    return GetOrCompute(k, std::move(cb), ttl_);
+  }
+
+  // As above, but keeps a new value for `ttl` rather than the cache's
+  // default, or if zero, until evicted.
+  template <typename K,
+            typename Cb,
+            std::enable_if_t<std::is_invocable_r_v<V, Cb>, int> = 0>
+  V GetOrCompute(const K& k, Cb cb, duration ttl) {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    {
+      std::shared_lock lock(shard.mutex);
+      if (auto* slot = Lookup(shard, hk)) return slot->value;
+    }
+    V value = cb();
+    std::unique_lock lock(shard.mutex);
+    Store(shard, hk, value, ttl, /*replace=*/false);
+    return value;
+  }
+
+  // Sets value, inserting if necessary, to be kept for the cache's default
+  // TTL.
+  template <typename K, typename M>
+  void Put(const K& k, M&& value) {
+    Put(k, std::forward<M>(value), ttl_);
+  }
+
+  // Sets value, inserting if necessary, to be kept for `ttl`, or if zero,
+  // until evicted.
+  template <typename K, typename M>
+  void Put(const K& k, M&& value, duration ttl) {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    std::unique_lock lock(shard.mutex);
+    Store(shard, hk, std::forward<M>(value), ttl, /*replace=*/true);
+  }
+
+  // Erases entry, returning number erased.
+  template <typename K>
+  size_type erase(const K& k) {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    std::unique_lock lock(shard.mutex);
+    auto it = shard.index.find(hk);
+    if (it == shard.index.end()) return 0;
+    shard.free.push_back(it->second);
+    shard.index.erase(it);
+    return 1;
+  }
+
+  // Erases all entries, keeping the counters.
+  void clear() {
+    for (size_type i = 0; i < shard_count(); ++i) {
+      auto& shard = shards_[i];
+      std::unique_lock lock(shard.mutex);
+      shard.index.clear();
+      shard.slots.clear();
+      shard.free.clear();
+      shard.hand = 0;
+    }
+  }
+
+  // Returns the counters. Under concurrent use, this is only a snapshot.
+  CacheStats stats() const noexcept {
+    return {hits_.Value(),
+            misses_.Value(),
+            evictions_.Value(),
+            expirations_.Value()};
+  }
+
+ private:
+  using time_point = typename Clock::time_point;
+
+  static constexpr time_point kNever = time_point::max();
+
+  struct Slot {
+    template <typename M>
+    Slot(std::string_view k, M&& v, time_point e)
+        : key(k), value(std::forward<M>(v)), expires(e) {}
+
+    std::string key;
+    V value;
+    time_point expires;
+    // Set by hits, and cleared as the CLOCK hand passes.
+    std::atomic<bool> referenced{false};
+  };
+
+  struct alignas(details::kCacheLineSize) Shard {
+    mutable std::shared_mutex mutex;
+    // Keyed on views of the slots' keys. A deque, since it never moves its
+    // elements as it grows.
+    FlatHashMap<std::string_view, Slot*, StringHash, StringEqual> index;
+    std::deque<Slot> slots;
+    // Slots of erased entries, to reuse before evicting.
+    std::vector<Slot*> free;
+    size_type hand = 0;
+  };
+
+  // Returns the entry for the key, or nullptr.
+  template <typename K>
+  static Slot* FindSlot(const Shard& shard, const K& k) {
+    auto it = shard.index.find(k);
+    return it == shard.index.end() ? nullptr : it->second;
+  }
+
+  // Hashes the key, unless it already carries its hash, so that choosing the
+  // shard and searching it share the one hash.
+  template <typename K>
+  static HashedStringView Hashed(const K& k) noexcept {
+    return HashedStringView(std::string_view(k),
+                            static_cast<uint64_t>(StringHash{}(k)));
+  }
+
+  // Uses the top bits of the hash. The shard's index mixes all of them, so
+  // its keys sharing these doesn't crowd them together.
+  Shard& ShardFor(HashedStringView k) const {
+    return shards_[shard_bits_ ? k.hash() >> (64 - shard_bits_) : 0];
+  }
+
+  // Returns the live entry for the key, marking it referenced, or nullptr,
+  // counting a hit or a miss. Needs at least the shard's shared lock.
+  template <typename K>
+  const Slot* Lookup(const Shard& shard, const K& k) const {
+    auto* slot = FindSlot(shard, k);
+    if (!slot || (slot->expires != kNever && slot->expires <= Clock::now())) {
+      misses_.Add();
+      return nullptr;
+    }
+    // Only write when needed, so hot entries' lines stay shared.
+    if (!slot->referenced.load(std::memory_order_relaxed))
+      slot->referenced.store(true, std::memory_order_relaxed);
+    hits_.Add();
+    return slot;
+  }
+
+  // Stores the value for the key, reusing its entry if there is one, and
+  // otherwise a free slot, a new one, or the one the CLOCK hand evicts. A live
+  // entry is only overwritten if `replace`. Needs the shard's exclusive lock.
+  template <typename M>
+  void Store(Shard& shard,
+             HashedStringView k,
+             M&& value,
+             duration ttl,
+             bool replace) {
+    const auto now = Clock::now();
+    const auto expires = ttl > duration::zero() ? now + ttl : kNever;
+    if (auto* slot = FindSlot(shard, k)) {
+      if (slot->expires <= now)
+        expirations_.Add();
+      else if (!replace)
+        return;
+      slot->value = std::forward<M>(value);
+      slot->expires = expires;
+      return;
+    }
+
+    const std::string_view key(k);
+    Slot* slot;
+    if (!shard.free.empty()) {
+      slot = shard.free.back();
+      shard.free.pop_back();
+    } else if (shard.slots.size() < shard_capacity_) {
+      slot = &shard.slots.emplace_back(key, std::forward<M>(value), expires);
+      shard.index.try_emplace(HashedStringView(slot->key, k.hash()), slot);
+      return;
+    } else {
+      slot = Evict(shard, now);
+    }
+    slot->key.assign(key);
+    slot->value = std::forward<M>(value);
+    slot->expires = expires;
+    slot->referenced.store(false, std::memory_order_relaxed);
+    shard.index.try_emplace(HashedStringView(slot->key, k.hash()), slot);
+  }
+
+  // Advances the hand to an expired or unreferenced entry, clearing the
+  // reference bits of those it passes, and removes the entry from the index.
+  // Ends within two sweeps, since the first clears every bit.
+  Slot* Evict(Shard& shard, time_point now) {
+    for (;; shard.hand = (shard.hand + 1) % shard.slots.size()) {
+      auto& slot = shard.slots[shard.hand];
+      if (slot.expires <= now) {
+        expirations_.Add();
+      } else if (slot.referenced.load(std::memory_order_relaxed)) {
+        slot.referenced.store(false, std::memory_order_relaxed);
+        continue;
+      } else {
+        evictions_.Add();
+      }
+      shard.hand = (shard.hand + 1) % shard.slots.size();
+      shard.index.erase(std::string_view(slot.key));
+      return &slot;
+    }
+  }
+
+  const size_type shard_bits_;
+  const size_type shard_capacity_;
+  const duration ttl_;
+  std::unique_ptr<Shard[]> shards_;
+  mutable Counter hits_;
+  mutable Counter misses_;
+  Counter evictions_;
+  Counter expirations_;
+};
+
+}  // namespace beeswax::nectar
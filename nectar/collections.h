@@ -1,22 +1,31 @@
 // Collections utilities.
 #pragma once
 
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <iterator>
 #include <map>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "hash.h"
 
 namespace beeswax::nectar {
 
 // Transparent std::less<string> that works with anything that can
 // be cast into a std::string_view.
 //
-// Note that, for now, this works for maps and sets, but not their unordered
-// versions. This will change in C++20, allowing us to add StringHash to this
-// header.
-//
-// http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2018/p0919r3.html
-// https://herbsutter.com/2018/11/13/trip-report-fall-iso-c-standards-meeting-san-diego/
+// Note that this works for maps and sets. For their unordered versions, see
+// StringHash and StringEqual, below.
 struct TransparentLessString {
   using is_transparent = void;
 
@@ -26,6 +35,34 @@ struct TransparentLessString {
   }
 };
 
+// Transparent std::hash<string> that works with anything that can be cast into
+// a std::string_view.
+//
+// Hashes with Hash64, so they're the same for every type with the same
+// characters, and lookups with any of these types find entries inserted with
+// any other. Types that already know the Hash64 of their characters, such as
+// InternedString and HashedStringView, can provide it as
+// `uint64_t hash() const`, and it's used instead of hashing again.
+struct StringHash {
+  using is_transparent = void;
+
+  template <typename T>
+  size_t operator()(const T& t) const noexcept {
+    return details::StringHash64(t);
+  }
+};
+
+// Transparent std::equal_to<string> that works with anything that can be cast
+// into a std::string_view.
+struct StringEqual {
+  using is_transparent = void;
+
+  template <typename T, typename U>
+  bool operator()(const T& l, const U& r) const noexcept {
+    return static_cast<std::string_view>(l) == static_cast<std::string_view>(r);
+  }
+};
+
 // A StringMap is a map keyed on std::string, where the value defaults to
 // std::string but can be specified.
 //
@@ -35,8 +72,41 @@ template <typename V = std::string,
           typename A = std::allocator<std::pair<const std::string, V>>>
 using StringMap = std::map<std::string, V, TransparentLessString, A>;
 
+// A StringUnorderedMap is an unordered_map keyed on std::string, where the
+// value defaults to std::string but can be specified.
+//
+// Starting with C++20, you automatically get transparent lookup, so that the
+// key doesn't have to be converted to a std::string temporary. Before that,
+// lookups still work but construct a temporary, which may allocate. When that
+// matters, use StringHashMap instead.
+//
+// http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2018/p0919r3.html
+// https://herbsutter.com/2018/11/13/trip-report-fall-iso-c-standards-meeting-san-diego/
+template <typename V = std::string,
+          typename A = std::allocator<std::pair<const std::string, V>>>
+using StringUnorderedMap =
+    std::unordered_map<std::string, V, StringHash, StringEqual, A>;
+
+// A StringUnorderedSet is an unordered_set of std::string, with transparent
+// lookup starting with C++20, as per StringUnorderedMap.
+template <typename A = std::allocator<std::string>>
+using StringUnorderedSet =
+    std::unordered_set<std::string, StringHash, StringEqual, A>;
+
 // Internal implementation details; do not use.
 namespace details {
+// Assumed size of a cache line, for keeping data written by different threads
+// apart.
+inline constexpr size_t kCacheLineSize = 64;
+
+// Returns the log of the number of shards for a sharded container: `shards`
+// rounded up to a power of two, from 1 to 65536.
+constexpr size_t ShardBits(size_t shards) noexcept {
+  size_t bits = 0;
+  while (bits < 16 && (size_t{1} << bits) < shards) ++bits;
+  return bits;
+}
+
 // Helper sniffer to get dereferenced type from pointer.
 template <typename T>
 using deref_t = std::remove_reference_t<decltype(*std::declval<T>())>;
@@ -50,6 +120,161 @@ constexpr bool is_deep_copyable_ptr_v =
 template <typename C, typename K>
 using mapvalptr_t =
     decltype(&(std::declval<C>().find(std::declval<K>())->second));
+
+// Helper sniffer for whether map-like container is ordered.
+template <typename C, typename = void>
+constexpr bool is_ordered_map_v = false;
+
+template <typename C>
+constexpr bool is_ordered_map_v<C, std::void_t<typename C::key_compare>> =
+    true;
+
+// Helper sniffer for whether container has `find_batch`, which looks up many
+// keys at once, calling back with the index of each key and its iterator.
+template <typename C, typename KeyIt, typename = void>
+constexpr bool has_find_batch_v = false;
+
+template <typename C>
+using find_batch_cb_t = void (&)(size_t, decltype(std::declval<C&>().end()));
+
+template <typename C, typename KeyIt>
+constexpr bool has_find_batch_v<
+    C,
+    KeyIt,
+    std::void_t<decltype(std::declval<C&>().find_batch(
+        std::declval<KeyIt>(),
+        size_t{},
+        std::declval<find_batch_cb_t<C>>()))>> = true;
+
+// Calls back with the index and iterator for each key, batched if the
+// container supports it.
+template <typename C, typename Keys, typename Cb>
+void ForEachFound(C& c, const Keys& keys, Cb cb) {
+  auto k = std::begin(keys);
+  const size_t n = std::size(keys);
+  if constexpr (has_find_batch_v<C, decltype(k)>) {
+    c.find_batch(k, n, cb);
+  } else {
+    for (size_t i = 0; i < n; ++i) cb(i, c.find(k[i]));
+  }
+}
+
+// Helper sniffer for whether map-like container has `emplace_hint`.
+template <typename C, typename = void>
+constexpr bool has_emplace_hint_v = false;
+
+template <typename C>
+constexpr bool has_emplace_hint_v<
+    C,
+    std::void_t<decltype(std::declval<C>().emplace_hint(
+        std::declval<typename C::const_iterator>(),
+        std::declval<typename C::value_type>()))>> = true;
+
+// Helper sniffer for whether a hash map can keep where a failed lookup would
+// insert, as FlatHashMap can with `find_or_prepare_insert`.
+template <typename C, typename = void>
+constexpr bool has_prepare_insert_v = false;
+
+template <typename C>
+constexpr bool
+    has_prepare_insert_v<C, std::void_t<typename C::prepared_insert>> = true;
+
+// Where MapKey keeps the position from a failed lookup, if the map has one.
+struct NoPreparedInsert {};
+
+template <typename C, typename = void>
+struct prepared_insert {
+  using type = NoPreparedInsert;
+};
+
+template <typename C>
+struct prepared_insert<C, std::void_t<typename C::prepared_insert>> {
+  using type = typename C::prepared_insert;
+};
+
+// Helper sniffer for whether a T can be assigned from a single argument, as
+// opposed to having to be constructed from the arguments first.
+template <typename T, typename... Args>
+constexpr bool is_assignable_from_v = false;
+
+template <typename T, typename Arg>
+constexpr bool is_assignable_from_v<T, Arg> = std::is_assignable_v<T&, Arg&&>;
+
+// Helper sniffer for whether an element of a sorted range is a key/value pair,
+// rather than just a key.
+template <typename T, typename = void>
+constexpr bool has_first_v = false;
+
+template <typename T>
+constexpr bool has_first_v<T, std::void_t<decltype(std::declval<T>().first)>> =
+    true;
+
+// Returns the key of an element of a sorted range.
+template <typename T>
+const auto& SortedKey(const T& item) {
+  if constexpr (has_first_v<T>)
+    return item.first;
+  else
+    return item;
+}
+
+// Inserts at the hint, which is where the key belongs, returning the new
+// entry. As with MapKey, the key is constructed in place where possible.
+template <typename MapT, typename K, typename M>
+auto InsertAt(MapT& m, typename MapT::iterator hint, K&& k, M&& v) {
+  if constexpr (has_emplace_hint_v<MapT>)
+    return m.emplace_hint(hint,
+                          std::piecewise_construct,
+                          std::forward_as_tuple(std::forward<K>(k)),
+                          std::forward_as_tuple(std::forward<M>(v)));
+  else
+    return m.try_emplace(hint, std::forward<K>(k), std::forward<M>(v));
+}
+
+// How far to step forward from the previous key's entry before giving up
+// and searching.
+inline constexpr int kSortedSeekSteps = 8;
+
+// Inserts each key/value pair from the range into the ordered map, or when
+// the key is already there, calls `on_found(value, new_value)`. Returns the
+// number inserted.
+//
+// Each search starts from the previous key's entry, stepping forward. So for
+// input sorted by the map's order, each insert is amortized O(1), and the
+// input is merged in a single pass, even when it's sparse relative to the
+// map. Out-of-order keys still work, at the cost of a full search.
+template <typename MapT, typename InputIt, typename OnFound>
+size_t SortedUpsert(MapT& m, InputIt first, InputIt last, OnFound on_found) {
+  const auto comp = m.key_comp();
+  size_t inserted = 0;
+  auto it = m.end();
+  for (bool have_prev = false; first != last; ++first, have_prev = true) {
+    auto&& item = *first;
+    const auto& k = item.first;
+    if (have_prev && comp(it->first, k)) {
+      int steps = 0;
+      for (++it; it != m.end() && comp(it->first, k); ++it) {
+        if (++steps == kSortedSeekSteps) {
+          it = m.lower_bound(k);
+          break;
+        }
+      }
+    } else {
+      it = m.lower_bound(k);
+    }
+
+    if (it != m.end() && !comp(k, it->first)) {
+      on_found(it->second, std::forward<decltype(item)>(item).second);
+    } else {
+      it = InsertAt(m,
+                    it,
+                    std::forward<decltype(item)>(item).first,
+                    std::forward<decltype(item)>(item).second);
+      ++inserted;
+    }
+  }
+  return inserted;
+}
 }  // namespace details
 
 namespace nosniff {
@@ -274,6 +499,60 @@ auto FindOrDefault(C& c, const K& k) {
   return DerefOrDefault(FindPtr(c, k));
 }
 
+// Find values for many keys at once, setting each element of `out` to a
+// pointer to the value for the corresponding key, or nullptr if not found.
+//
+// Usage:
+//    std::vector<const Segment*> found(ids.size());
+//    FindPtrBatch(segments, ids, found);
+//
+// Example without helper:
+//    for (size_t i = 0; i < ids.size(); ++i)
+//      found[i] = FindPtr(segments, ids[i]);
+//
+// For containers that support batched lookup, such as FlatHashMap and
+// StringFlatMap, this overlaps the cache misses of many lookups, instead of
+// stalling on each in turn, so it's much faster when the container doesn't
+// fit in cache. For others, such as std::map, it's just the loop.
+//
+// The keys and `out` can be any random-access ranges, such as vectors, arrays
+// or, starting with C++20, spans. `out` must be at least as long as the keys.
+template <typename C, typename Keys, typename Out>
+void FindPtrBatch(C& c, const Keys& keys, Out&& out) {
+  auto o = std::begin(out);
+  details::ForEachFound(c, keys, [&](size_t i, auto it) {
+    o[i] = it == c.end() ? nullptr : &it->second;
+  });
+}
+
+// Find values for many keys at once, setting each element of `out` to the
+// value for the corresponding key, or if not found, the specified default.
+// See FindPtrBatch.
+//
+// Usage:
+//    std::vector<double> bids(ids.size());
+//    FindOrDefaultBatch(bids_by_id, ids, bids, kFloorBid);
+template <typename C, typename Keys, typename Out, typename D>
+void FindOrDefaultBatch(C& c, const Keys& keys, Out&& out, const D& def) {
+  auto o = std::begin(out);
+  details::ForEachFound(c, keys, [&](size_t i, auto it) {
+    if (it == c.end())
+      o[i] = def;
+    else
+      o[i] = it->second;
+  });
+}
+
+// Find values for many keys at once, setting each element of `out` to the
+// value for the corresponding key, or if not found, the default instance for
+// that type. See FindPtrBatch.
+template <typename C, typename Keys, typename Out>
+void FindOrDefaultBatch(C& c, const Keys& keys, Out&& out) {
+  using ValueT = std::remove_reference_t<decltype(c.begin()->second)>;
+  FindOrDefaultBatch(
+      c, keys, std::forward<Out>(out), std::remove_cv_t<ValueT>{});
+}
+
 // Map and key for efficient manipulation.
 //
 // Avoids anti-pattern of contains/find followed by insert.
@@ -283,23 +562,36 @@ auto FindOrDefault(C& c, const K& k) {
 //    if (!mk)
 //      mk.Insert(def);
 //
-// Use the MakeMapKey helper function to create these.
-template <typename KeyT,
-          typename ValueT,
-          typename CompareT,
-          typename AllocatorT,
-          typename FinderT>
-class MapKey {
+// Works with any map that offers hinted `emplace_hint` or `try_emplace`. For
+// ordered maps, such as std::map and StringFlatMap, the hint is the position
+// found by `lower_bound`, so inserting doesn't search again. For FlatHashMap
+// and StringHashMap, the failed lookup keeps the key's hash and free slot, so
+// inserting doesn't hash or probe again. For other hash maps, the hint is just
+// the result of `find`.
+//
+// Use the MakeMapKey helper function to create these. To reuse nodes erased
+// from a node-based map instead of allocating new ones, pass a NodePool to
+// MakeMapKey. See node_pool.h.
+template <typename MapT, typename FinderT, typename PoolT = void>
+class BasicMapKey {
  public:
-  using MapT = std::map<KeyT, ValueT, CompareT, AllocatorT>;
   using IterT = typename MapT::iterator;
+  using ValueT = typename MapT::mapped_type;
 
   // Constructs from map and key, finding matching value or where it would go.
-  MapKey(MapT& m, FinderT&& key)
+  BasicMapKey(MapT& m, FinderT&& key)
+      : map_(m),
+        key_(std::forward<FinderT>(key)),
+        it_(Locate()),
+        found_(IsMatch()) {}
+
+  // Constructs from map, key and pool of nodes to insert with.
+  BasicMapKey(MapT& m, FinderT&& key, PoolT* pool)
       : map_(m),
         key_(std::forward<FinderT>(key)),
-        it_(map_.lower_bound(key_)),
-        found_(it_ != map_.end() && !(map_.key_comp()(it_->first, key_))) {}
+        it_(Locate()),
+        found_(IsMatch()),
+        pool_(pool) {}
 
   // Returns map.
   MapT& Map() { return map_; }
@@ -332,7 +624,7 @@ class MapKey {
       typename NewValueT,
       std::enable_if_t<!std::is_invocable_r_v<ValueT, NewValueT>, int> = 0>
   ValueT& DefaultValue(NewValueT&& defaultValue) {
-    if (!found_) Assign(defaultValue);
+    if (!found_) Assign(std::forward<NewValueT>(defaultValue));
     return it_->second;
   }
 
@@ -342,8 +634,8 @@ class MapKey {
   // to be inserted.
   template <typename Cb,
             std::enable_if_t<std::is_invocable_r_v<ValueT, Cb>, int> = 0>
-  bool DefaultValueCb(Cb cb) {
-    if (!found_) return Assign(cb());
+  ValueT& DefaultValueCb(Cb cb) {
+    if (!found_) Assign(cb());
     return it_->second;
   }
 
@@ -363,9 +655,7 @@ class MapKey {
       it_->second = std::forward<NewValueT>(value);
       return false;
     } else {
-      it_ = map_.insert_or_assign(
-          it_, std::move<FinderT>(key_), std::forward<NewValueT>(value));
-      found_ = true;
+      Insert(std::forward<NewValueT>(value));
       return true;
     }
   }
@@ -377,9 +667,7 @@ class MapKey {
       it_->second = ValueT(std::forward<Args>(args)...);
       return false;
     } else {
-      it_ = map_.try_emplace(
-          it_, std::move<FinderT>(key_), std::forward<Args>(args)...);
-      found_ = true;
+      Insert(std::forward<Args>(args)...);
       return true;
     }
   }
@@ -396,12 +684,85 @@ class MapKey {
   ValueT* get() const { return ValuePtr(); }
 
  private:
+  // Returns matching entry or, for ordered maps, where it would go.
+  IterT Locate() {
+    if constexpr (details::is_ordered_map_v<MapT>) {
+      return map_.lower_bound(key_);
+    } else if constexpr (details::has_prepare_insert_v<MapT>) {
+      auto [it, prepared] = map_.find_or_prepare_insert(key_);
+      prepared_ = prepared;
+      return it;
+    } else {
+      return map_.find(key_);
+    }
+  }
+
+  // Inserts at the located position, constructing the value from initializer.
+  //
+  // Where the map has `emplace_hint`, the key is constructed in place in the
+  // node, rather than converted to a temporary `key_type` and moved. This lets
+  // keys such as std::string_view build a std::string key directly, and lets
+  // an allocator-aware key use the map's allocator.
+  //
+  // With a pool, a recycled node is used if there is one, assigning the key and
+  // value over its old ones, so that they can reuse their storage too.
+  template <typename... Args>
+  void Insert(Args&&... args) {
+    if constexpr (!std::is_void_v<PoolT>) {
+      if (auto node = pool_->Take()) {
+        node.key() = std::forward<FinderT>(key_);
+        if constexpr (details::is_assignable_from_v<ValueT, Args...>)
+          node.mapped() = (std::forward<Args>(args), ...);
+        else
+          node.mapped() = ValueT(std::forward<Args>(args)...);
+        it_ = map_.insert(it_, std::move(node));
+        found_ = true;
+        return;
+      }
+    }
+    if constexpr (details::has_prepare_insert_v<MapT>)
+      it_ = map_.emplace_prepared(prepared_,
+                                  std::forward<FinderT>(key_),
+                                  std::forward<Args>(args)...);
+    else if constexpr (details::has_emplace_hint_v<MapT>)
+      it_ = map_.emplace_hint(
+          it_,
+          std::piecewise_construct,
+          std::forward_as_tuple(std::forward<FinderT>(key_)),
+          std::forward_as_tuple(std::forward<Args>(args)...));
+    else
+      it_ = map_.try_emplace(
+          it_, std::forward<FinderT>(key_), std::forward<Args>(args)...);
+    found_ = true;
+  }
+
+  // Returns whether located entry matches key.
+  bool IsMatch() const {
+    if (it_ == map_.end()) return false;
+    if constexpr (details::is_ordered_map_v<MapT>)
+      return !map_.key_comp()(key_, it_->first);
+    else
+      return true;
+  }
+
   MapT& map_;
   FinderT key_;
+  // Set by Locate along with it_, so declared first.
+  typename details::prepared_insert<MapT>::type prepared_;
   IterT it_;
   bool found_;
+  PoolT* pool_ = nullptr;
 };
 
+// MapKey for std::map, which is the common case.
+template <typename KeyT,
+          typename ValueT,
+          typename CompareT,
+          typename AllocatorT,
+          typename FinderT>
+using MapKey =
+    BasicMapKey<std::map<KeyT, ValueT, CompareT, AllocatorT>, FinderT>;
+
 // Use this helper to make MapKey instances.
 template <typename KeyT,
           typename ValueT,
@@ -414,4 +775,308 @@ MapKey<KeyT, ValueT, CompareT, AllocatorT, FinderT> MakeMapKey(
       m, std::forward<FinderT>(key));
 }
 
-}  // namespace beeswax::nectar
\ No newline at end of file
+// Sets values from a range of key/value pairs sorted by the map's order,
+// inserting if necessary. Returns the number inserted.
+//
+// Usage:
+//    BulkUpsert(campaigns, sorted_feed);
+//    BulkUpsert(campaigns,
+//               std::make_move_iterator(feed.begin()),
+//               std::make_move_iterator(feed.end()));
+//
+// Example without helper:
+//    for (auto& [k, v] : sorted_feed) MakeMapKey(campaigns, k).Assign(v);
+//
+// Each search starts where the last one left off, so loading sorted input is
+// amortized O(n), instead of O(n log n) for searching from scratch each time.
+// Unsorted input still works, just without the speedup.
+//
+// Works with any ordered map, such as StringMap or StringFlatMap. However,
+// each insert into a StringFlatMap is linear, so to build one from scratch,
+// prefer its range constructor.
+template <typename MapT, typename InputIt>
+size_t BulkUpsert(MapT& m, InputIt first, InputIt last) {
+  return details::SortedUpsert(
+      m, first, last, [](auto& value, auto&& new_value) {
+        value = std::forward<decltype(new_value)>(new_value);
+      });
+}
+
+template <typename MapT, typename Range>
+size_t BulkUpsert(MapT& m, const Range& items) {
+  return BulkUpsert(m, std::begin(items), std::end(items));
+}
+
+// Adds entries from `src` whose keys aren't in `dst`, in one pass over both.
+// For keys in both, keeps the value in `dst`, as with `std::map::merge`, or
+// if specified, calls `combine(dst_value, src_value)`. Returns the number of
+// entries added.
+//
+// Usage:
+//    MergeInto(totals, todays_totals, [](int64_t& l, int64_t r) { l += r; });
+//
+// Example without helper:
+//    for (auto& [k, v] : todays_totals) *MakeMapKey(totals, k) += v;
+//
+// Both must be ordered the same way, as two StringMaps are. If `src` is an
+// rvalue, its values are moved.
+template <typename MapT, typename SrcT, typename CombineT>
+size_t MergeInto(MapT& dst, SrcT&& src, CombineT combine) {
+  if constexpr (std::is_rvalue_reference_v<SrcT&&>)
+    return details::SortedUpsert(dst,
+                                 std::make_move_iterator(src.begin()),
+                                 std::make_move_iterator(src.end()),
+                                 combine);
+  else
+    return details::SortedUpsert(dst, src.begin(), src.end(), combine);
+}
+
+template <typename MapT, typename SrcT>
+size_t MergeInto(MapT& dst, SrcT&& src) {
+  return MergeInto(dst, std::forward<SrcT>(src), [](auto&, auto&&) {});
+}
+
+// Internal implementation details; do not use.
+namespace details {
+// Erases entries for which `erase(key)` is true, calling it for each key in
+// order, and returns the number erased.
+//
+// Ordered maps erase each run of consecutive entries with one range erase,
+// which a StringFlatMap does with a single shift instead of one per entry.
+template <typename MapT, typename EraseP>
+size_t EraseKeysIf(MapT& m, EraseP erase) {
+  size_t erased = 0;
+  if constexpr (is_ordered_map_v<MapT>) {
+    for (auto it = m.begin(); it != m.end();) {
+      if (!erase(it->first)) {
+        ++it;
+        continue;
+      }
+      auto run = it;
+      do {
+        ++it;
+        ++erased;
+      } while (it != m.end() && erase(it->first));
+      it = m.erase(run, it);
+    }
+  } else {
+    for (auto it = m.begin(); it != m.end();) {
+      if (erase(it->first)) {
+        it = m.erase(it);
+        ++erased;
+      } else {
+        ++it;
+      }
+    }
+  }
+  return erased;
+}
+}  // namespace details
+
+// Erases entries whose keys aren't in `keys`, in one pass over both. Returns
+// the number erased.
+//
+// The keys can be another map, a set or a sorted range, and must be ordered
+// the same way as the map. Consecutive entries are erased together.
+//
+// Usage:
+//    IntersectKeys(bids, active);
+//
+// Example without helper:
+//    for (auto it = bids.begin(); it != bids.end();)
+//      it = contains(active, it->first) ? std::next(it) : bids.erase(it);
+template <typename MapT, typename KeysT>
+size_t IntersectKeys(MapT& m, const KeysT& keys) {
+  const auto comp = m.key_comp();
+  auto k = std::begin(keys);
+  const auto kend = std::end(keys);
+  return details::EraseKeysIf(m, [&](const auto& key) {
+    while (k != kend && comp(details::SortedKey(*k), key)) ++k;
+    return k == kend || comp(key, details::SortedKey(*k));
+  });
+}
+
+// Erases entries whose keys are in `keys`, in one pass over both. Returns the
+// number erased. See IntersectKeys.
+//
+// As with BulkUpsert, each search steps forward from the previous key's entry
+// before falling back to a full search, so sparse keys cost O(log n) each,
+// rather than a walk over the map.
+//
+// Usage:
+//    SubtractKeys(bids, paused);
+template <typename MapT, typename KeysT>
+size_t SubtractKeys(MapT& m, const KeysT& keys) {
+  const auto comp = m.key_comp();
+  // Entries in [run, it) are all to be erased.
+  auto run = m.begin();
+  auto it = run;
+  size_t erased = 0;
+  for (const auto& item : keys) {
+    const auto& k = details::SortedKey(item);
+    if (it != m.end() && comp(it->first, k)) {
+      it = m.erase(run, it);
+      int steps = 0;
+      while (it != m.end() && comp(it->first, k)) {
+        if (++steps == details::kSortedSeekSteps) {
+          it = m.lower_bound(k);
+          break;
+        }
+        ++it;
+      }
+      run = it;
+    }
+    if (it == m.end()) break;
+    if (!comp(k, it->first)) {
+      ++it;
+      ++erased;
+    }
+  }
+  m.erase(run, it);
+  return erased;
+}
+
+// Internal implementation details; do not use.
+namespace details {
+// Helper sniffer for whether ids are a dense bitset, indexed by integer key.
+template <typename T>
+constexpr bool is_bitset_v = false;
+
+template <typename A>
+constexpr bool is_bitset_v<std::vector<bool, A>> = true;
+
+template <size_t N>
+constexpr bool is_bitset_v<std::bitset<N>> = true;
+
+// Helper sniffer for whether ids can be searched with `find`, as sets and maps,
+// hashed or ordered, can.
+template <typename T, typename K, typename = void>
+constexpr bool has_find_v = false;
+
+template <typename T, typename K>
+constexpr bool has_find_v<
+    T,
+    K,
+    std::void_t<decltype(std::declval<const T&>().find(std::declval<K>()) ==
+                         std::declval<const T&>().end())>> = true;
+
+// Returns whether the ids include the key. Ranges without `find` must be
+// sorted by `<`.
+template <typename IdsT, typename K>
+bool HasId(const IdsT& ids, const K& k) {
+  if constexpr (is_bitset_v<IdsT>) {
+    auto i = static_cast<size_t>(k);
+    return i < ids.size() && ids[i];
+  } else if constexpr (has_find_v<IdsT, K>) {
+    return ids.find(k) != ids.end();
+  } else {
+    auto it = std::lower_bound(
+        std::begin(ids), std::end(ids), k, [](const auto& item, const K& key) {
+          return SortedKey(item) < key;
+        });
+    return it != std::end(ids) && !(k < SortedKey(*it));
+  }
+}
+
+// Helper sniffer for whether comparator orders keys by `<`.
+template <typename CompareT>
+constexpr bool is_less_v = false;
+
+template <typename T>
+constexpr bool is_less_v<std::less<T>> = true;
+
+template <>
+inline constexpr bool is_less_v<TransparentLessString> = true;
+
+// Whether ordered containers are known to be sorted the same way: by the same
+// comparator, or both by `<`.
+template <typename C, typename D>
+constexpr bool is_same_order_v =
+    std::is_same_v<typename C::key_compare, typename D::key_compare> ||
+    (is_less_v<typename C::key_compare> && is_less_v<typename D::key_compare>);
+
+// Whether RetainKeys and EraseKeys can merge the ids with the map, rather than
+// searching them for each key. That needs ids that are ordered as the map is,
+// or a range, which must be sorted by `<`, into a map that's ordered by it.
+template <typename MapT, typename IdsT>
+constexpr bool IsMergeable() {
+  if constexpr (!is_ordered_map_v<MapT> || is_bitset_v<IdsT>)
+    return false;
+  else if constexpr (is_ordered_map_v<IdsT>)
+    return is_same_order_v<MapT, IdsT>;
+  else
+    return !has_find_v<IdsT, typename MapT::key_type> &&
+           is_less_v<typename MapT::key_compare>;
+}
+
+template <typename MapT, typename IdsT>
+constexpr bool is_mergeable_v = IsMergeable<MapT, IdsT>();
+
+// Below this many map entries per id, EraseKeys on an ordered map scans the
+// map, rather than searching it for each id.
+inline constexpr size_t kEraseKeysScanRatio = 8;
+}  // namespace details
+
+// Erases entries whose keys aren't among `ids`, keeping the rest. Returns the
+// number erased.
+//
+// Usage:
+//    RetainKeys(targeting, active_campaign_ids);
+//
+// Example without helper:
+//    erase_if(targeting, [&](auto& kv) {
+//      return !contains(active_campaign_ids, kv.first); });
+//
+// Picks the cheapest pass for the kinds of map and ids:
+// - For an ordered map, and ids that are an ordered set or map with the same
+//   ordering, or a range sorted by `<` for a map ordered by it, merges the two
+//   in one pass, as IntersectKeys does.
+// - For ids that are a hash set or map, looks up each key, in O(1).
+// - For ids that are a std::vector<bool> or std::bitset, indexed by integer
+//   key, tests each key's bit.
+// Ordered maps erase runs of consecutive entries together, which avoids a
+// shift per entry for a StringFlatMap. For unordered maps, a range of ids is
+// searched with std::lower_bound, so must be sorted by `<`.
+template <typename MapT, typename IdsT>
+size_t RetainKeys(MapT& m, const IdsT& ids) {
+  if constexpr (details::is_mergeable_v<MapT, IdsT>)
+    return IntersectKeys(m, ids);
+  else
+    return details::EraseKeysIf(
+        m, [&](const auto& k) { return !details::HasId(ids, k); });
+}
+
+// Erases entries whose keys are among `ids`. Returns the number erased. See
+// RetainKeys.
+//
+// Usage:
+//    EraseKeys(targeting, paused_campaign_ids);
+//
+// When the ids can't be merged with the map, and there are fewer of them than
+// entries, or an eighth as many for an ordered map, each id is looked up and
+// erased, rather than scanning the whole map.
+template <typename MapT, typename IdsT>
+size_t EraseKeys(MapT& m, const IdsT& ids) {
+  if constexpr (details::is_mergeable_v<MapT, IdsT>) {
+    return SubtractKeys(m, ids);
+  } else {
+    if constexpr (!details::is_bitset_v<IdsT>) {
+      const size_t ratio =
+          details::is_ordered_map_v<MapT> ? details::kEraseKeysScanRatio : 1;
+      if (std::size(ids) * ratio < m.size()) {
+        size_t erased = 0;
+        for (const auto& item : ids) {
+          auto it = m.find(details::SortedKey(item));
+          if (it == m.end()) continue;
+          m.erase(it);
+          ++erased;
+        }
+        return erased;
+      }
+    }
+    return details::EraseKeysIf(
+        m, [&](const auto& k) { return details::HasId(ids, k); });
+  }
+}
+
+}  // namespace beeswax::nectar
@@ -0,0 +1,325 @@
+// Stable compaction of vectors, for erasing many elements in one pass.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace beeswax::nectar {
+
+// Internal implementation details; do not use.
+namespace details {
+// Elements are tested this many at a time, collecting a bit for each one to
+// keep, before the batch is compacted.
+inline constexpr size_t kCompactBatch = 512;
+inline constexpr size_t kCompactWords = kCompactBatch / 64;
+
+// Helper sniffer for whether vector elements can be compacted as raw bytes.
+// std::vector<bool> is excluded, since it packs its elements as bits.
+template <typename T>
+constexpr bool is_compactable_v =
+    std::is_trivially_copyable_v<T> && !std::is_same_v<T, bool>;
+
+// Whether there are SIMD kernels for compacting the elements. Others are
+// moved one memmove at a time, which std::remove_if beats.
+template <typename T>
+constexpr bool has_simd_compact_v =
+#if defined(__x86_64__) || defined(__i386__)
+    is_compactable_v<T> && (sizeof(T) == 4 || sizeof(T) == 8);
+#else
+    false;
+#endif
+
+inline bool KeepBit(const uint64_t* keep, size_t i) noexcept {
+  return (keep[i / 64] >> (i % 64)) & 1;
+}
+
+// Sets a bit in `keep` for each of the `n` elements at `p` that doesn't match
+// predicate, calling it once for each, in order.
+//
+// The predicate's results are stored as bytes, without branching on them, so
+// that a simple predicate, such as a comparison, doesn't cost a mispredicted
+// branch per element, and the loop may be vectorized by the compiler. Each 8
+// bytes are then packed into 8 bits with a multiply, which moves byte i's low
+// bit to bit 56 + i without any of the products colliding.
+template <typename T, typename Pred>
+void KeepBits(T* p, size_t n, Pred& pred, uint64_t* keep) {
+  for (size_t w = 0; w * 64 < n; ++w) {
+    const size_t m = std::min<size_t>(64, n - w * 64);
+    uint8_t flags[64] = {};
+    if (m == 64) {
+      // A constant count, so that -O2 vectorizes it.
+      for (size_t j = 0; j < 64; ++j) flags[j] = !pred(p[w * 64 + j]);
+    } else {
+      for (size_t j = 0; j < m; ++j) flags[j] = !pred(p[w * 64 + j]);
+    }
+    uint64_t bits = 0;
+    for (size_t b = 0; b < 8; ++b) {
+      uint64_t bytes;
+      std::memcpy(&bytes, flags + b * 8, 8);
+      bits |= (bytes * 0x0102040810204080 >> 56) << (b * 8);
+    }
+    keep[w] = bits;
+  }
+}
+
+// Each kernel copies the `n` elements at `in` whose bits are set in `keep` to
+// `out`, in order, returning how many. `out` may be `in`, or before it in the
+// same array. Kernels differ only in speed.
+//
+// The SIMD kernels compact a vector of elements at a time, storing all of its
+// lanes and then advancing by the number kept. Since `out` trails `in`, the
+// extra lanes only overwrite elements that have already been loaded.
+using CompactFn = size_t (*)(char* out,
+                             const char* in,
+                             const uint64_t* keep,
+                             size_t n) noexcept;
+
+template <size_t kSize>
+size_t CompactScalar(char* out,
+                     const char* in,
+                     const uint64_t* keep,
+                     size_t n) noexcept {
+  size_t k = 0;
+  for (size_t i = 0; i < n; i += 64) {
+    const size_t m = std::min<size_t>(64, n - i);
+    uint64_t bits = keep[i / 64];
+    if (m == 64 && !~bits) {
+      std::memmove(out + k * kSize, in + i * kSize, 64 * kSize);
+      k += 64;
+      continue;
+    }
+    for (size_t j = 0; j < m; ++j, bits >>= 1) {
+      std::memmove(out + k * kSize, in + (i + j) * kSize, kSize);
+      k += bits & 1;
+    }
+  }
+  return k;
+}
+
+// For each 8-bit mask, the positions of its set bits, in order, one per byte.
+constexpr std::array<uint64_t, 256> MakeCompactIndexes() {
+  std::array<uint64_t, 256> indexes{};
+  for (uint64_t m = 0; m < 256; ++m) {
+    size_t k = 0;
+    for (uint64_t b = 0; b < 8; ++b)
+      if ((m >> b) & 1) indexes[m] |= b << (8 * k++);
+  }
+  return indexes;
+}
+
+inline constexpr std::array<uint64_t, 256> kCompactIndexes =
+    MakeCompactIndexes();
+
+// For each 4-bit mask of 64-bit lanes, the 8-bit mask of their 32-bit halves.
+inline constexpr uint8_t kCompactHalves[16] = {
+    0x00, 0x03, 0x0C, 0x0F, 0x30, 0x33, 0x3C, 0x3F,
+    0xC0, 0xC3, 0xCC, 0xCF, 0xF0, 0xF3, 0xFC, 0xFF};
+
+#if defined(__x86_64__) || defined(__i386__)
+// Compacts 8 32-bit lanes by the 8-bit mask.
+__attribute__((target("avx2"))) inline __m256i CompactLanesAvx2(
+    __m256i v,
+    unsigned m) noexcept {
+  const __m256i idx = _mm256_cvtepu8_epi32(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&kCompactIndexes[m])));
+  return _mm256_permutevar8x32_epi32(v, idx);
+}
+
+__attribute__((target("avx2"))) inline size_t Compact32Avx2(
+    char* out,
+    const char* in,
+    const uint64_t* keep,
+    size_t n) noexcept {
+  size_t k = 0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const unsigned m = (keep[i / 64] >> (i % 64)) & 0xFF;
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * 4));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k * 4),
+                        CompactLanesAvx2(v, m));
+    k += __builtin_popcount(m);
+  }
+  for (; i < n; ++i) {
+    std::memmove(out + k * 4, in + i * 4, 4);
+    k += KeepBit(keep, i);
+  }
+  return k;
+}
+
+__attribute__((target("avx2"))) inline size_t Compact64Avx2(
+    char* out,
+    const char* in,
+    const uint64_t* keep,
+    size_t n) noexcept {
+  size_t k = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const unsigned m = (keep[i / 64] >> (i % 64)) & 0xF;
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * 8));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k * 8),
+                        CompactLanesAvx2(v, kCompactHalves[m]));
+    k += __builtin_popcount(m);
+  }
+  for (; i < n; ++i) {
+    std::memmove(out + k * 8, in + i * 8, 8);
+    k += KeepBit(keep, i);
+  }
+  return k;
+}
+
+__attribute__((target("avx512f"))) inline size_t Compact32Avx512(
+    char* out,
+    const char* in,
+    const uint64_t* keep,
+    size_t n) noexcept {
+  size_t k = 0;
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const auto m = static_cast<__mmask16>(keep[i / 64] >> (i % 64));
+    const __m512i v = _mm512_loadu_si512(in + i * 4);
+    _mm512_storeu_si512(out + k * 4, _mm512_maskz_compress_epi32(m, v));
+    k += __builtin_popcount(m);
+  }
+  for (; i < n; ++i) {
+    std::memmove(out + k * 4, in + i * 4, 4);
+    k += KeepBit(keep, i);
+  }
+  return k;
+}
+
+__attribute__((target("avx512f"))) inline size_t Compact64Avx512(
+    char* out,
+    const char* in,
+    const uint64_t* keep,
+    size_t n) noexcept {
+  size_t k = 0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const auto m = static_cast<__mmask8>(keep[i / 64] >> (i % 64));
+    const __m512i v = _mm512_loadu_si512(in + i * 8);
+    _mm512_storeu_si512(out + k * 8, _mm512_maskz_compress_epi64(m, v));
+    k += __builtin_popcount(m);
+  }
+  for (; i < n; ++i) {
+    std::memmove(out + k * 8, in + i * 8, 8);
+    k += KeepBit(keep, i);
+  }
+  return k;
+}
+#endif
+
+// Returns the fastest kernel this CPU supports for elements of the size,
+// chosen once at runtime.
+template <size_t kSize>
+CompactFn GetCompact() noexcept {
+  static const CompactFn fn = [] {
+#if defined(__x86_64__) || defined(__i386__)
+    if constexpr (kSize == 4 || kSize == 8) {
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx512f"))
+        return kSize == 4 ? &Compact32Avx512 : &Compact64Avx512;
+      if (__builtin_cpu_supports("avx2"))
+        return kSize == 4 ? &Compact32Avx2 : &Compact64Avx2;
+    }
+#endif
+    return static_cast<CompactFn>(&CompactScalar<kSize>);
+  }();
+  return fn;
+}
+
+// Moves the `n` elements from `data + base` whose bits are set in `keep` to
+// `data + k`, in order, returning how many.
+template <typename T>
+size_t CompactBatch(T* data,
+                    size_t k,
+                    size_t base,
+                    const uint64_t* keep,
+                    size_t n) {
+  if constexpr (is_compactable_v<T>) {
+    return GetCompact<sizeof(T)>()(reinterpret_cast<char*>(data + k),
+                                   reinterpret_cast<const char*>(data + base),
+                                   keep,
+                                   n);
+  } else {
+    size_t kept = 0;
+    for (size_t i = 0; i < n; ++i) {
+      if (!KeepBit(keep, i)) continue;
+      if (k + kept != base + i) data[k + kept] = std::move(data[base + i]);
+      ++kept;
+    }
+    return kept;
+  }
+}
+
+// Erases elements matching predicate from the vector and, row for row, from
+// each of the other vectors, keeping the rest in order. Returns the number
+// erased.
+template <typename T, typename A, typename Pred, typename... Columns>
+size_t EraseRowsIf(std::vector<T, A>& column, Pred& pred, Columns&... others) {
+  const size_t n = column.size();
+  // Nothing moves before the first row erased, so find it as
+  // std::remove_if does, and batch only the rows after it.
+  const auto it =
+      std::find_if(column.begin(), column.end(), [&](T& e) { return pred(e); });
+  const size_t first = it - column.begin();
+  if (first == n) return 0;
+  uint64_t keep[kCompactWords];
+  size_t k = first;
+  for (size_t base = first + 1; base < n; base += kCompactBatch) {
+    const size_t m = std::min(kCompactBatch, n - base);
+    KeepBits(column.data() + base, m, pred, keep);
+    const size_t kept = CompactBatch(column.data(), k, base, keep, m);
+    (CompactBatch(others.data(), k, base, keep, m), ...);
+    k += kept;
+  }
+  column.erase(column.begin() + k, column.end());
+  (others.erase(others.begin() + k, others.end()), ...);
+  return n - k;
+}
+}  // namespace details
+
+// Erases the rows of a table stored as a structure of arrays, one vector per
+// column, where the element of `column` matches predicate. Rows are erased
+// from every column alike, keeping the rest in order. Returns the number of
+// rows erased. Throws std::invalid_argument if the columns differ in size.
+//
+// Usage:
+//    EraseRowsIf(bids.price, [&](int64_t p) { return p < floor; },
+//                bids.campaign, bids.creative);
+//
+// Example without helper:
+//    size_t k = 0;
+//    for (size_t i = 0; i < bids.price.size(); ++i) {
+//      if (bids.price[i] < floor) continue;
+//      bids.price[k] = bids.price[i];
+//      bids.campaign[k] = std::move(bids.campaign[i]);
+//      bids.creative[k++] = std::move(bids.creative[i]);
+//    }
+//    ... and resize each.
+//
+// The predicate is called once per row of `column`, in order, and the results
+// are collected as a bitmask, a batch at a time, so it's best as a simple,
+// branch-free test. Columns of trivially copyable elements of 4 or 8 bytes
+// are then compacted with AVX2 or AVX-512, where available; others are moved
+// element by element.
+template <typename T, typename A, typename Pred, typename... Columns>
+size_t EraseRowsIf(std::vector<T, A>& column, Pred pred, Columns&... others) {
+  if (((others.size() != column.size()) || ...))
+    throw std::invalid_argument("EraseRowsIf: columns differ in size");
+  return details::EraseRowsIf(column, pred, others...);
+}
+
+}  // namespace beeswax::nectar
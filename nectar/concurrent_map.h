@@ -0,0 +1,226 @@
+// Sharded string-keyed map for sharing between threads.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "collections.h"
+#include "hash_map.h"
+
+namespace beeswax::nectar {
+
+// A ConcurrentStringMap is a thread-safe map keyed on std::string, where the
+// value defaults to std::string but can be specified.
+//
+// Entries are spread over shards by hash, and each shard is a StringHashMap
+// with its own reader/writer lock, on its own cache line. So threads working
+// on different keys rarely contend, and readers of the same shard don't block
+// each other at all. Lookup is transparent, as with StringHashMap, and each key
+// is hashed once, to pick its shard and to search it.
+//
+// Usage:
+//    ConcurrentStringMap<int64_t> spend;
+//    spend.Upsert(campaign, 0);
+//    auto budget = budgets.DefaultValueCb(campaign, [&] { return Load(); });
+//    spend.WithMapKey(campaign, [&](auto& mk) { *mk += price; });
+//
+// Since another thread may change an entry as soon as its lock is released,
+// lookups return copies rather than references. To read or change a value in
+// place, pass a callback to Visit, Update or WithMapKey, which run it under
+// the shard's lock. Callbacks must not call back into the same map.
+template <typename V = std::string>
+class ConcurrentStringMap {
+ public:
+  using key_type = std::string;
+  using mapped_type = V;
+  using size_type = std::size_t;
+  using ShardMap = StringHashMap<V>;
+
+  static constexpr size_type kDefaultShards = 64;
+
+  // Constructs an empty map, with the number of shards rounded up to a power
+  // of two, as for ConcurrentStringCache. More shards mean less contention, at
+  // the cost of memory.
+  explicit ConcurrentStringMap(size_type shards = kDefaultShards)
+      : shard_bits_(details::ShardBits(shards)),
+        shards_(new Shard[size_type{1} << shard_bits_]) {}
+
+  ConcurrentStringMap(const ConcurrentStringMap&) = delete;
+  ConcurrentStringMap& operator=(const ConcurrentStringMap&) = delete;
+
+  size_type shard_count() const noexcept { return size_type{1} << shard_bits_; }
+
+  // Returns the number of entries. Under concurrent changes, this is only a
+  // snapshot, since the shards are counted one at a time.
+  size_type size() const {
+    size_type n = 0;
+    ForEachShard([&](const ShardMap& m) { n += m.size(); });
+    return n;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  void clear() {
+    ForEachShard([](ShardMap& m) { m.clear(); });
+  }
+
+  template <typename K>
+  bool contains(const K& k) const {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    std::shared_lock lock(shard.mutex);
+    return shard.map.contains(hk);
+  }
+
+  // Returns a copy of the value, or nullopt if not found.
+  template <typename K>
+  std::optional<V> Find(const K& k) const {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    std::shared_lock lock(shard.mutex);
+    if (auto* v = FindPtr(shard.map, hk)) return *v;
+    return std::nullopt;
+  }
+
+  // Returns a copy of the value, or if not found, the specified default.
+  template <typename K>
+  V FindOrDefault(const K& k, const V& def = V()) const {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    std::shared_lock lock(shard.mutex);
+    return nectar::FindOrDefault(shard.map, hk, def);
+  }
+
+  // Calls `f(const V&)` with the value under a shared lock, if found. Returns
+  // whether found.
+  template <typename K, typename F>
+  bool Visit(const K& k, F&& f) const {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    std::shared_lock lock(shard.mutex);
+    auto* v = FindPtr(shard.map, hk);
+    if (v) f(*v);
+    return v;
+  }
+
+  // Calls `f(V&)` with the value under an exclusive lock, if found. Returns
+  // whether found.
+  template <typename K, typename F>
+  bool Update(const K& k, F&& f) {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    std::unique_lock lock(shard.mutex);
+    auto* v = FindPtr(shard.map, hk);
+    if (v) f(*v);
+    return v;
+  }
+
+  // Sets value, inserting if necessary. Returns whether inserted. This is
+  // MapKey's Assign, done atomically.
+  template <typename K, typename M>
+  bool Upsert(const K& k, M&& value) {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    std::unique_lock lock(shard.mutex);
+    return MakeMapKey(shard.map, hk).Assign(std::forward<M>(value));
+  }
+
+  // Returns a copy of the value. If none, first sets value to return from
+  // callback. This is MapKey's DefaultValueCb, done atomically, so the callback
+  // is only invoked by one thread, once, for each key inserted.
+  //
+  // Found values only take a shared lock. The callback runs under the shard's
+  // exclusive lock, so keep it cheap.
+  template <typename K,
+            typename Cb,
+            std::enable_if_t<std::is_invocable_r_v<V, Cb>, int> = 0>
+  V DefaultValueCb(const K& k, Cb cb) {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    {
+      std::shared_lock lock(shard.mutex);
+      if (auto* v = FindPtr(shard.map, hk)) return *v;
+    }
+    std::unique_lock lock(shard.mutex);
+    return MakeMapKey(shard.map, hk).DefaultValueCb(cb);
+  }
+
+  // Calls `f(mk)` under an exclusive lock, where `mk` is a MapKey for the key
+  // in its shard, and returns the result. This makes any combination of MapKey
+  // operations atomic.
+  //
+  // Usage:
+  //    m.WithMapKey(key, [](auto& mk) {
+  //      if (!mk || *mk < bid) mk.Assign(bid);
+  //    });
+  template <typename K, typename F>
+  decltype(auto) WithMapKey(const K& k, F&& f) {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    std::unique_lock lock(shard.mutex);
+    auto mk = MakeMapKey(shard.map, hk);
+    return f(mk);
+  }
+
+  // Erases entry, returning number erased.
+  template <typename K>
+  size_type erase(const K& k) {
+    const auto hk = Hashed(k);
+    auto& shard = ShardFor(hk);
+    std::unique_lock lock(shard.mutex);
+    return shard.map.erase(hk);
+  }
+
+  // Calls `f(const ShardMap&)` for each shard, in turn, under its shared lock.
+  // Since only one shard is locked at a time, this isn't a consistent
+  // snapshot of the whole map.
+  template <typename F>
+  void ForEachShard(F&& f) const {
+    for (size_type i = 0; i < shard_count(); ++i) {
+      std::shared_lock lock(shards_[i].mutex);
+      f(static_cast<const ShardMap&>(shards_[i].map));
+    }
+  }
+
+  // Calls `f(ShardMap&)` for each shard, in turn, under its exclusive lock.
+  template <typename F>
+  void ForEachShard(F&& f) {
+    for (size_type i = 0; i < shard_count(); ++i) {
+      std::unique_lock lock(shards_[i].mutex);
+      f(shards_[i].map);
+    }
+  }
+
+ private:
+  struct alignas(details::kCacheLineSize) Shard {
+    mutable std::shared_mutex mutex;
+    ShardMap map;
+  };
+
+  // Hashes the key, unless it already carries its hash, so that choosing the
+  // shard and searching it share the one hash.
+  template <typename K>
+  static HashedStringView Hashed(const K& k) noexcept {
+    return HashedStringView(std::string_view(k),
+                            static_cast<uint64_t>(StringHash{}(k)));
+  }
+
+  // Uses the top bits of the hash. The shard's map mixes all of them, so its
+  // keys sharing these doesn't crowd them together.
+  Shard& ShardFor(HashedStringView k) const {
+    return shards_[shard_bits_ ? k.hash() >> (64 - shard_bits_) : 0];
+  }
+
+  const size_type shard_bits_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+}  // namespace beeswax::nectar
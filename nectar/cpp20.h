@@ -9,6 +9,8 @@
 #include <type_traits>
 #include <vector>
 
+#include "compact.h"
+
 namespace beeswax::nectar {
 
 // Placeholder for C++20 std version.
@@ -25,6 +27,22 @@ bool contains(C& c, const K& k) {
   return c.find(k) != c.end();
 }
 
+#if defined(__cpp_lib_erase_if)
+// With C++20, the std versions take over, so that unqualified calls aren't
+// ambiguous.
+using std::erase_if;
+
+// Vectors of trivially copyable 4- and 8-byte elements are compacted in
+// batches instead, as below. Being more constrained, this is chosen over the
+// std version.
+template <class T, class Alloc, class Pred>
+  requires details::has_simd_compact_v<T>
+constexpr typename std::vector<T, Alloc>::size_type erase_if(
+    std::vector<T, Alloc>& c, Pred pred) {
+  if (std::is_constant_evaluated()) return std::erase_if(c, pred);
+  return details::EraseRowsIf(c, pred);
+}
+#else
 // Placeholder for C++20 std version.
 //
 // See: https://en.cppreference.com/w/cpp/container/map/erase_if
@@ -50,22 +68,41 @@ void erase_if(std::map<Key, T, Compare, Alloc>& c, Pred pred) {
 // Usage:
 //    nectar::erase_if(v, [&](auto& elm) {
 //      return !nectar::contains(ids, elm); });
+//
+// Vectors of trivially copyable 4- and 8-byte elements are compacted in
+// batches, as by EraseRowsIf, so that the predicate's result is never branched
+// on, and moved with AVX2 or AVX-512. Other elements are left to
+// std::remove_if, which is faster than compacting them one at a time. Either
+// way, elements are kept in order, and the predicate is called once for each,
+// in order.
 template <class T, class Alloc, class Pred>
 constexpr typename std::vector<T, Alloc>::size_type erase_if(
     std::vector<T, Alloc>& c, Pred pred) {
+  if constexpr (details::has_simd_compact_v<T>)
+    return details::EraseRowsIf(c, pred);
   auto it = std::remove_if(c.begin(), c.end(), pred);
   auto r = std::distance(it, c.end());
   c.erase(it, c.end());
   return r;
 }
+#endif
 
+// Compares the bytes directly, rather than through `compare`, which checks
+// bounds, clamps lengths and orders the result, none of which is needed here.
+// The comparison is a memcmp, which the compiler inlines for short prefixes
+// and which is vectorized for long ones.
 constexpr bool starts_with(std::string_view whole, std::string_view part) {
-  return whole.compare(0, part.size(), part) == 0;
+  return whole.size() >= part.size() &&
+         std::char_traits<char>::compare(
+             whole.data(), part.data(), part.size()) == 0;
 }
 
 constexpr bool ends_with(std::string_view whole, std::string_view part) {
-  if (whole.size() < part.size()) return false;
-  return whole.compare(whole.size() - part.size(), part.size(), part) == 0;
+  return whole.size() >= part.size() &&
+         std::char_traits<char>::compare(whole.data() + whole.size() -
+                                             part.size(),
+                                         part.data(),
+                                         part.size()) == 0;
 }
 
 }  // namespace beeswax::nectar
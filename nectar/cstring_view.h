@@ -1,8 +1,13 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
 #include <stdexcept>
+#include <string>
 #include <string_view>
 
+#include "hash.h"
+
 namespace beeswax::nectar {
 
 // cstring_view, which derives from std::string_view but supports c_str().
@@ -57,15 +62,19 @@ class basic_cstring_view : public std::basic_string_view<CharT, Traits> {
   // Expose terminated const char*.
   constexpr const CharT* c_str() const noexcept { return base::data(); }
 
-  // Redundant with C++20.
-  constexpr bool starts_with(const std::basic_string_view<CharT>& str) {
-    return base::compare(0, str.size(), str) == 0;
+  // Redundant with C++20. Compares the bytes directly, rather than through
+  // `compare`.
+  constexpr bool starts_with(const std::basic_string_view<CharT>& str) const {
+    return base::size() >= str.size() &&
+           Traits::compare(base::data(), str.data(), str.size()) == 0;
   }
 
   // Redundant with C++20.
-  constexpr bool ends_with(const std::basic_string_view<CharT>& str) {
-    if (base::size() < str.size()) return false;
-    return base::compare(base::size() - str.size(), str.size(), str) == 0;
+  constexpr bool ends_with(const std::basic_string_view<CharT>& str) const {
+    return base::size() >= str.size() &&
+           Traits::compare(base::data() + base::size() - str.size(),
+                           str.data(),
+                           str.size()) == 0;
   }
 
   // Removing suffix would break termination, so we don't support it.
@@ -95,6 +104,84 @@ using wcstring_view = basic_cstring_view<wchar_t>;
 using u16cstring_view = basic_cstring_view<char16_t>;
 using u32cstring_view = basic_cstring_view<char32_t>;
 
+// A terminated copy of a string, for passing a std::string_view to a C API.
+// Use ToCString to make these.
+//
+// The copy is held inline, up to `kInlineSize` bytes including the NUL, so
+// the common case of a short name or path makes no allocation at all. Longer
+// strings are copied to the heap. Strings already known to be terminated
+// aren't copied at all.
+//
+// The object is neither copyable nor movable, since the view may point into
+// it, so keep it in a local for as long as the view is needed.
+template <size_t kInlineSize>
+class BasicTerminatedCopy {
+ public:
+  // Copies the string, terminating it.
+  explicit BasicTerminatedCopy(std::string_view s) {
+    char* p = buffer_;
+    if (s.size() >= kInlineSize) {
+      heap_.reset(new char[s.size() + 1]);
+      p = heap_.get();
+    }
+    s.copy(p, s.size());
+    p[s.size()] = '\0';
+    view_ = cstring_view(p, s.size());
+  }
+
+  // Refers to an already terminated string, without copying it.
+  explicit BasicTerminatedCopy(cstring_view s) noexcept : view_(s) {}
+
+  BasicTerminatedCopy(const BasicTerminatedCopy&) = delete;
+  BasicTerminatedCopy& operator=(const BasicTerminatedCopy&) = delete;
+
+  const char* c_str() const noexcept { return view_.c_str(); }
+  size_t size() const noexcept { return view_.size(); }
+  cstring_view view() const noexcept { return view_; }
+  operator cstring_view() const noexcept {  // NOLINT, implicit is fine here.
+    return view_;
+  }
+
+ private:
+  char buffer_[kInlineSize];
+  std::unique_ptr<char[]> heap_;
+  cstring_view view_;
+};
+
+using TerminatedCopy = BasicTerminatedCopy<256>;
+
+// Returns a terminated version of the string, copying it only if it isn't
+// already known to be terminated, which is to say it's a std::string_view, or
+// a temporary std::string that may die first. Copies of up to 255 characters
+// are made without allocating. The result must outlive any use of its pointer.
+//
+// Usage:
+//    const char* home = getenv(ToCString(name).c_str());
+//
+// Example without helper:
+//    const char* home = getenv(std::string(name).c_str());
+inline TerminatedCopy ToCString(std::string_view s) {
+  return TerminatedCopy(s);
+}
+
+inline TerminatedCopy ToCString(cstring_view s) noexcept {
+  return TerminatedCopy(s);
+}
+
+inline TerminatedCopy ToCString(const std::string& s) noexcept {
+  return TerminatedCopy(cstring_view(s));
+}
+
+// A temporary string dies at the end of the full expression, while the result
+// may be kept, as in `auto path = ToCString(GetPath())`, so it's copied.
+inline TerminatedCopy ToCString(std::string&& s) {
+  return TerminatedCopy(std::string_view(s));
+}
+
+inline TerminatedCopy ToCString(const char* s) noexcept {
+  return TerminatedCopy(cstring_view(s));
+}
+
 inline constexpr basic_cstring_view<char> operator"" _sz(const char* str,
                                                          size_t len) noexcept {
   return basic_cstring_view<char>{str, len};
@@ -117,10 +204,11 @@ inline constexpr basic_cstring_view<char32_t> operator"" _sz(
 
 }  // namespace beeswax::nectar
 
-// Provide a specialization of std::hash for cstring_view.
+// Provide a specialization of std::hash for cstring_view, using the same
+// Hash64 as StringHash.
 template <>
 struct std::hash<beeswax::nectar::cstring_view> {
   size_t operator()(const beeswax::nectar::cstring_view& of) const noexcept {
-    return std::hash<std::string_view>()(of);
+    return beeswax::nectar::Hash64(of);
   }
 };
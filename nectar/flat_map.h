@@ -0,0 +1,426 @@
+// Sorted flat map for read-mostly lookup tables.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "collections.h"
+
+namespace beeswax::nectar {
+
+// A StringFlatMap is a map keyed on std::string and kept in sorted order in
+// contiguous storage, where the value defaults to std::string but can be
+// specified.
+//
+// Keys and values live in separate arrays, so a lookup binary-searches a
+// dense array of keys without pulling values into the cache, and never chases
+// tree nodes scattered across the heap. This makes it a good fit for lookup
+// tables that are built once and read often. In exchange, inserting or erasing
+// is linear in the size of the map and invalidates all iterators.
+//
+// Like StringMap, lookup is transparent, so that the key doesn't have to be
+// converted to a std::string temporary. The interface follows std::map closely
+// enough that FindPtr, FindOrDefault, contains and MakeMapKey all work, and
+// switching between the two is a matter of changing a type alias.
+//
+// Iterators dereference to a pair of references rather than a reference to a
+// pair, since there is no pair in memory to refer to. So prefer `auto` or
+// `const auto&` to `auto&` in range loops.
+template <typename V = std::string>
+class StringFlatMap {
+  template <bool IsConst>
+  class Iterator;
+
+ public:
+  using key_type = std::string;
+  using mapped_type = V;
+  using value_type = std::pair<const std::string, V>;
+  using key_compare = TransparentLessString;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  StringFlatMap() = default;
+
+  // Construct from unsorted initializers. As with std::map, the first of any
+  // duplicate keys wins.
+  StringFlatMap(std::initializer_list<value_type> init)
+      : StringFlatMap(init.begin(), init.end()) {}
+
+  // Construct from an unsorted range of key/value pairs. As with std::map, the
+  // first of any duplicate keys wins.
+  //
+  // This sorts once, so it's much cheaper than inserting one at a time.
+  template <typename InputIt>
+  StringFlatMap(InputIt first, InputIt last) {
+    std::vector<std::pair<std::string, V>> items(first, last);
+    std::stable_sort(items.begin(), items.end(), [](auto& l, auto& r) {
+      return key_compare{}(l.first, r.first);
+    });
+    keys_.reserve(items.size());
+    values_.reserve(items.size());
+    for (auto& item : items) {
+      if (!keys_.empty() && keys_.back() == item.first) continue;
+      keys_.push_back(std::move(item.first));
+      values_.push_back(std::move(item.second));
+    }
+  }
+
+  iterator begin() noexcept { return iterator(this, 0); }
+  const_iterator begin() const noexcept { return const_iterator(this, 0); }
+  const_iterator cbegin() const noexcept { return begin(); }
+  iterator end() noexcept { return iterator(this, size()); }
+  const_iterator end() const noexcept { return const_iterator(this, size()); }
+  const_iterator cend() const noexcept { return end(); }
+
+  bool empty() const noexcept { return keys_.empty(); }
+  size_type size() const noexcept { return keys_.size(); }
+
+  key_compare key_comp() const { return key_compare{}; }
+
+  // Reserves room for this many entries, to avoid reallocation while
+  // inserting.
+  void reserve(size_type n) {
+    keys_.reserve(n);
+    values_.reserve(n);
+  }
+
+  void clear() noexcept {
+    keys_.clear();
+    values_.clear();
+  }
+
+  // Direct access to the sorted keys and their parallel values.
+  const std::vector<std::string>& keys() const noexcept { return keys_; }
+  const std::vector<V>& values() const noexcept { return values_; }
+
+  template <typename K>
+  iterator lower_bound(const K& k) {
+    return iterator(this, LowerBoundIndex(k));
+  }
+
+  template <typename K>
+  const_iterator lower_bound(const K& k) const {
+    return const_iterator(this, LowerBoundIndex(k));
+  }
+
+  template <typename K>
+  iterator find(const K& k) {
+    return iterator(this, FindIndex(k));
+  }
+
+  template <typename K>
+  const_iterator find(const K& k) const {
+    return const_iterator(this, FindIndex(k));
+  }
+
+  template <typename K>
+  size_type count(const K& k) const {
+    return FindIndex(k) != size();
+  }
+
+  template <typename K>
+  bool contains(const K& k) const {
+    return FindIndex(k) != size();
+  }
+
+  // Looks up `n` keys starting at `keys`, calling `cb(i, it)` with the index of
+  // each key and its iterator, or end() if not found, in order. A chunk of
+  // keys is binary-searched in lockstep, prefetching each step's candidates,
+  // so that the cache misses overlap. Prefer FindPtrBatch.
+  template <typename KeyIt, typename Cb>
+  void find_batch(KeyIt keys, size_type n, Cb&& cb) {
+    FindBatch(*this, keys, n, cb);
+  }
+
+  template <typename KeyIt, typename Cb>
+  void find_batch(KeyIt keys, size_type n, Cb&& cb) const {
+    FindBatch(*this, keys, n, cb);
+  }
+
+  template <typename K>
+  V& at(const K& k) {
+    auto i = FindIndex(k);
+    if (i == size()) throw std::out_of_range("StringFlatMap::at");
+    return values_[i];
+  }
+
+  template <typename K>
+  const V& at(const K& k) const {
+    auto i = FindIndex(k);
+    if (i == size()) throw std::out_of_range("StringFlatMap::at");
+    return values_[i];
+  }
+
+  template <typename K>
+  V& operator[](K&& k) {
+    return try_emplace(std::forward<K>(k)).first->second;
+  }
+
+  template <typename K, typename M>
+  std::pair<iterator, bool> insert_or_assign(K&& k, M&& obj) {
+    return InsertOrAssignAt(LowerBoundIndex(k),
+                            std::forward<K>(k),
+                            std::forward<M>(obj));
+  }
+
+  // Hinted insert_or_assign. The hint is where the key would go, as returned
+  // from `lower_bound`. When correct, this skips the search.
+  template <typename K, typename M>
+  iterator insert_or_assign(const_iterator hint, K&& k, M&& obj) {
+    return InsertOrAssignAt(
+               HintIndex(hint, k), std::forward<K>(k), std::forward<M>(obj))
+        .first;
+  }
+
+  template <typename K,
+            typename... Args,
+            std::enable_if_t<!std::is_convertible_v<K, const_iterator>, int> =
+                0>
+  std::pair<iterator, bool> try_emplace(K&& k, Args&&... args) {
+    return TryEmplaceAt(LowerBoundIndex(k),
+                        std::forward<K>(k),
+                        std::forward<Args>(args)...);
+  }
+
+  // Hinted try_emplace. The hint is where the key would go, as returned from
+  // `lower_bound`. When correct, this skips the search.
+  template <typename K, typename... Args>
+  iterator try_emplace(const_iterator hint, K&& k, Args&&... args) {
+    return TryEmplaceAt(HintIndex(hint, k),
+                        std::forward<K>(k),
+                        std::forward<Args>(args)...)
+        .first;
+  }
+
+  std::pair<iterator, bool> insert(const value_type& kv) {
+    return try_emplace(kv.first, kv.second);
+  }
+
+  std::pair<iterator, bool> insert(std::pair<std::string, V>&& kv) {
+    return try_emplace(std::move(kv.first), std::move(kv.second));
+  }
+
+  iterator erase(const_iterator pos) {
+    keys_.erase(keys_.begin() + pos.index_);
+    values_.erase(values_.begin() + pos.index_);
+    return iterator(this, pos.index_);
+  }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    keys_.erase(keys_.begin() + first.index_, keys_.begin() + last.index_);
+    values_.erase(values_.begin() + first.index_,
+                  values_.begin() + last.index_);
+    return iterator(this, first.index_);
+  }
+
+  template <typename K,
+            std::enable_if_t<!std::is_convertible_v<K, const_iterator>, int> =
+                0>
+  size_type erase(const K& k) {
+    auto i = FindIndex(k);
+    if (i == size()) return 0;
+    erase(const_iterator(this, i));
+    return 1;
+  }
+
+  friend bool operator==(const StringFlatMap& l, const StringFlatMap& r) {
+    return l.keys_ == r.keys_ && l.values_ == r.values_;
+  }
+
+  friend bool operator!=(const StringFlatMap& l, const StringFlatMap& r) {
+    return !(l == r);
+  }
+
+ private:
+  template <typename K>
+  size_type LowerBoundIndex(const K& k) const {
+    return std::lower_bound(keys_.begin(), keys_.end(), k, key_compare{}) -
+           keys_.begin();
+  }
+
+  template <typename K>
+  size_type FindIndex(const K& k) const {
+    auto i = LowerBoundIndex(k);
+    if (i != size() && !key_compare{}(k, keys_[i])) return i;
+    return size();
+  }
+
+  // Number of searches in flight at once for find_batch.
+  static constexpr size_type kBatchSize = 16;
+
+  template <typename Self, typename KeyIt, typename Cb>
+  static void FindBatch(Self& self, KeyIt keys, size_type n, Cb& cb) {
+    using It = std::conditional_t<std::is_const_v<Self>,
+                                  const_iterator,
+                                  iterator>;
+    const auto& sorted = self.keys_;
+    const size_type size = sorted.size();
+    size_type bases[kBatchSize];
+    for (size_type start = 0; start < n; start += kBatchSize) {
+      const size_type len = std::min(kBatchSize, n - start);
+      std::fill_n(bases, len, 0);
+      // Every search in the chunk takes the same number of steps, so they
+      // advance together, and each key's next probe is prefetched while the
+      // rest of the chunk takes its step.
+      for (size_type count = size; count > 1;) {
+        const size_type half = count / 2;
+        const size_type next = (count - half) / 2;
+        for (size_type j = 0; j < len; ++j) {
+          auto& base = bases[j];
+          base = key_compare{}(sorted[base + half], keys[start + j])
+                     ? base + half
+                     : base;
+          __builtin_prefetch(sorted.data() + base + next);
+        }
+        count -= half;
+      }
+      for (size_type j = 0; j < len; ++j) {
+        const auto& k = keys[start + j];
+        size_type i = size;
+        if (size) {
+          i = bases[j] + key_compare{}(sorted[bases[j]], k);
+          if (i != size && key_compare{}(k, sorted[i])) i = size;
+        }
+        cb(start + j, It(&self, i));
+      }
+    }
+  }
+
+  // Returns the hint as an index if it's where the key belongs, otherwise
+  // searches for it.
+  template <typename K>
+  size_type HintIndex(const_iterator hint, const K& k) const {
+    auto i = hint.index_;
+    if (i <= size() && (i == 0 || key_compare{}(keys_[i - 1], k)) &&
+        (i == size() || !key_compare{}(keys_[i], k)))
+      return i;
+    return LowerBoundIndex(k);
+  }
+
+  // Given the lower bound for the key, inserts unless it's already there.
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> TryEmplaceAt(size_type i, K&& k, Args&&... args) {
+    if (i != size() && !key_compare{}(k, keys_[i]))
+      return {iterator(this, i), false};
+    values_.emplace(values_.begin() + i, std::forward<Args>(args)...);
+    try {
+      keys_.emplace(keys_.begin() + i, std::forward<K>(k));
+    } catch (...) {
+      values_.erase(values_.begin() + i);
+      throw;
+    }
+    return {iterator(this, i), true};
+  }
+
+  // Given the lower bound for the key, inserts or assigns.
+  template <typename K, typename M>
+  std::pair<iterator, bool> InsertOrAssignAt(size_type i, K&& k, M&& obj) {
+    if (i != size() && !key_compare{}(k, keys_[i])) {
+      values_[i] = std::forward<M>(obj);
+      return {iterator(this, i), false};
+    }
+    return TryEmplaceAt(i, std::forward<K>(k), std::forward<M>(obj));
+  }
+
+  std::vector<std::string> keys_;
+  std::vector<V> values_;
+};
+
+// Iterator over StringFlatMap, which dereferences to a pair of references to
+// the key and value.
+template <typename V>
+template <bool IsConst>
+class StringFlatMap<V>::Iterator {
+  using MapT = std::conditional_t<IsConst, const StringFlatMap, StringFlatMap>;
+  using MappedT = std::conditional_t<IsConst, const V, V>;
+
+ public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = StringFlatMap::value_type;
+  using difference_type = std::ptrdiff_t;
+  using reference = std::pair<const std::string&, MappedT&>;
+
+  // Holds the pair of references so that `it->second` works.
+  struct pointer {
+    reference ref;
+    const reference* operator->() const { return &ref; }
+  };
+
+  Iterator() = default;
+
+  // Allow conversion from iterator to const_iterator.
+  template <bool WasConst, std::enable_if_t<IsConst && !WasConst, int> = 0>
+  Iterator(const Iterator<WasConst>& it)  // NOLINT, implicit is fine here.
+      : map_(it.map_), index_(it.index_) {}
+
+  reference operator*() const {
+    return {map_->keys_[index_], map_->values_[index_]};
+  }
+  pointer operator->() const { return pointer{**this}; }
+  reference operator[](difference_type n) const { return *(*this + n); }
+
+  Iterator& operator++() {
+    ++index_;
+    return *this;
+  }
+  Iterator operator++(int) { return Iterator(map_, index_++); }
+  Iterator& operator--() {
+    --index_;
+    return *this;
+  }
+  Iterator operator--(int) { return Iterator(map_, index_--); }
+  Iterator& operator+=(difference_type n) {
+    index_ += n;
+    return *this;
+  }
+  Iterator& operator-=(difference_type n) {
+    index_ -= n;
+    return *this;
+  }
+  Iterator operator+(difference_type n) const {
+    return Iterator(map_, index_ + n);
+  }
+  Iterator operator-(difference_type n) const {
+    return Iterator(map_, index_ - n);
+  }
+  difference_type operator-(const Iterator& o) const {
+    return static_cast<difference_type>(index_) -
+           static_cast<difference_type>(o.index_);
+  }
+
+  bool operator==(const Iterator& o) const { return index_ == o.index_; }
+  bool operator!=(const Iterator& o) const { return index_ != o.index_; }
+  bool operator<(const Iterator& o) const { return index_ < o.index_; }
+  bool operator>(const Iterator& o) const { return index_ > o.index_; }
+  bool operator<=(const Iterator& o) const { return index_ <= o.index_; }
+  bool operator>=(const Iterator& o) const { return index_ >= o.index_; }
+
+ private:
+  friend class StringFlatMap;
+  template <bool>
+  friend class Iterator;
+
+  Iterator(MapT* map, size_type index) : map_(map), index_(index) {}
+
+  MapT* map_{};
+  size_type index_{};
+};
+
+// Use this helper to make MapKey instances for StringFlatMap.
+template <typename V, typename FinderT>
+BasicMapKey<StringFlatMap<V>, FinderT> MakeMapKey(StringFlatMap<V>& m,
+                                                  FinderT&& key) {
+  return BasicMapKey<StringFlatMap<V>, FinderT>(m, std::forward<FinderT>(key));
+}
+
+}  // namespace beeswax::nectar
@@ -0,0 +1,281 @@
+// Compile-time lookup tables with a perfect hash.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "cstring_view.h"
+#include "hash.h"
+
+namespace beeswax::nectar {
+
+// Internal implementation details; do not use.
+namespace details {
+template <typename T>
+struct type_identity {
+  using type = T;
+};
+
+// Keeps a parameter out of template argument deduction.
+template <typename T>
+using type_identity_t = typename type_identity<T>::type;
+
+constexpr size_t FrozenLog2Ceil(size_t n) {
+  size_t bits = 0;
+  while ((size_t{1} << bits) < n) ++bits;
+  return bits;
+}
+
+// A perfect hash over N distinct keys, built in a constant expression using
+// hash and displace.
+//
+// Each key's Hash64 picks a bucket from its top bits. Buckets are placed
+// largest first, and each bucket gets the first displacement that sends all of
+// its keys to free slots. A lookup costs the one Hash64, a load of the
+// bucket's displacement, a mix and a load of the slot's key index.
+template <size_t N>
+class FrozenIndex {
+ public:
+  static constexpr uint32_t kEmpty = N;
+  static constexpr size_t kSlotBits = FrozenLog2Ceil(N + N / 4);
+  static constexpr size_t kBucketBits = FrozenLog2Ceil((N + 1) / 2);
+  static constexpr size_t kSlots = size_t{1} << kSlotBits;
+  static constexpr size_t kBuckets = size_t{1} << kBucketBits;
+  static constexpr uint32_t kMaxDisplacement = 1 << 24;
+
+  constexpr FrozenIndex(const std::array<std::string_view, N>& keys) {
+    std::array<uint64_t, N> hashes{};
+    std::array<size_t, kBuckets + 1> starts{};
+    for (size_t i = 0; i < N; ++i) {
+      hashes[i] = Hash64(keys[i]);
+      ++starts[Bucket(hashes[i]) + 1];
+    }
+
+    // Group keys by bucket, and find the largest.
+    size_t largest = 0;
+    for (size_t b = 0; b < kBuckets; ++b) {
+      if (starts[b + 1] > largest) largest = starts[b + 1];
+      starts[b + 1] += starts[b];
+    }
+    std::array<size_t, N> order{};
+    std::array<size_t, kBuckets> filled{};
+    for (size_t i = 0; i < N; ++i) {
+      auto b = Bucket(hashes[i]);
+      order[starts[b] + filled[b]++] = i;
+    }
+
+    for (size_t s = 0; s < kSlots; ++s) slots_[s] = kEmpty;
+    for (size_t size = largest; size > 0; --size) {
+      for (size_t b = 0; b < kBuckets; ++b) {
+        if (starts[b + 1] - starts[b] != size) continue;
+        const size_t* members = &order[starts[b]];
+        ThrowIfInseparable(keys, hashes, members, size);
+        displacements_[b] = Place(hashes, members, size);
+      }
+    }
+  }
+
+  // Returns the index of the only key that could match the one with Hash64
+  // `h`, or kEmpty.
+  constexpr uint32_t Find(uint64_t h) const {
+    return slots_[Slot(h, displacements_[Bucket(h)])];
+  }
+
+ private:
+  static constexpr size_t Bucket(uint64_t h) {
+    return kBucketBits ? h >> (64 - kBucketBits) : 0;
+  }
+
+  static constexpr size_t Slot(uint64_t h, uint32_t d) {
+    auto mixed = HashAvalanche(h + d * 0x9E3779B97F4A7C15ULL);
+    return kSlotBits ? mixed >> (64 - kSlotBits) : 0;
+  }
+
+  // Keys with the same hash can't be separated by any displacement.
+  static constexpr void ThrowIfInseparable(
+      const std::array<std::string_view, N>& keys,
+      const std::array<uint64_t, N>& hashes,
+      const size_t* members,
+      size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      for (size_t j = i + 1; j < size; ++j) {
+        if (hashes[members[i]] != hashes[members[j]]) continue;
+        if (keys[members[i]] == keys[members[j]])
+          throw std::logic_error("Duplicate key in frozen map or set");
+        throw std::logic_error("Hash collision in frozen map or set");
+      }
+    }
+  }
+
+  // Finds the first displacement that puts the bucket's keys in free slots,
+  // then fills them.
+  constexpr uint32_t Place(const std::array<uint64_t, N>& hashes,
+                           const size_t* members,
+                           size_t size) {
+    for (uint32_t d = 0; d < kMaxDisplacement; ++d) {
+      bool fits = true;
+      for (size_t i = 0; fits && i < size; ++i) {
+        auto slot = Slot(hashes[members[i]], d);
+        fits = slots_[slot] == kEmpty;
+        for (size_t j = 0; fits && j < i; ++j)
+          fits = Slot(hashes[members[j]], d) != slot;
+      }
+      if (!fits) continue;
+      for (size_t i = 0; i < size; ++i)
+        slots_[Slot(hashes[members[i]], d)] = members[i];
+      return d;
+    }
+    throw std::logic_error("Unable to build frozen map or set");
+  }
+
+  std::array<uint32_t, kBuckets> displacements_{};
+  std::array<uint32_t, kSlots> slots_{};
+};
+}  // namespace details
+
+// A FrozenMap is an immutable map from strings to values, built at compile
+// time with a perfect hash.
+//
+// Construct with MakeFrozenMap, as a constexpr variable, so that there's no
+// work at startup. A lookup is then one hash and one string compare, and never
+// allocates. Keys can be anything that converts to std::string_view, including
+// cstring_view, and the interface is close enough to std::map's that FindPtr,
+// FindOrDefault and contains all work. Iteration is in the order given.
+//
+// Usage:
+//    constexpr auto kMethods = MakeFrozenMap<Method>({
+//        {"GET"_sz, Method::kGet},
+//        {"POST"_sz, Method::kPost},
+//    });
+//    auto method = FindOrDefault(kMethods, request.method(), Method::kUnknown);
+//
+// Duplicate keys fail to compile.
+template <typename K, typename V, size_t N>
+class FrozenMap {
+ public:
+  using key_type = K;
+  using mapped_type = V;
+  using value_type = std::pair<K, V>;
+  using size_type = std::size_t;
+  using const_iterator = const value_type*;
+  using iterator = const_iterator;
+
+  constexpr explicit FrozenMap(const value_type (&items)[N])
+      : FrozenMap(items, std::make_index_sequence<N>()) {}
+
+  constexpr const_iterator begin() const noexcept { return items_.data(); }
+  constexpr const_iterator end() const noexcept { return items_.data() + N; }
+  constexpr bool empty() const noexcept { return N == 0; }
+  constexpr size_type size() const noexcept { return N; }
+
+  template <typename Key>
+  constexpr const_iterator find(const Key& k) const {
+    auto key = static_cast<std::string_view>(k);
+    auto i = index_.Find(details::StringHash64(k));
+    if (i != decltype(index_)::kEmpty &&
+        static_cast<std::string_view>(items_[i].first) == key)
+      return &items_[i];
+    return end();
+  }
+
+  template <typename Key>
+  constexpr size_type count(const Key& k) const {
+    return find(k) != end();
+  }
+
+  template <typename Key>
+  constexpr bool contains(const Key& k) const {
+    return find(k) != end();
+  }
+
+  template <typename Key>
+  constexpr const V& at(const Key& k) const {
+    auto it = find(k);
+    if (it == end()) throw std::out_of_range("FrozenMap::at");
+    return it->second;
+  }
+
+ private:
+  template <size_t... I>
+  constexpr FrozenMap(const value_type (&items)[N], std::index_sequence<I...>)
+      : items_{{items[I]...}},
+        index_({static_cast<std::string_view>(items[I].first)...}) {}
+
+  std::array<value_type, N> items_;
+  details::FrozenIndex<N> index_;
+};
+
+// Use this helper to make FrozenMap instances, specifying the value type. The
+// key type defaults to cstring_view.
+template <typename V, typename K = cstring_view, size_t N>
+constexpr FrozenMap<K, V, N> MakeFrozenMap(
+    const std::pair<details::type_identity_t<K>, V> (&items)[N]) {
+  return FrozenMap<K, V, N>(items);
+}
+
+// A FrozenSet is an immutable set of strings, built at compile time with a
+// perfect hash. See FrozenMap.
+//
+// Usage:
+//    constexpr auto kHopByHop = MakeFrozenSet({"connection"_sz, "te"_sz});
+//    if (kHopByHop.contains(header)) continue;
+template <typename K, size_t N>
+class FrozenSet {
+ public:
+  using key_type = K;
+  using value_type = K;
+  using size_type = std::size_t;
+  using const_iterator = const K*;
+  using iterator = const_iterator;
+
+  constexpr explicit FrozenSet(const K (&keys)[N])
+      : FrozenSet(keys, std::make_index_sequence<N>()) {}
+
+  constexpr const_iterator begin() const noexcept { return keys_.data(); }
+  constexpr const_iterator end() const noexcept { return keys_.data() + N; }
+  constexpr bool empty() const noexcept { return N == 0; }
+  constexpr size_type size() const noexcept { return N; }
+
+  template <typename Key>
+  constexpr const_iterator find(const Key& k) const {
+    auto key = static_cast<std::string_view>(k);
+    auto i = index_.Find(details::StringHash64(k));
+    if (i != decltype(index_)::kEmpty &&
+        static_cast<std::string_view>(keys_[i]) == key)
+      return &keys_[i];
+    return end();
+  }
+
+  template <typename Key>
+  constexpr size_type count(const Key& k) const {
+    return find(k) != end();
+  }
+
+  template <typename Key>
+  constexpr bool contains(const Key& k) const {
+    return find(k) != end();
+  }
+
+ private:
+  template <size_t... I>
+  constexpr FrozenSet(const K (&keys)[N], std::index_sequence<I...>)
+      : keys_{{keys[I]...}},
+        index_({static_cast<std::string_view>(keys[I])...}) {}
+
+  std::array<K, N> keys_;
+  details::FrozenIndex<N> index_;
+};
+
+// Use this helper to make FrozenSet instances. The key type defaults to
+// cstring_view.
+template <typename K = cstring_view, size_t N>
+constexpr FrozenSet<K, N> MakeFrozenSet(
+    const details::type_identity_t<K> (&keys)[N]) {
+  return FrozenSet<K, N>(keys);
+}
+
+}  // namespace beeswax::nectar
@@ -0,0 +1,579 @@
+// Persistent hash map with cheap snapshots, for tables swapped under readers.
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "collections.h"
+#include "hash.h"
+
+namespace beeswax::nectar {
+
+// Internal implementation details; do not use.
+namespace details {
+// Each level of the trie takes 5 bits of the hash, so a node has up to 32
+// branches. Keys whose 64-bit hashes are equal end up together in a collision
+// node below the last level.
+inline constexpr unsigned kHamtBits = 5;
+inline constexpr uint32_t kHamtMask = (1 << kHamtBits) - 1;
+inline constexpr unsigned kHamtHashBits = 64;
+inline constexpr size_t kHamtMaxDepth =
+    (kHamtHashBits + kHamtBits - 1) / kHamtBits + 1;
+
+// A node of the trie, never changed once shared. As in CHAMP, the entries
+// stored inline and the child nodes each have their own bitmap, with the
+// entries and children packed in bit order. Collision nodes have empty bitmaps
+// and unordered entries.
+template <typename V>
+struct HamtNode {
+  using value_type = std::pair<const std::string, V>;
+  using Ptr = std::shared_ptr<const HamtNode>;
+
+  uint32_t datamap = 0;
+  uint32_t nodemap = 0;
+  std::vector<value_type> entries;
+  std::vector<Ptr> children;
+};
+
+inline uint32_t HamtBit(uint64_t hash, unsigned shift) {
+  return uint32_t{1} << ((hash >> shift) & kHamtMask);
+}
+
+// Returns the position of the bit among those set in the bitmap.
+inline size_t HamtIndex(uint32_t bitmap, uint32_t bit) {
+  return __builtin_popcount(bitmap & (bit - 1));
+}
+}  // namespace details
+
+// A PersistentStringMap is an immutable map keyed on std::string, where the
+// value defaults to std::string but can be specified. It's a hash array mapped
+// trie, in the CHAMP layout.
+//
+// Changing it makes a new version, leaving the old one as it was. The new
+// version copies only the O(log n) nodes on the path to the change, sharing
+// the rest with the old. So copies are O(1), and a version can be read by any
+// number of threads while the next one is being built. To swap versions under
+// readers, use AtomicPersistentStringMap.
+//
+// Usage:
+//    PersistentStringMap<int> v1{{"abc", 1}};
+//    auto v2 = v1.Set("def", 2);
+//    assert(!v1.contains("def") && FindOrDefault(v2, "def") == 2);
+//
+// Lookup is transparent, hashing the key once with StringHash, so it works
+// with FindPtr and FindOrDefault on std::string_view, cstring_view and the
+// like. Everything is const, so FindPtr returns a pointer to const.
+//
+// Each change copies the entries of the nodes on its path, up to 32 per node,
+// so keep values cheap to copy, such as by using a shared_ptr to const for
+// large ones. Iteration is in hash order.
+//
+// `Hash` is StringHash, unless replaced for testing. It must give the same
+// hash for every type of the same key, as StringHash does.
+template <typename V = std::string, typename Hash = StringHash>
+class PersistentStringMap {
+  using Node = details::HamtNode<V>;
+  using NodePtr = typename Node::Ptr;
+
+ public:
+  using key_type = std::string;
+  using mapped_type = V;
+  using value_type = std::pair<const std::string, V>;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  class const_iterator;
+  using iterator = const_iterator;
+
+  PersistentStringMap() = default;
+
+  // Construct from key/value pairs. As with std::map, the first of any
+  // duplicate keys wins.
+  PersistentStringMap(std::initializer_list<value_type> init)
+      : PersistentStringMap(init.begin(), init.end()) {}
+
+  template <typename InputIt>
+  PersistentStringMap(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      if (!contains(first->first)) *this = Set(first->first, first->second);
+    }
+  }
+
+  const_iterator begin() const { return const_iterator(root_.get()); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator end() const noexcept { return const_iterator(); }
+  const_iterator cend() const noexcept { return end(); }
+
+  bool empty() const noexcept { return !size_; }
+  size_type size() const noexcept { return size_; }
+
+  template <typename K>
+  const_iterator find(const K& k) const {
+    const_iterator it;
+    const uint64_t hash = Hash{}(k);
+    const std::string_view key(k);
+    unsigned shift = 0;
+    for (const Node* n = root_.get(); n; shift += details::kHamtBits) {
+      if (shift >= details::kHamtHashBits) {
+        for (size_t i = 0; i < n->entries.size(); ++i) {
+          if (n->entries[i].first == key) return it.Push(n, i, 0);
+        }
+        break;
+      }
+      const uint32_t bit = details::HamtBit(hash, shift);
+      if (n->datamap & bit) {
+        auto i = details::HamtIndex(n->datamap, bit);
+        if (n->entries[i].first == key) return it.Push(n, i, 0);
+        break;
+      }
+      if (!(n->nodemap & bit)) break;
+      auto i = details::HamtIndex(n->nodemap, bit);
+      it.Push(n, n->entries.size(), i + 1);
+      n = n->children[i].get();
+    }
+    return end();
+  }
+
+  template <typename K>
+  size_type count(const K& k) const {
+    return find(k) != end();
+  }
+
+  template <typename K>
+  bool contains(const K& k) const {
+    return find(k) != end();
+  }
+
+  template <typename K>
+  const V& at(const K& k) const {
+    auto it = find(k);
+    if (it == end()) throw std::out_of_range("PersistentStringMap::at");
+    return it->second;
+  }
+
+  // Returns a new version with the key set to the value, inserting if
+  // necessary.
+  template <typename K, typename M>
+  PersistentStringMap Set(K&& k, M&& value) const {
+    const uint64_t hash = Hash{}(k);
+    bool inserted = false;
+    auto root = SetIn(root_.get(),
+                      0,
+                      hash,
+                      inserted,
+                      std::forward<K>(k),
+                      std::forward<M>(value));
+    return PersistentStringMap(std::move(root), size_ + inserted);
+  }
+
+  // Returns a new version without the key. If it wasn't there, this is a copy
+  // of this version.
+  template <typename K>
+  PersistentStringMap Erase(const K& k) const {
+    const uint64_t hash = Hash{}(k);
+    bool erased = false;
+    auto root = EraseIn(root_.get(), 0, hash, std::string_view(k), erased);
+    if (!erased) return *this;
+    if (root && root->entries.empty() && root->children.empty()) root.reset();
+    return PersistentStringMap(std::move(root), size_ - 1);
+  }
+
+  // Returns whether the two versions share the same root, so are the same
+  // without comparing entries.
+  bool SameVersion(const PersistentStringMap& other) const noexcept {
+    return root_ == other.root_;
+  }
+
+ private:
+  PersistentStringMap(NodePtr root, size_type size)
+      : root_(std::move(root)), size_(size) {}
+
+  template <typename K, typename M>
+  static value_type MakeEntry(K&& k, M&& value) {
+    return value_type(std::piecewise_construct,
+                      std::forward_as_tuple(std::forward<K>(k)),
+                      std::forward_as_tuple(std::forward<M>(value)));
+  }
+
+  // Returns a node holding the two entries, which are different keys that
+  // collide in every level above this one.
+  static NodePtr MakePair(unsigned shift,
+                          const value_type& e1,
+                          uint64_t h1,
+                          value_type&& e2,
+                          uint64_t h2) {
+    auto node = std::make_shared<Node>();
+    if (shift >= details::kHamtHashBits) {
+      node->entries.reserve(2);
+      node->entries.push_back(e1);
+      node->entries.push_back(std::move(e2));
+      return node;
+    }
+    const uint32_t b1 = details::HamtBit(h1, shift);
+    const uint32_t b2 = details::HamtBit(h2, shift);
+    if (b1 == b2) {
+      node->nodemap = b1;
+      node->children.push_back(MakePair(
+          shift + details::kHamtBits, e1, h1, std::move(e2), h2));
+      return node;
+    }
+    node->datamap = b1 | b2;
+    node->entries.reserve(2);
+    if (b1 < b2) {
+      node->entries.push_back(e1);
+      node->entries.push_back(std::move(e2));
+    } else {
+      node->entries.push_back(std::move(e2));
+      node->entries.push_back(e1);
+    }
+    return node;
+  }
+
+  // Returns a copy of the entries, with the one at `i` replaced, inserted or
+  // erased.
+  enum class Edit { kReplace, kInsert, kErase };
+
+  static std::vector<value_type> EditEntries(const std::vector<value_type>& in,
+                                             size_t i,
+                                             Edit edit,
+                                             value_type* entry = nullptr) {
+    std::vector<value_type> out;
+    out.reserve(in.size() + 1);
+    for (size_t j = 0; j < in.size(); ++j) {
+      if (j == i) {
+        if (edit != Edit::kErase) out.push_back(std::move(*entry));
+        if (edit != Edit::kInsert) continue;
+      }
+      out.push_back(in[j]);
+    }
+    if (i == in.size() && edit == Edit::kInsert)
+      out.push_back(std::move(*entry));
+    return out;
+  }
+
+  template <typename K, typename M>
+  static NodePtr SetIn(const Node* n,
+                       unsigned shift,
+                       uint64_t hash,
+                       bool& inserted,
+                       K&& k,
+                       M&& value) {
+    const std::string_view key(k);
+    if (!n) {
+      inserted = true;
+      auto node = std::make_shared<Node>();
+      node->datamap = details::HamtBit(hash, shift);
+      node->entries.push_back(
+          MakeEntry(std::forward<K>(k), std::forward<M>(value)));
+      return node;
+    }
+    auto node = std::make_shared<Node>();
+    node->datamap = n->datamap;
+    node->nodemap = n->nodemap;
+    if (shift >= details::kHamtHashBits) {
+      size_t i = 0;
+      while (i < n->entries.size() && n->entries[i].first != key) ++i;
+      inserted = i == n->entries.size();
+      auto entry = MakeEntry(std::forward<K>(k), std::forward<M>(value));
+      node->entries = EditEntries(
+          n->entries, i, inserted ? Edit::kInsert : Edit::kReplace, &entry);
+      return node;
+    }
+
+    const uint32_t bit = details::HamtBit(hash, shift);
+    if (n->datamap & bit) {
+      const auto i = details::HamtIndex(n->datamap, bit);
+      const auto& existing = n->entries[i];
+      const bool same = existing.first == key;
+      auto entry = MakeEntry(std::forward<K>(k), std::forward<M>(value));
+      if (same) {
+        node->entries = EditEntries(n->entries, i, Edit::kReplace, &entry);
+        node->children = n->children;
+        return node;
+      }
+      // Push both entries down into a new child.
+      inserted = true;
+      node->datamap ^= bit;
+      node->nodemap |= bit;
+      node->entries = EditEntries(n->entries, i, Edit::kErase);
+      node->children = n->children;
+      node->children.insert(
+          node->children.begin() + details::HamtIndex(node->nodemap, bit),
+          MakePair(shift + details::kHamtBits,
+                   existing,
+                   Hash{}(existing.first),
+                   std::move(entry),
+                   hash));
+      return node;
+    }
+
+    node->children = n->children;
+    if (n->nodemap & bit) {
+      const auto i = details::HamtIndex(n->nodemap, bit);
+      node->entries = std::vector<value_type>(n->entries);
+      node->children[i] = SetIn(n->children[i].get(),
+                                shift + details::kHamtBits,
+                                hash,
+                                inserted,
+                                std::forward<K>(k),
+                                std::forward<M>(value));
+      return node;
+    }
+
+    inserted = true;
+    node->datamap |= bit;
+    auto entry = MakeEntry(std::forward<K>(k), std::forward<M>(value));
+    node->entries = EditEntries(n->entries,
+                                details::HamtIndex(node->datamap, bit),
+                                Edit::kInsert,
+                                &entry);
+    return node;
+  }
+
+  // Returns the node without the key. A child left with one entry and no
+  // children is folded into its parent, so that every version has the same
+  // shape for the same keys.
+  static NodePtr EraseIn(const Node* n,
+                         unsigned shift,
+                         uint64_t hash,
+                         std::string_view key,
+                         bool& erased) {
+    if (!n) return nullptr;
+    auto node = std::make_shared<Node>();
+    node->datamap = n->datamap;
+    node->nodemap = n->nodemap;
+    if (shift >= details::kHamtHashBits) {
+      for (size_t i = 0; i < n->entries.size(); ++i) {
+        if (n->entries[i].first != key) continue;
+        erased = true;
+        node->entries = EditEntries(n->entries, i, Edit::kErase);
+        return node;
+      }
+      return nullptr;
+    }
+
+    const uint32_t bit = details::HamtBit(hash, shift);
+    if (n->datamap & bit) {
+      const auto i = details::HamtIndex(n->datamap, bit);
+      if (n->entries[i].first != key) return nullptr;
+      erased = true;
+      node->datamap ^= bit;
+      node->entries = EditEntries(n->entries, i, Edit::kErase);
+      node->children = n->children;
+      return node;
+    }
+    if (!(n->nodemap & bit)) return nullptr;
+
+    const auto i = details::HamtIndex(n->nodemap, bit);
+    auto child = EraseIn(
+        n->children[i].get(), shift + details::kHamtBits, hash, key, erased);
+    if (!erased) return nullptr;
+    if (child->children.empty() && child->entries.size() == 1) {
+      // Fold the last entry of the child into this node.
+      auto entry = child->entries.front();
+      node->nodemap ^= bit;
+      node->datamap |= bit;
+      node->entries = EditEntries(n->entries,
+                                  details::HamtIndex(node->datamap, bit),
+                                  Edit::kInsert,
+                                  &entry);
+      node->children = n->children;
+      node->children.erase(node->children.begin() + i);
+    } else {
+      node->entries = std::vector<value_type>(n->entries);
+      node->children = n->children;
+      node->children[i] = std::move(child);
+    }
+    return node;
+  }
+
+  NodePtr root_;
+  size_type size_{};
+};
+
+// Forward iterator over PersistentStringMap, holding the path from the root.
+template <typename V, typename Hash>
+class PersistentStringMap<V, Hash>::const_iterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = PersistentStringMap::value_type;
+  using difference_type = std::ptrdiff_t;
+  using reference = const value_type&;
+  using pointer = const value_type*;
+
+  const_iterator() = default;
+
+  reference operator*() const {
+    auto& top = path_[depth_ - 1];
+    return top.node->entries[top.entry];
+  }
+  pointer operator->() const { return &**this; }
+
+  const_iterator& operator++() {
+    ++path_[depth_ - 1].entry;
+    Settle();
+    return *this;
+  }
+
+  const_iterator operator++(int) {
+    auto it = *this;
+    ++*this;
+    return it;
+  }
+
+  bool operator==(const const_iterator& o) const {
+    if (depth_ != o.depth_) return false;
+    if (!depth_) return true;
+    auto& l = path_[depth_ - 1];
+    auto& r = o.path_[depth_ - 1];
+    return l.node == r.node && l.entry == r.entry;
+  }
+  bool operator!=(const const_iterator& o) const { return !(*this == o); }
+
+ private:
+  friend class PersistentStringMap;
+
+  // Each node on the path, with the next entry and next child to visit.
+  struct Frame {
+    const Node* node;
+    uint32_t entry;
+    uint32_t child;
+  };
+
+  explicit const_iterator(const Node* root) {
+    if (!root) return;
+    Push(root, 0, 0);
+    Settle();
+  }
+
+  const_iterator& Push(const Node* node, size_t entry, size_t child) {
+    path_[depth_++] = {node,
+                       static_cast<uint32_t>(entry),
+                       static_cast<uint32_t>(child)};
+    return *this;
+  }
+
+  // Moves to the next entry, in this node or the next one below or after it,
+  // visiting each node's entries before its children.
+  void Settle() {
+    while (depth_) {
+      auto& top = path_[depth_ - 1];
+      if (top.entry < top.node->entries.size()) return;
+      if (top.child < top.node->children.size()) {
+        Push(top.node->children[top.child++].get(), 0, 0);
+      } else {
+        --depth_;
+      }
+    }
+  }
+
+  std::array<Frame, details::kHamtMaxDepth> path_;
+  size_t depth_{};
+};
+
+// An AtomicPersistentStringMap holds the current version of a
+// PersistentStringMap, so that writers can publish new versions while readers
+// go on using the one they have.
+//
+// Readers take a snapshot, which is a shared_ptr to a version, and can use it
+// for as long as they like. Each version is freed when the last snapshot of it
+// is released. Writers are serialized, and each builds its version from the
+// last one, without blocking readers.
+//
+// Usage:
+//    AtomicPersistentStringMap<Campaign> campaigns;
+//    campaigns.Update([&](const auto& m) { return m.Set(id, campaign); });
+//
+//    // In request threads:
+//    auto snapshot = campaigns.Load();
+//    auto* campaign = FindPtr(*snapshot, id);
+//
+// For threads that read often, a Reader keeps its snapshot between reads and
+// only takes a new one after a writer publishes.
+template <typename V = std::string>
+class AtomicPersistentStringMap {
+ public:
+  using MapT = PersistentStringMap<V>;
+  using Snapshot = std::shared_ptr<const MapT>;
+
+  AtomicPersistentStringMap() : AtomicPersistentStringMap(MapT()) {}
+
+  explicit AtomicPersistentStringMap(MapT m)
+      : current_(std::make_shared<const MapT>(std::move(m))) {}
+
+  AtomicPersistentStringMap(const AtomicPersistentStringMap&) = delete;
+  AtomicPersistentStringMap& operator=(const AtomicPersistentStringMap&) =
+      delete;
+
+  // Returns the current version.
+  Snapshot Load() const {
+    return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+  }
+
+  // Publishes the version, replacing the current one.
+  void Store(MapT m) {
+    std::lock_guard lock(writer_mutex_);
+    Publish(std::move(m));
+  }
+
+  // Publishes the version returned from `f(const MapT&)`, given the current
+  // one. Writers are serialized, so no update is lost.
+  template <typename F>
+  void Update(F&& f) {
+    std::lock_guard lock(writer_mutex_);
+    Publish(f(*Load()));
+  }
+
+  // A reader's cached snapshot. Get takes a single atomic load to find that
+  // nothing has been published since, and only takes a new snapshot when
+  // something has.
+  //
+  // This is not thread-safe, so keep one per thread.
+  class Reader {
+   public:
+    explicit Reader(const AtomicPersistentStringMap& source)
+        : source_(source) {}
+
+    // Returns the latest version, which stays valid until the next call.
+    const MapT& Get() {
+      auto version = source_.version_.load(std::memory_order_acquire);
+      if (version != version_ || !snapshot_) {
+        snapshot_ = source_.Load();
+        version_ = version;
+      }
+      return *snapshot_;
+    }
+
+   private:
+    const AtomicPersistentStringMap& source_;
+    uint64_t version_{};
+    Snapshot snapshot_;
+  };
+
+ private:
+  void Publish(MapT m) {
+    auto next = std::make_shared<const MapT>(std::move(m));
+    std::atomic_store_explicit(
+        &current_, std::move(next), std::memory_order_release);
+    version_.fetch_add(1, std::memory_order_release);
+  }
+
+  // Accessed only through the std::atomic_load and std::atomic_store
+  // overloads for shared_ptr, which work under both C++17 and C++20.
+  Snapshot current_;
+  std::atomic<uint64_t> version_{0};
+  std::mutex writer_mutex_;
+};
+
+}  // namespace beeswax::nectar
@@ -0,0 +1,562 @@
+// Fast, stable 64-bit string hashing.
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace beeswax::nectar {
+
+// Internal implementation details; do not use.
+namespace details {
+inline constexpr uint64_t kPrime32_1 = 0x9E3779B1U;
+inline constexpr uint64_t kPrime32_2 = 0x85EBCA77U;
+inline constexpr uint64_t kPrime32_3 = 0xC2B2AE3DU;
+inline constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+inline constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+inline constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+inline constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+inline constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+
+// Inputs longer than this are hashed in 64-byte stripes, each mixed into
+// eight 64-bit lanes, which is where SIMD pays off.
+inline constexpr size_t kHashStripeLen = 64;
+inline constexpr size_t kHashLanes = 8;
+inline constexpr size_t kHashStripesPerBlock = 16;
+inline constexpr size_t kHashMaxShortLen = 128;
+
+// Words of key material. Stripe `n` of a block is keyed by words `n` to
+// `n + 7`, and the block is scrambled with the last eight.
+inline constexpr size_t kHashSecretWords =
+    kHashStripesPerBlock + kHashLanes;
+inline constexpr size_t kHashLastStripeWord = 13;
+
+struct HashSecret {
+  uint64_t words[kHashSecretWords];
+};
+
+// Derives the key material for a seed. For seed 0, this is a compile-time
+// constant.
+constexpr HashSecret MakeHashSecret(uint64_t seed) {
+  HashSecret secret{};
+  uint64_t x = kPrime64_3;
+  for (size_t i = 0; i < kHashSecretWords; ++i) {
+    // SplitMix64.
+    uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    secret.words[i] = (i & 1) ? z - seed : z + seed;
+  }
+  return secret;
+}
+
+inline constexpr HashSecret kDefaultHashSecret = MakeHashSecret(0);
+
+constexpr bool IsConstantEvaluated() noexcept {
+  return __builtin_is_constant_evaluated();
+}
+
+// Little-endian loads that also work in constant expressions.
+constexpr uint64_t HashRead64(const char* p) noexcept {
+  if (!IsConstantEvaluated()) {
+    uint64_t v = 0;
+    std::memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+  }
+  uint64_t v = 0;
+  for (size_t i = 0; i < 8; ++i)
+    v |= uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+  return v;
+}
+
+constexpr uint32_t HashRead32(const char* p) noexcept {
+  if (!IsConstantEvaluated()) {
+    uint32_t v = 0;
+    std::memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+  }
+  uint32_t v = 0;
+  for (size_t i = 0; i < 4; ++i)
+    v |= uint32_t(static_cast<unsigned char>(p[i])) << (8 * i);
+  return v;
+}
+
+// Multiplies to 128 bits, then folds the halves together.
+constexpr uint64_t Mul128Fold64(uint64_t l, uint64_t r) noexcept {
+  auto product = static_cast<unsigned __int128>(l) * r;
+  return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+constexpr uint64_t HashAvalanche(uint64_t h) noexcept {
+  h ^= h >> 37;
+  h *= 0x165667919E3779F9ULL;
+  h ^= h >> 32;
+  return h;
+}
+
+constexpr uint64_t HashMix16(const char* p,
+                             const uint64_t* key,
+                             uint64_t seed) noexcept {
+  return Mul128Fold64(HashRead64(p) ^ (key[0] + seed),
+                      HashRead64(p + 8) ^ (key[1] - seed));
+}
+
+// Hashes up to kHashMaxShortLen bytes, without any striping.
+constexpr uint64_t HashShort(const char* p,
+                             size_t len,
+                             uint64_t seed) noexcept {
+  const uint64_t* key = kDefaultHashSecret.words;
+  if (len > 16) {
+    uint64_t acc = len * kPrime64_1;
+    const size_t pairs = (len - 1) / 32 + 1;
+    for (size_t i = 0; i < pairs; ++i) {
+      acc += HashMix16(p + 16 * i, key + 4 * i, seed);
+      acc += HashMix16(p + len - 16 - 16 * i, key + 4 * i + 2, seed);
+    }
+    return HashAvalanche(acc);
+  }
+  if (len > 8) {
+    uint64_t lo = HashRead64(p) ^ (key[0] + seed);
+    uint64_t hi = HashRead64(p + len - 8) ^ (key[1] - seed);
+    return HashAvalanche(len + __builtin_bswap64(lo) + hi +
+                         Mul128Fold64(lo, hi));
+  }
+  if (len >= 4) {
+    uint64_t combined =
+        HashRead32(p + len - 4) | (uint64_t(HashRead32(p)) << 32);
+    return HashAvalanche(Mul128Fold64(combined ^ (key[2] + seed),
+                                      key[3] ^ (len * kPrime64_2)));
+  }
+  if (len) {
+    uint64_t combined =
+        (uint64_t(static_cast<unsigned char>(p[0])) << 16) |
+        (uint64_t(static_cast<unsigned char>(p[len >> 1])) << 24) |
+        uint64_t(static_cast<unsigned char>(p[len - 1])) | (len << 8);
+    return HashAvalanche(
+        Mul128Fold64(combined ^ (key[4] + seed), key[5] ^ kPrime64_4));
+  }
+  return HashAvalanche(seed ^ key[6] ^ key[7]);
+}
+
+// Mixes one stripe into the lanes.
+constexpr void HashAccumulateStripe(uint64_t* acc,
+                                    const char* p,
+                                    const uint64_t* key) noexcept {
+  for (size_t i = 0; i < kHashLanes; ++i) {
+    uint64_t data = HashRead64(p + 8 * i);
+    uint64_t keyed = data ^ key[i];
+    acc[i ^ 1] += data;
+    acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+  }
+}
+
+constexpr void HashScramble(uint64_t* acc, const uint64_t* key) noexcept {
+  for (size_t i = 0; i < kHashLanes; ++i) {
+    acc[i] ^= acc[i] >> 47;
+    acc[i] ^= key[i];
+    acc[i] *= kPrime32_1;
+  }
+}
+
+// Accumulates `stripes` full stripes, starting at stripe `n` of the current
+// block, scrambling at each block boundary. Returns the new value of `n`.
+//
+// Each kernel below computes exactly the same result; they differ only in
+// speed.
+constexpr size_t HashAccumulateScalar(uint64_t* acc,
+                                      const char* p,
+                                      size_t stripes,
+                                      const uint64_t* key,
+                                      size_t n) noexcept {
+  for (size_t s = 0; s < stripes; ++s, p += kHashStripeLen) {
+    HashAccumulateStripe(acc, p, key + n);
+    if (++n == kHashStripesPerBlock) {
+      HashScramble(acc, key + kHashStripesPerBlock);
+      n = 0;
+    }
+  }
+  return n;
+}
+
+#ifdef __SSE2__
+inline size_t HashAccumulateSse2(uint64_t* acc,
+                                 const char* p,
+                                 size_t stripes,
+                                 const uint64_t* key,
+                                 size_t n) noexcept {
+  __m128i a[4];
+  for (size_t j = 0; j < 4; ++j)
+    a[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc) + j);
+  const __m128i prime = _mm_set1_epi32(kPrime32_1);
+  for (size_t s = 0; s < stripes; ++s, p += kHashStripeLen) {
+    for (size_t j = 0; j < 4; ++j) {
+      __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p) + j);
+      __m128i k = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(key + n + 2 * j));
+      __m128i keyed = _mm_xor_si128(data, k);
+      __m128i product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+      __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+      a[j] = _mm_add_epi64(a[j], _mm_add_epi64(product, swapped));
+    }
+    if (++n == kHashStripesPerBlock) {
+      for (size_t j = 0; j < 4; ++j) {
+        __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+            key + kHashStripesPerBlock + 2 * j));
+        __m128i x = _mm_xor_si128(a[j], _mm_srli_epi64(a[j], 47));
+        x = _mm_xor_si128(x, k);
+        __m128i lo = _mm_mul_epu32(x, prime);
+        __m128i hi = _mm_mul_epu32(_mm_srli_epi64(x, 32), prime);
+        a[j] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+      }
+      n = 0;
+    }
+  }
+  for (size_t j = 0; j < 4; ++j)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc) + j, a[j]);
+  return n;
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) inline size_t HashAccumulateAvx2(
+    uint64_t* acc,
+    const char* p,
+    size_t stripes,
+    const uint64_t* key,
+    size_t n) noexcept {
+  __m256i a[2];
+  for (size_t j = 0; j < 2; ++j)
+    a[j] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc) + j);
+  const __m256i prime = _mm256_set1_epi32(kPrime32_1);
+  for (size_t s = 0; s < stripes; ++s, p += kHashStripeLen) {
+    for (size_t j = 0; j < 2; ++j) {
+      __m256i data =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p) + j);
+      __m256i k = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(key + n + 4 * j));
+      __m256i keyed = _mm256_xor_si256(data, k);
+      __m256i product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+      __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+      a[j] = _mm256_add_epi64(a[j], _mm256_add_epi64(product, swapped));
+    }
+    if (++n == kHashStripesPerBlock) {
+      for (size_t j = 0; j < 2; ++j) {
+        __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+            key + kHashStripesPerBlock + 4 * j));
+        __m256i x = _mm256_xor_si256(a[j], _mm256_srli_epi64(a[j], 47));
+        x = _mm256_xor_si256(x, k);
+        __m256i lo = _mm256_mul_epu32(x, prime);
+        __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), prime);
+        a[j] = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+      }
+      n = 0;
+    }
+  }
+  for (size_t j = 0; j < 2; ++j)
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc) + j, a[j]);
+  return n;
+}
+#endif
+
+using HashAccumulateFn = size_t (*)(uint64_t*,
+                                    const char*,
+                                    size_t,
+                                    const uint64_t*,
+                                    size_t) noexcept;
+
+// Returns the fastest kernel this CPU supports, chosen once at runtime.
+inline HashAccumulateFn GetHashAccumulate() noexcept {
+  static const HashAccumulateFn fn = [] {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return &HashAccumulateAvx2;
+#endif
+#ifdef __SSE2__
+    return &HashAccumulateSse2;
+#else
+    return static_cast<HashAccumulateFn>(&HashAccumulateScalar);
+#endif
+  }();
+  return fn;
+}
+
+constexpr void HashInitLanes(uint64_t* acc) noexcept {
+  acc[0] = kPrime32_3;
+  acc[1] = kPrime64_1;
+  acc[2] = kPrime64_2;
+  acc[3] = kPrime64_3;
+  acc[4] = kPrime64_4;
+  acc[5] = kPrime32_2;
+  acc[6] = kPrime64_5;
+  acc[7] = kPrime32_1;
+}
+
+// Combines the lanes into the final hash.
+constexpr uint64_t HashMergeLanes(const uint64_t* acc,
+                                  const uint64_t* key,
+                                  uint64_t len) noexcept {
+  uint64_t result = len * kPrime64_1;
+  for (size_t i = 0; i < kHashLanes / 2; ++i)
+    result += Mul128Fold64(acc[2 * i] ^ key[3 + 2 * i],
+                           acc[2 * i + 1] ^ key[4 + 2 * i]);
+  return HashAvalanche(result);
+}
+
+// Hashes more than kHashMaxShortLen bytes, using the specified kernel.
+constexpr uint64_t HashLong(const char* p,
+                            size_t len,
+                            const HashSecret& secret,
+                            HashAccumulateFn accumulate) noexcept {
+  uint64_t acc[kHashLanes]{};
+  HashInitLanes(acc);
+  const uint64_t* key = secret.words;
+  accumulate(acc, p, (len - 1) / kHashStripeLen, key, 0);
+  HashAccumulateStripe(
+      acc, p + len - kHashStripeLen, key + kHashLastStripeWord);
+  return HashMergeLanes(acc, key, len);
+}
+}  // namespace details
+
+// Returns a 64-bit hash of the bytes, optionally seeded.
+//
+// This is in the same family as xxh3 and wyhash: short keys take a handful of
+// multiplies, while long keys are mixed 64 bytes at a time using the widest
+// SIMD the CPU supports, chosen once at runtime. The result depends only on the
+// bytes and seed, so it's stable across builds, machines and releases, and
+// can be persisted. It is not a cryptographic hash.
+//
+// It's also constexpr, so hashes of literals can be computed at compile time.
+//
+// Usage:
+//    auto h = nectar::Hash64(key);
+//    auto h2 = nectar::Hash64(key, kSeed);
+constexpr uint64_t Hash64(std::string_view s, uint64_t seed = 0) noexcept {
+  if (s.size() <= details::kHashMaxShortLen)
+    return details::HashShort(s.data(), s.size(), seed);
+  const auto& secret = seed ? details::MakeHashSecret(seed)
+                            : details::kDefaultHashSecret;
+  if (details::IsConstantEvaluated())
+    return details::HashLong(
+        s.data(), s.size(), secret, details::HashAccumulateScalar);
+  return details::HashLong(
+      s.data(), s.size(), secret, details::GetHashAccumulate());
+}
+
+// Streaming version of Hash64, for input that arrives in pieces.
+//
+// The digest is exactly what Hash64 returns for the concatenated input, no
+// matter how it was split.
+//
+// Usage:
+//    Hasher64 hasher;
+//    hasher.Update(part1).Update(part2);
+//    auto h = hasher.Digest();
+class Hasher64 {
+ public:
+  explicit Hasher64(uint64_t seed = 0) noexcept
+      : seed_(seed),
+        secret_(seed ? details::MakeHashSecret(seed)
+                     : details::kDefaultHashSecret) {
+    Reset();
+  }
+
+  // Starts over, keeping the seed.
+  void Reset() noexcept {
+    details::HashInitLanes(acc_);
+    stripe_ = 0;
+    total_len_ = 0;
+    buffered_ = 0;
+  }
+
+  // Appends bytes to the input.
+  Hasher64& Update(std::string_view s) noexcept {
+    const char* p = s.data();
+    size_t len = s.size();
+    total_len_ += len;
+    if (buffered_ + len <= kBufferLen) {
+      if (len) std::memcpy(buffer_ + buffered_, p, len);
+      buffered_ += len;
+      return *this;
+    }
+
+    // More input follows, so buffered stripes can't be the last ones.
+    if (buffered_) {
+      size_t fill = kBufferLen - buffered_;
+      std::memcpy(buffer_ + buffered_, p, fill);
+      p += fill;
+      len -= fill;
+      Consume(buffer_);
+      buffered_ = 0;
+    }
+    if (len > kBufferLen) {
+      do {
+        Consume(p);
+        p += kBufferLen;
+        len -= kBufferLen;
+      } while (len > kBufferLen);
+      // Keep the last stripe consumed, in case the final stripe overlaps it.
+      std::memcpy(buffer_ + kBufferLen - details::kHashStripeLen,
+                  p - details::kHashStripeLen,
+                  details::kHashStripeLen);
+    }
+    std::memcpy(buffer_, p, len);
+    buffered_ = len;
+    return *this;
+  }
+
+  // Returns hash of all input so far. More input may follow.
+  uint64_t Digest() const noexcept {
+    if (total_len_ <= kBufferLen) return Hash64({buffer_, buffered_}, seed_);
+
+    uint64_t acc[details::kHashLanes];
+    std::memcpy(acc, acc_, sizeof(acc));
+    const uint64_t* key = secret_.words;
+    details::GetHashAccumulate()(acc,
+                                 buffer_,
+                                 (buffered_ - 1) / details::kHashStripeLen,
+                                 key,
+                                 stripe_);
+    const char* last = buffer_ + buffered_ - details::kHashStripeLen;
+    char stitched[details::kHashStripeLen];
+    if (buffered_ < details::kHashStripeLen) {
+      // The final stripe straddles the previous buffer, whose tail is still
+      // at the end.
+      size_t carried = details::kHashStripeLen - buffered_;
+      std::memcpy(stitched, buffer_ + kBufferLen - carried, carried);
+      std::memcpy(stitched + carried, buffer_, buffered_);
+      last = stitched;
+    }
+    details::HashAccumulateStripe(
+        acc, last, key + details::kHashLastStripeWord);
+    return details::HashMergeLanes(acc, key, total_len_);
+  }
+
+ private:
+  static constexpr size_t kBufferStripes = 4;
+  static constexpr size_t kBufferLen =
+      kBufferStripes * details::kHashStripeLen;
+  static_assert(kBufferLen > details::kHashMaxShortLen);
+
+  void Consume(const char* p) noexcept {
+    stripe_ = details::GetHashAccumulate()(
+        acc_, p, kBufferStripes, secret_.words, stripe_);
+  }
+
+  uint64_t seed_;
+  details::HashSecret secret_;
+  uint64_t acc_[details::kHashLanes];
+  size_t stripe_;
+  uint64_t total_len_;
+  size_t buffered_;
+  char buffer_[kBufferLen];
+};
+
+// A HashedStringView is a std::string_view that carries the Hash64 of its
+// characters, for a key that's looked up in several maps, so that it's hashed
+// once rather than once per map.
+//
+// StringHash uses the carried hash, so this works for lookup in StringHashMap,
+// ConcurrentStringMap, PersistentStringMap and, starting with C++20,
+// StringUnorderedMap. FrozenMap and FrozenSet use it too. Literals made with
+// `_hashed` are hashed at compile time. In debug builds, the carried hash is
+// checked each time it's used.
+//
+// Usage:
+//    const HashedStringView domain(request.domain());
+//    auto* floor = FindPtr(floors, domain);
+//    auto* deal = FindPtr(deals, domain);
+//    constexpr auto kDefault = "default"_hashed;
+//
+// Example without helper:
+//    auto* floor = FindPtr(floors, request.domain());
+//    auto* deal = FindPtr(deals, request.domain());  // Hashes again.
+//
+// Like std::string_view, it doesn't own the characters.
+class HashedStringView {
+ public:
+  constexpr HashedStringView() noexcept : hash_(Hash64({})) {}
+
+  // Hashes the string. Explicit, since that's the cost this saves.
+  constexpr explicit HashedStringView(std::string_view s) noexcept
+      : view_(s), hash_(Hash64(s)) {}
+
+  // Takes a hash computed earlier, which must be Hash64(s).
+  constexpr HashedStringView(std::string_view s, uint64_t hash) noexcept
+      : view_(s), hash_(hash) {}
+
+  constexpr const char* data() const noexcept { return view_.data(); }
+  constexpr size_t size() const noexcept { return view_.size(); }
+  constexpr bool empty() const noexcept { return view_.empty(); }
+
+  // Returns the Hash64 of the characters.
+  constexpr uint64_t hash() const noexcept { return hash_; }
+
+  constexpr operator std::string_view() const noexcept {  // NOLINT
+    return view_;
+  }
+
+  friend constexpr bool operator==(HashedStringView l, HashedStringView r) {
+    return l.hash_ == r.hash_ && l.view_ == r.view_;
+  }
+
+  friend constexpr bool operator!=(HashedStringView l, HashedStringView r) {
+    return !(l == r);
+  }
+
+  friend constexpr bool operator<(HashedStringView l, HashedStringView r) {
+    return l.view_ < r.view_;
+  }
+
+ private:
+  std::string_view view_;
+  uint64_t hash_;
+};
+
+// Makes a HashedStringView of a literal, hashing it at compile time when used
+// to initialize a constexpr variable.
+constexpr HashedStringView operator"" _hashed(const char* str,
+                                              size_t len) noexcept {
+  return HashedStringView(std::string_view(str, len));
+}
+
+// Internal implementation details; do not use.
+namespace details {
+// Helper sniffer for whether string-like type carries its own Hash64.
+template <typename T, typename = void>
+constexpr bool has_string_hash_v = false;
+
+template <typename T>
+constexpr bool has_string_hash_v<
+    T,
+    std::enable_if_t<
+        std::is_same_v<decltype(std::declval<const T&>().hash()), uint64_t>>> =
+    true;
+
+// Returns the Hash64 of a string-like type, using the one it carries, if any.
+template <typename T>
+constexpr uint64_t StringHash64(const T& t) noexcept {
+  if constexpr (has_string_hash_v<T>) {
+    assert(t.hash() == Hash64(static_cast<std::string_view>(t)));
+    return t.hash();
+  } else {
+    return Hash64(static_cast<std::string_view>(t));
+  }
+}
+}  // namespace details
+
+}  // namespace beeswax::nectar
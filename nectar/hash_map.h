@@ -0,0 +1,712 @@
+// Open-addressing hash map for hot lookup paths.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "collections.h"
+
+namespace beeswax::nectar {
+
+// Internal implementation details; do not use.
+namespace details {
+// Each slot in a FlatHashMap has a control byte. When the slot is full, it
+// holds the low 7 bits of the hash (H2), so that most mismatches are rejected
+// without touching the slot itself. Otherwise, it's one of these negative
+// markers. The sentinel follows the last slot and stops iteration.
+using ctrl_t = int8_t;
+inline constexpr ctrl_t kCtrlEmpty = -128;
+inline constexpr ctrl_t kCtrlDeleted = -2;
+inline constexpr ctrl_t kCtrlSentinel = -1;
+
+// Control bytes are probed a group at a time.
+inline constexpr size_t kGroupWidth = 16;
+
+// Control bytes for tables with no capacity, so that begin() == end() without
+// allocating.
+alignas(kGroupWidth) inline constexpr ctrl_t kEmptyGroup[kGroupWidth] = {
+    kCtrlSentinel, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty,
+    kCtrlEmpty,    kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty, kCtrlEmpty,
+    kCtrlEmpty,    kCtrlEmpty, kCtrlEmpty, kCtrlEmpty};
+
+// An aligned group of control bytes, matched all at once. Each match returns a
+// bitmask with bit `i` set when byte `i` matches.
+class CtrlGroup {
+ public:
+#ifdef __SSE2__
+  explicit CtrlGroup(const ctrl_t* p)
+      : ctrl_(_mm_load_si128(reinterpret_cast<const __m128i*>(p))) {}
+
+  uint32_t Match(ctrl_t h2) const {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_));
+  }
+
+  uint32_t MatchEmpty() const { return Match(kCtrlEmpty); }
+
+  uint32_t MatchEmptyOrDeleted() const {
+    return _mm_movemask_epi8(
+        _mm_cmpgt_epi8(_mm_set1_epi8(kCtrlSentinel), ctrl_));
+  }
+
+ private:
+  __m128i ctrl_;
+#else
+  explicit CtrlGroup(const ctrl_t* p) : ctrl_(p) {}
+
+  uint32_t Match(ctrl_t h2) const {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; ++i)
+      mask |= static_cast<uint32_t>(ctrl_[i] == h2) << i;
+    return mask;
+  }
+
+  uint32_t MatchEmpty() const { return Match(kCtrlEmpty); }
+
+  uint32_t MatchEmptyOrDeleted() const {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < kGroupWidth; ++i)
+      mask |= static_cast<uint32_t>(ctrl_[i] < kCtrlSentinel) << i;
+    return mask;
+  }
+
+ private:
+  const ctrl_t* ctrl_;
+#endif
+};
+
+// Storage for one entry. The mutable view lets entries be moved when the table
+// grows, even though the key is const to users.
+template <typename K, typename V>
+union MapSlot {
+  MapSlot() {}
+  ~MapSlot() {}
+
+  std::pair<const K, V> value;
+  std::pair<K, V> mutable_value;
+};
+}  // namespace details
+
+// An open-addressing hash map, in the style of Abseil's "Swiss tables".
+//
+// Entries live inline in one flat array, alongside an array of one-byte
+// control codes. A lookup hashes the key once, then probes 16 control bytes at
+// a time with SIMD, only comparing keys whose 7-bit hash fragment matches. So
+// most lookups cost one hash, one or two cache misses and one key comparison,
+// and there are no per-entry allocations.
+//
+// When the hash and equality functors are transparent, as they are for
+// StringHashMap, lookups work with any key type they accept, without
+// converting to a `K` temporary.
+//
+// Unlike std::unordered_map, inserting may move entries, so it invalidates
+// iterators, pointers and references. Erasing invalidates only the erased
+// entry.
+template <typename K,
+          typename V,
+          typename Hash = std::hash<K>,
+          typename Eq = std::equal_to<K>>
+class FlatHashMap {
+  using Slot = details::MapSlot<K, V>;
+  template <bool IsConst>
+  class Iterator;
+
+ public:
+  using key_type = K;
+  using mapped_type = V;
+  using value_type = std::pair<const K, V>;
+  using hasher = Hash;
+  using key_equal = Eq;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  FlatHashMap() noexcept = default;
+
+  explicit FlatHashMap(size_type n) { reserve(n); }
+
+  FlatHashMap(std::initializer_list<value_type> init)
+      : FlatHashMap(init.begin(), init.end()) {}
+
+  template <typename InputIt>
+  FlatHashMap(InputIt first, InputIt last) {
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, category>)
+      reserve(std::distance(first, last));
+    for (; first != last; ++first) insert(*first);
+  }
+
+  FlatHashMap(const FlatHashMap& other) : hash_(other.hash_), eq_(other.eq_) {
+    reserve(other.size());
+    for (const auto& kv : other) insert(kv);
+  }
+
+  FlatHashMap(FlatHashMap&& other) noexcept
+      : ctrl_(std::exchange(other.ctrl_, EmptyCtrl())),
+        slots_(std::exchange(other.slots_, nullptr)),
+        capacity_(std::exchange(other.capacity_, 0)),
+        size_(std::exchange(other.size_, 0)),
+        growth_left_(std::exchange(other.growth_left_, 0)),
+        hash_(other.hash_),
+        eq_(other.eq_) {}
+
+  FlatHashMap& operator=(const FlatHashMap& other) {
+    if (this != &other) {
+      FlatHashMap copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  FlatHashMap& operator=(FlatHashMap&& other) noexcept {
+    if (this != &other) {
+      FlatHashMap moved(std::move(other));
+      swap(moved);
+    }
+    return *this;
+  }
+
+  ~FlatHashMap() {
+    DestroyAll();
+    Deallocate();
+  }
+
+  iterator begin() noexcept { return iterator(ctrl_, slots_); }
+  const_iterator begin() const noexcept {
+    return const_iterator(ctrl_, slots_);
+  }
+  const_iterator cbegin() const noexcept { return begin(); }
+  iterator end() noexcept { return iterator(ctrl_ + capacity_); }
+  const_iterator end() const noexcept {
+    return const_iterator(ctrl_ + capacity_);
+  }
+  const_iterator cend() const noexcept { return end(); }
+
+  bool empty() const noexcept { return !size_; }
+  size_type size() const noexcept { return size_; }
+  size_type capacity() const noexcept { return capacity_; }
+  hasher hash_function() const { return hash_; }
+  key_equal key_eq() const { return eq_; }
+
+  void swap(FlatHashMap& other) noexcept {
+    using std::swap;
+    swap(ctrl_, other.ctrl_);
+    swap(slots_, other.slots_);
+    swap(capacity_, other.capacity_);
+    swap(size_, other.size_);
+    swap(growth_left_, other.growth_left_);
+    swap(hash_, other.hash_);
+    swap(eq_, other.eq_);
+  }
+
+  // Destroys all entries but keeps the capacity.
+  void clear() noexcept {
+    DestroyAll();
+    if (capacity_) ResetCtrl();
+    size_ = 0;
+    growth_left_ = MaxLoad(capacity_);
+  }
+
+  // Grows, if needed, so that this many entries fit without growing again.
+  void reserve(size_type n) {
+    size_type cap = kMinCapacity;
+    while (MaxLoad(cap) < n) cap *= 2;
+    if (cap > capacity_) Resize(cap);
+  }
+
+  template <typename Key>
+  iterator find(const Key& k) {
+    return IteratorAt(FindIndex(k, HashOf(k)));
+  }
+
+  template <typename Key>
+  const_iterator find(const Key& k) const {
+    return IteratorAt(FindIndex(k, HashOf(k)));
+  }
+
+  template <typename Key>
+  bool contains(const Key& k) const {
+    return FindIndex(k, HashOf(k)) != capacity_;
+  }
+
+  // Where a key that wasn't found would be inserted: its hash, and the first
+  // free slot on its probe sequence, as found by find_or_prepare_insert. Like
+  // an iterator, it's invalidated by any change to the map.
+  struct prepared_insert {
+    size_t hash = 0;
+    size_type index = 0;
+    const details::ctrl_t* ctrl = nullptr;
+    size_type size = 0;
+  };
+
+  // Looks up the key, returning its entry, or end() and where to insert it
+  // with emplace_prepared. Together, these hash the key and probe the table
+  // once, where find followed by try_emplace would do both twice.
+  template <typename Key>
+  std::pair<iterator, prepared_insert> find_or_prepare_insert(const Key& k) {
+    const auto hash = HashOf(k);
+    auto [i, free] = FindOrPrepareIndex(k, hash);
+    return {IteratorAt(i), {hash, free, ctrl_, size_}};
+  }
+
+  // Inserts a key that find_or_prepare_insert didn't find, at the position it
+  // returned, which must still be valid. As a safeguard, if the map has been
+  // rehashed or its size has changed since, this looks the key up again, by
+  // the hash already computed, and like try_emplace, leaves an existing entry
+  // alone. An erase and an insert in between go unnoticed, though.
+  template <typename Key, typename... Args>
+  iterator emplace_prepared(const prepared_insert& p,
+                            Key&& k,
+                            Args&&... args) {
+    if (p.ctrl == ctrl_ && p.size == size_ && p.index < capacity_ &&
+        (ctrl_[p.index] == details::kCtrlDeleted ||
+         (ctrl_[p.index] == details::kCtrlEmpty && growth_left_)))
+      return EmplaceAt(
+          p.index, p.hash, std::forward<Key>(k), std::forward<Args>(args)...);
+    if (auto i = FindIndex(k, p.hash); i != capacity_) return IteratorAt(i);
+    return EmplaceNew(
+        p.hash, std::forward<Key>(k), std::forward<Args>(args)...);
+  }
+
+  template <typename Key>
+  size_type count(const Key& k) const {
+    return contains(k);
+  }
+
+  // Looks up `n` keys starting at `keys`, calling `cb(i, it)` with the index of
+  // each key and its iterator, or end() if not found, in order. Keys are
+  // hashed and their control bytes and candidate slots prefetched a chunk at a
+  // time, so that the cache misses overlap. Prefer FindPtrBatch.
+  template <typename KeyIt, typename Cb>
+  void find_batch(KeyIt keys, size_type n, Cb&& cb) {
+    FindBatch(*this, keys, n, cb);
+  }
+
+  template <typename KeyIt, typename Cb>
+  void find_batch(KeyIt keys, size_type n, Cb&& cb) const {
+    FindBatch(*this, keys, n, cb);
+  }
+
+  template <typename Key>
+  V& at(const Key& k) {
+    auto i = FindIndex(k, HashOf(k));
+    if (i == capacity_) throw std::out_of_range("FlatHashMap::at");
+    return slots_[i].value.second;
+  }
+
+  template <typename Key>
+  const V& at(const Key& k) const {
+    auto i = FindIndex(k, HashOf(k));
+    if (i == capacity_) throw std::out_of_range("FlatHashMap::at");
+    return slots_[i].value.second;
+  }
+
+  template <typename Key>
+  V& operator[](Key&& k) {
+    return try_emplace(std::forward<Key>(k)).first->second;
+  }
+
+  template <typename Key,
+            typename... Args,
+            std::enable_if_t<!std::is_convertible_v<Key, const_iterator>,
+                             int> = 0>
+  std::pair<iterator, bool> try_emplace(Key&& k, Args&&... args) {
+    auto hash = HashOf(k);
+    if (auto i = FindIndex(k, hash); i != capacity_)
+      return {IteratorAt(i), false};
+    return {EmplaceNew(hash, std::forward<Key>(k), std::forward<Args>(args)...),
+            true};
+  }
+
+  // The hint is ignored; this exists for compatibility with std::map.
+  template <typename Key, typename... Args>
+  iterator try_emplace(const_iterator, Key&& k, Args&&... args) {
+    return try_emplace(std::forward<Key>(k), std::forward<Args>(args)...).first;
+  }
+
+  template <typename Key, typename M>
+  std::pair<iterator, bool> insert_or_assign(Key&& k, M&& obj) {
+    auto hash = HashOf(k);
+    if (auto i = FindIndex(k, hash); i != capacity_) {
+      slots_[i].value.second = std::forward<M>(obj);
+      return {IteratorAt(i), false};
+    }
+    return {EmplaceNew(hash, std::forward<Key>(k), std::forward<M>(obj)), true};
+  }
+
+  // The hint is ignored; this exists for compatibility with std::map.
+  template <typename Key, typename M>
+  iterator insert_or_assign(const_iterator, Key&& k, M&& obj) {
+    return insert_or_assign(std::forward<Key>(k), std::forward<M>(obj)).first;
+  }
+
+  std::pair<iterator, bool> insert(const value_type& kv) {
+    return try_emplace(kv.first, kv.second);
+  }
+
+  std::pair<iterator, bool> insert(std::pair<K, V>&& kv) {
+    return try_emplace(std::move(kv.first), std::move(kv.second));
+  }
+
+  // Erases entry, returning iterator to the next one.
+  iterator erase(const_iterator pos) {
+    auto i = static_cast<size_type>(pos.ctrl_ - ctrl_);
+    EraseAt(i);
+    return iterator(ctrl_ + i, slots_ + i);
+  }
+
+  template <typename Key,
+            std::enable_if_t<!std::is_convertible_v<Key, const_iterator>,
+                             int> = 0>
+  size_type erase(const Key& k) {
+    auto i = FindIndex(k, HashOf(k));
+    if (i == capacity_) return 0;
+    EraseAt(i);
+    return 1;
+  }
+
+ private:
+  static constexpr size_type kMinCapacity = details::kGroupWidth;
+
+  static details::ctrl_t* EmptyCtrl() {
+    return const_cast<details::ctrl_t*>(details::kEmptyGroup);
+  }
+
+  // Maximum entries, including erased ones, before the table must grow. This
+  // keeps at least one empty slot, so every probe terminates.
+  static constexpr size_type MaxLoad(size_type capacity) {
+    return capacity - capacity / 8;
+  }
+
+  // Mixes the hasher's result, since std::hash is the identity for integers,
+  // which would give sequential keys the same H2 and crowd them into the same
+  // groups. Folding a 128-bit product spreads every input bit over both halves.
+  template <typename Key>
+  size_t HashOf(const Key& k) const {
+    return details::Mul128Fold64(hash_(k), 0x9E3779B97F4A7C15ULL);
+  }
+
+  static size_t H1(size_t hash) { return hash >> 7; }
+  static details::ctrl_t H2(size_t hash) {
+    return static_cast<details::ctrl_t>(hash & 0x7F);
+  }
+
+  static size_type CtrlBytes(size_type capacity) {
+    // Room for the sentinel, padded so the slots stay aligned.
+    constexpr auto align = static_cast<size_type>(kAlign);
+    return (capacity + details::kGroupWidth + align - 1) & ~(align - 1);
+  }
+
+  static constexpr std::align_val_t kAlign{
+      alignof(Slot) > details::kGroupWidth ? alignof(Slot)
+                                           : details::kGroupWidth};
+
+  iterator IteratorAt(size_type i) {
+    return i == capacity_ ? end() : iterator(ctrl_ + i, slots_ + i);
+  }
+
+  const_iterator IteratorAt(size_type i) const {
+    return i == capacity_ ? end() : const_iterator(ctrl_ + i, slots_ + i);
+  }
+
+  // Returns index of matching entry, or capacity_ if not found.
+  template <typename Key>
+  size_type FindIndex(const Key& k, size_t hash) const {
+    if (!capacity_) return capacity_;
+    const auto h2 = H2(hash);
+    const size_type mask = capacity_ / details::kGroupWidth - 1;
+    size_type group = H1(hash) & mask;
+    for (size_type probe = 1;; ++probe) {
+      const size_type base = group * details::kGroupWidth;
+      details::CtrlGroup g(ctrl_ + base);
+      for (auto m = g.Match(h2); m; m &= m - 1) {
+        size_type i = base + __builtin_ctz(m);
+        if (eq_(slots_[i].value.first, k)) return i;
+      }
+      if (g.MatchEmpty()) return capacity_;
+      group = (group + probe) & mask;
+    }
+  }
+
+  // Returns the index of the matching entry, or capacity_ if not found, and
+  // the index of the first empty or erased slot on the probe sequence, or
+  // capacity_ if there's no table yet.
+  template <typename Key>
+  std::pair<size_type, size_type> FindOrPrepareIndex(const Key& k,
+                                                     size_t hash) const {
+    if (!capacity_) return {capacity_, capacity_};
+    const auto h2 = H2(hash);
+    const size_type mask = capacity_ / details::kGroupWidth - 1;
+    size_type group = H1(hash) & mask;
+    size_type free = capacity_;
+    for (size_type probe = 1;; ++probe) {
+      const size_type base = group * details::kGroupWidth;
+      details::CtrlGroup g(ctrl_ + base);
+      for (auto m = g.Match(h2); m; m &= m - 1) {
+        size_type i = base + __builtin_ctz(m);
+        if (eq_(slots_[i].value.first, k)) return {i, free};
+      }
+      if (free == capacity_) {
+        if (auto m = g.MatchEmptyOrDeleted()) free = base + __builtin_ctz(m);
+      }
+      if (g.MatchEmpty()) return {capacity_, free};
+      group = (group + probe) & mask;
+    }
+  }
+
+  // Number of lookups in flight at once for find_batch; enough to cover memory
+  // latency, without the prefetches evicting each other.
+  static constexpr size_type kBatchSize = 16;
+  static constexpr size_type kBatchMinBytes = 2 << 20;
+
+  template <typename Self, typename KeyIt, typename Cb>
+  static void FindBatch(Self& self, KeyIt keys, size_type n, Cb& cb) {
+    if (self.capacity_ * (sizeof(Slot) + 1) <= kBatchMinBytes) {
+      // Small enough to stay in cache, so there are no misses to overlap.
+      for (size_type i = 0; i < n; ++i) cb(i, self.find(keys[i]));
+      return;
+    }
+    const size_type mask = self.capacity_ / details::kGroupWidth - 1;
+    size_t hashes[kBatchSize];
+    for (size_type start = 0; start < n; start += kBatchSize) {
+      const size_type len = std::min(kBatchSize, n - start);
+      for (size_type j = 0; j < len; ++j) {
+        hashes[j] = self.HashOf(keys[start + j]);
+        auto base = (H1(hashes[j]) & mask) * details::kGroupWidth;
+        __builtin_prefetch(self.ctrl_ + base);
+      }
+      for (size_type j = 0; j < len; ++j) {
+        auto base = (H1(hashes[j]) & mask) * details::kGroupWidth;
+        details::CtrlGroup g(self.ctrl_ + base);
+        for (auto m = g.Match(H2(hashes[j])); m; m &= m - 1)
+          __builtin_prefetch(&self.slots_[base + __builtin_ctz(m)]);
+      }
+      for (size_type j = 0; j < len; ++j) {
+        const auto& k = keys[start + j];
+        cb(start + j, self.IteratorAt(self.FindIndex(k, hashes[j])));
+      }
+    }
+  }
+
+  // Returns index of first empty or erased slot on the probe sequence.
+  size_type FindFirstNonFull(size_t hash) const {
+    const size_type mask = capacity_ / details::kGroupWidth - 1;
+    size_type group = H1(hash) & mask;
+    for (size_type probe = 1;; ++probe) {
+      const size_type base = group * details::kGroupWidth;
+      if (auto m = details::CtrlGroup(ctrl_ + base).MatchEmptyOrDeleted())
+        return base + __builtin_ctz(m);
+      group = (group + probe) & mask;
+    }
+  }
+
+  // Inserts a key known not to be present.
+  template <typename Key, typename... Args>
+  iterator EmplaceNew(size_t hash, Key&& k, Args&&... args) {
+    if (!growth_left_) Grow();
+    return EmplaceAt(FindFirstNonFull(hash),
+                     hash,
+                     std::forward<Key>(k),
+                     std::forward<Args>(args)...);
+  }
+
+  // Inserts a key known not to be present in slot `i`, which must be empty or
+  // erased, with room to grow if it's empty.
+  template <typename Key, typename... Args>
+  iterator EmplaceAt(size_type i, size_t hash, Key&& k, Args&&... args) {
+    new (&slots_[i].value) value_type(
+        std::piecewise_construct,
+        std::forward_as_tuple(std::forward<Key>(k)),
+        std::forward_as_tuple(std::forward<Args>(args)...));
+    if (ctrl_[i] == details::kCtrlEmpty) --growth_left_;
+    ctrl_[i] = H2(hash);
+    ++size_;
+    return iterator(ctrl_ + i, slots_ + i);
+  }
+
+  void EraseAt(size_type i) {
+    slots_[i].value.~value_type();
+    --size_;
+    // If this group still has an empty slot, every probe that reached it
+    // stopped here, so the slot can go back to empty instead of leaving a
+    // tombstone.
+    auto base = i & ~(details::kGroupWidth - 1);
+    if (details::CtrlGroup(ctrl_ + base).MatchEmpty()) {
+      ctrl_[i] = details::kCtrlEmpty;
+      ++growth_left_;
+    } else {
+      ctrl_[i] = details::kCtrlDeleted;
+    }
+  }
+
+  // Makes room for at least one more entry. If the table is mostly
+  // tombstones, this cleans them out rather than doubling.
+  void Grow() {
+    if (!capacity_)
+      Resize(kMinCapacity);
+    else if (size_ * 32 <= capacity_ * 25)
+      Resize(capacity_);
+    else
+      Resize(capacity_ * 2);
+  }
+
+  void Resize(size_type new_capacity) {
+    auto* old_ctrl = ctrl_;
+    auto* old_slots = slots_;
+    auto old_capacity = capacity_;
+
+    auto* mem = static_cast<char*>(::operator new(
+        CtrlBytes(new_capacity) + new_capacity * sizeof(Slot), kAlign));
+    ctrl_ = reinterpret_cast<details::ctrl_t*>(mem);
+    slots_ = reinterpret_cast<Slot*>(mem + CtrlBytes(new_capacity));
+    capacity_ = new_capacity;
+    ResetCtrl();
+    growth_left_ = MaxLoad(capacity_) - size_;
+
+    for (size_type i = 0; i != old_capacity; ++i) {
+      if (old_ctrl[i] < 0) continue;
+      auto& old = old_slots[i];
+      auto hash = HashOf(old.value.first);
+      auto j = FindFirstNonFull(hash);
+      new (&slots_[j].mutable_value)
+          std::pair<K, V>(std::move(old.mutable_value));
+      old.value.~value_type();
+      ctrl_[j] = H2(hash);
+    }
+    if (old_capacity)
+      ::operator delete(old_ctrl,
+                        CtrlBytes(old_capacity) + old_capacity * sizeof(Slot),
+                        kAlign);
+  }
+
+  void ResetCtrl() {
+    std::fill_n(ctrl_, CtrlBytes(capacity_), details::kCtrlEmpty);
+    ctrl_[capacity_] = details::kCtrlSentinel;
+  }
+
+  void DestroyAll() {
+    if constexpr (!std::is_trivially_destructible_v<value_type>) {
+      for (size_type i = 0; i != capacity_; ++i)
+        if (ctrl_[i] >= 0) slots_[i].value.~value_type();
+    }
+  }
+
+  void Deallocate() {
+    if (!capacity_) return;
+    ::operator delete(
+        ctrl_, CtrlBytes(capacity_) + capacity_ * sizeof(Slot), kAlign);
+    ctrl_ = EmptyCtrl();
+    slots_ = nullptr;
+    capacity_ = 0;
+  }
+
+  details::ctrl_t* ctrl_ = EmptyCtrl();
+  Slot* slots_ = nullptr;
+  size_type capacity_ = 0;
+  size_type size_ = 0;
+  size_type growth_left_ = 0;
+  Hash hash_;
+  Eq eq_;
+};
+
+// Forward iterator over FlatHashMap.
+template <typename K, typename V, typename Hash, typename Eq>
+template <bool IsConst>
+class FlatHashMap<K, V, Hash, Eq>::Iterator {
+  using SlotT = std::conditional_t<IsConst, const Slot, Slot>;
+
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = typename FlatHashMap::value_type;
+  using difference_type = std::ptrdiff_t;
+  using reference = std::conditional_t<IsConst, const value_type&, value_type&>;
+  using pointer = std::conditional_t<IsConst, const value_type*, value_type*>;
+
+  Iterator() = default;
+
+  // Allow conversion from iterator to const_iterator.
+  template <bool WasConst, std::enable_if_t<IsConst && !WasConst, int> = 0>
+  Iterator(const Iterator<WasConst>& it)  // NOLINT, implicit is fine here.
+      : ctrl_(it.ctrl_), slot_(it.slot_) {}
+
+  reference operator*() const { return slot_->value; }
+  pointer operator->() const { return &slot_->value; }
+
+  Iterator& operator++() {
+    ++ctrl_;
+    ++slot_;
+    SkipEmpty();
+    return *this;
+  }
+
+  Iterator operator++(int) {
+    auto it = *this;
+    ++*this;
+    return it;
+  }
+
+  bool operator==(const Iterator& o) const { return ctrl_ == o.ctrl_; }
+  bool operator!=(const Iterator& o) const { return ctrl_ != o.ctrl_; }
+
+ private:
+  friend class FlatHashMap;
+  template <bool>
+  friend class Iterator;
+
+  explicit Iterator(const details::ctrl_t* ctrl) : ctrl_(ctrl) {}
+
+  Iterator(const details::ctrl_t* ctrl, SlotT* slot)
+      : ctrl_(ctrl), slot_(slot) {
+    SkipEmpty();
+  }
+
+  // Advances past empty and erased slots, stopping at the sentinel.
+  void SkipEmpty() {
+    while (*ctrl_ < details::kCtrlSentinel) {
+      ++ctrl_;
+      ++slot_;
+    }
+  }
+
+  const details::ctrl_t* ctrl_{};
+  SlotT* slot_{};
+};
+
+// A StringHashMap is a FlatHashMap keyed on std::string, where the value
+// defaults to std::string but can be specified.
+//
+// By using this type, you automatically get transparent lookup, so that a
+// std::string_view, cstring_view or const char* key doesn't have to be
+// converted to a std::string temporary.
+template <typename V = std::string>
+using StringHashMap = FlatHashMap<std::string,
+                                  V,
+                                  StringHash,
+                                  StringEqual>;
+
+// Use this helper to make MapKey instances for FlatHashMap.
+template <typename K, typename V, typename Hash, typename Eq, typename FinderT>
+BasicMapKey<FlatHashMap<K, V, Hash, Eq>, FinderT> MakeMapKey(
+    FlatHashMap<K, V, Hash, Eq>& m, FinderT&& key) {
+  return BasicMapKey<FlatHashMap<K, V, Hash, Eq>, FinderT>(
+      m, std::forward<FinderT>(key));
+}
+
+}  // namespace beeswax::nectar
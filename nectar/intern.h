@@ -0,0 +1,197 @@
+// String interning, for cheap comparison and hashing of repeated strings.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <ostream>
+#include <shared_mutex>
+#include <string_view>
+
+#include "arena.h"
+#include "collections.h"
+#include "cstring_view.h"
+#include "hash.h"
+#include "hash_map.h"
+
+namespace beeswax::nectar {
+
+class InternPool;
+
+// Internal implementation details; do not use.
+namespace details {
+// The interned copy of a string. In a pool, its terminated characters follow
+// it in memory, so they're usually in the same cache line.
+struct InternEntry {
+  uint64_t hash;
+  size_t size;
+  const char* data;
+};
+
+inline constexpr InternEntry kEmptyInternEntry{Hash64(""), 0, ""};
+}  // namespace details
+
+// An InternedString is a handle to a string stored once in an InternPool.
+//
+// Since each distinct string is stored only once, equality is a pointer
+// comparison and the hash is computed once, when interning. The handle is the
+// size of a pointer and trivially copyable, and the characters are always
+// terminated, so it converts to cstring_view and std::string_view for free.
+//
+// Usage:
+//    auto domain = Intern(request.domain());
+//    if (domain == kExampleDomain) ...
+//    auto* bid = FindPtr(bids_by_domain, domain);
+//
+// The hash is the same as StringHash's, so InternedString can be used for
+// lookup in StringMap, StringUnorderedMap and StringHashMap, and also as a key
+// in its own right, with std::hash and FlatHashMap.
+//
+// Handles are only valid as long as their pool, and only compare equal to
+// handles from the same pool. A default-constructed handle is the empty
+// string, and is equal to the empty string interned in any pool.
+class InternedString {
+ public:
+  constexpr InternedString() noexcept = default;
+
+  constexpr const char* c_str() const noexcept { return entry_->data; }
+  constexpr const char* data() const noexcept { return entry_->data; }
+  constexpr size_t size() const noexcept { return entry_->size; }
+  constexpr bool empty() const noexcept { return entry_->size == 0; }
+
+  // Returns the precomputed Hash64 of the characters.
+  constexpr uint64_t hash() const noexcept { return entry_->hash; }
+
+  constexpr operator std::string_view() const noexcept {  // NOLINT
+    return {entry_->data, entry_->size};
+  }
+
+  constexpr operator cstring_view() const {  // NOLINT
+    return {entry_->data, entry_->size};
+  }
+
+  friend constexpr bool operator==(InternedString l, InternedString r) {
+    return l.entry_ == r.entry_;
+  }
+
+  friend constexpr bool operator!=(InternedString l, InternedString r) {
+    return l.entry_ != r.entry_;
+  }
+
+  // Orders by characters, for use in sorted containers.
+  friend constexpr bool operator<(InternedString l, InternedString r) {
+    return l.entry_ != r.entry_ &&
+           static_cast<std::string_view>(l) < static_cast<std::string_view>(r);
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, InternedString s) {
+    return os << static_cast<std::string_view>(s);
+  }
+
+ private:
+  friend class InternPool;
+
+  constexpr explicit InternedString(const details::InternEntry* entry) noexcept
+      : entry_(entry) {}
+
+  const details::InternEntry* entry_{&details::kEmptyInternEntry};
+};
+
+// An InternPool stores one copy of each distinct string given to it, and hands
+// out InternedString handles to them.
+//
+// It's thread-safe. Lookups of strings already interned take a shared lock,
+// so they proceed in parallel, and only new strings take an exclusive lock.
+// Strings are never removed, so the pool grows with the number of distinct
+// strings, and it's best suited to values drawn from a bounded set.
+//
+// Usage:
+//    InternPool pool;
+//    auto a = pool.Intern("example.com");
+//    auto b = pool.Intern(std::string("example.com"));
+//    assert(a == b);
+//
+// For most purposes, the global pool, through the Intern function, will do.
+class InternPool {
+ public:
+  InternPool() = default;
+  InternPool(const InternPool&) = delete;
+  InternPool& operator=(const InternPool&) = delete;
+
+  // Returns the handle for the string, adding it if necessary. The string is
+  // hashed once, for both lookups and the entry, and a new one is inserted
+  // where the second lookup left off.
+  InternedString Intern(std::string_view s) {
+    if (s.empty()) return InternedString();
+    const HashedStringView key(s);
+    {
+      std::shared_lock lock(mutex_);
+      if (auto* entry = FindPtr(entries_, key)) return InternedString(*entry);
+    }
+
+    std::unique_lock lock(mutex_);
+    auto [it, prepared] = entries_.find_or_prepare_insert(key);
+    if (it != entries_.end()) return InternedString(it->second);
+    auto mem = arena_.Allocate(sizeof(details::InternEntry) + s.size() + 1,
+                               alignof(details::InternEntry));
+    auto data = static_cast<char*>(mem) + sizeof(details::InternEntry);
+    std::memcpy(data, s.data(), s.size());
+    data[s.size()] = '\0';
+    auto entry = new (mem) details::InternEntry{key.hash(), s.size(), data};
+    // Key on the interned copy, since the argument may not outlive this.
+    entries_.emplace_prepared(
+        prepared, std::string_view(data, s.size()), entry);
+    return InternedString(entry);
+  }
+
+  // Returns the handle for the string if it was already interned, without
+  // adding it. Use this for untrusted input, to avoid growing the pool.
+  std::optional<InternedString> Find(std::string_view s) const {
+    if (s.empty()) return InternedString();
+    std::shared_lock lock(mutex_);
+    if (auto* entry = FindPtr(entries_, s)) return InternedString(*entry);
+    return std::nullopt;
+  }
+
+  // Returns the number of distinct non-empty strings interned.
+  size_t size() const {
+    std::shared_lock lock(mutex_);
+    return entries_.size();
+  }
+
+  // Returns the global pool, which is never destroyed.
+  static InternPool& Global() {
+    static auto* pool = new InternPool;
+    return *pool;
+  }
+
+ private:
+  using EntryMap = FlatHashMap<std::string_view,
+                               const details::InternEntry*,
+                               StringHash,
+                               StringEqual>;
+
+  mutable std::shared_mutex mutex_;
+  EntryMap entries_;
+  Arena arena_;
+};
+
+// Interns the string in the global pool.
+inline InternedString Intern(std::string_view s) {
+  return InternPool::Global().Intern(s);
+}
+
+}  // namespace beeswax::nectar
+
+// Provide a specialization of std::hash for InternedString, using the
+// precomputed hash.
+template <>
+struct std::hash<beeswax::nectar::InternedString> {
+  size_t operator()(beeswax::nectar::InternedString s) const noexcept {
+    return s.hash();
+  }
+};
@@ -0,0 +1,223 @@
+// Read-only memory-mapped files, terminated so they can be used as C strings.
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "cstring_view.h"
+#include "scoper.h"
+
+namespace beeswax::nectar {
+
+// A MappedFile maps a whole file into memory, read-only, and guarantees that
+// a NUL follows its last byte, so its contents can be used as a cstring_view,
+// and handed to C parsers, without being copied.
+//
+// The file's whole pages are mapped over a reserved, zero-filled region one
+// byte longer than it, rounded up to whole pages, and any partial last page is
+// copied into the reservation's next page, where the bytes after it stay
+// zero. Mapping that page of the file instead would leave the NUL to the
+// kernel's zero-fill of the page past the end of the file, which data
+// appended while it's mapped would overwrite. So at most one page is copied,
+// and the contents stay terminated whatever happens to the file.
+//
+// Pages are read in on first access, so opening even a very large file is
+// fast. Use Advise to hint at how it will be read. For files of less than a
+// few hundred KB, setting up the mapping costs more than a copy would.
+//
+// Usage:
+//    MappedFile segments("/data/segments.tsv");
+//    segments.Advise(MappedFile::Advice::kSequential);
+//    Parse(segments.view().c_str());
+//
+// Example without helper:
+//    std::ifstream in("/data/segments.tsv", std::ios::binary);
+//    std::string contents{std::istreambuf_iterator<char>(in), {}};
+//    Parse(contents.c_str());
+//
+// The file should not be truncated while mapped, since reading past its new
+// end raises SIGBUS. Data appended to it isn't visible, and other changes made
+// to it by other processes may or may not be.
+class MappedFile {
+ public:
+  // Hints for Advise, which correspond to those for `madvise`.
+  enum class Advice {
+    kNormal,
+    // Read ahead aggressively, and drop pages soon after they're read.
+    kSequential,
+    // Don't read ahead.
+    kRandom,
+    // Start reading in the pages now.
+    kWillNeed,
+    // Back with transparent huge pages, where the kernel supports it for
+    // files, to cut TLB misses on random access.
+    kHugePage,
+  };
+
+  // Constructs an empty file, which is still terminated.
+  MappedFile() noexcept = default;
+
+  // Maps the file at path, throwing std::system_error on failure.
+  explicit MappedFile(cstring_view path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) ThrowSystemError("open", path);
+    auto close_fd = MakeScopeGuard([fd] { ::close(fd); });
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) ThrowSystemError("fstat", path);
+    const auto size = static_cast<size_t>(st.st_size);
+    if (!size) return;
+
+    const size_t mapped = RoundUpToPage(size + 1);
+    void* region = ::mmap(nullptr,
+                          mapped,
+                          PROT_READ,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                          -1,
+                          0);
+    if (region == MAP_FAILED) ThrowSystemError("mmap", path);
+    auto unmap = MakeScopeGuard([&] { ::munmap(region, mapped); });
+
+    const size_t whole = size & ~(PageSize() - 1);
+    if (whole && ::mmap(region,
+                        whole,
+                        PROT_READ,
+                        MAP_PRIVATE | MAP_FIXED,
+                        fd,
+                        0) == MAP_FAILED)
+      ThrowSystemError("mmap", path);
+    size_t tail = 0;
+    if (whole < size) {
+      char* page = static_cast<char*>(region) + whole;
+      if (::mprotect(page, PageSize(), PROT_READ | PROT_WRITE) != 0)
+        ThrowSystemError("mprotect", path);
+      tail = ReadTail(fd, page, size - whole, whole, path);
+      if (::mprotect(page, PageSize(), PROT_READ) != 0)
+        ThrowSystemError("mprotect", path);
+    }
+    unmap.Cancel();
+    data_ = static_cast<const char*>(region);
+    size_ = whole + tail;
+    mapped_ = mapped;
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept
+      : data_(std::exchange(other.data_, "")),
+        size_(std::exchange(other.size_, 0)),
+        mapped_(std::exchange(other.mapped_, 0)) {}
+
+  MappedFile& operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+      Unmap();
+      data_ = std::exchange(other.data_, "");
+      size_ = std::exchange(other.size_, 0);
+      mapped_ = std::exchange(other.mapped_, 0);
+    }
+    return *this;
+  }
+
+  ~MappedFile() { Unmap(); }
+
+  // Returns the contents, which are followed by a NUL.
+  const char* data() const noexcept { return data_; }
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return !size_; }
+
+  // Returns the contents as a terminated view, valid for the life of the
+  // mapping.
+  cstring_view view() const { return cstring_view(data_, size_); }
+
+  // Hints at how `len` bytes from `offset` will be read, or by default, the
+  // whole file. Returns whether the kernel accepted the hint; ignoring a
+  // rejected hint is always safe.
+  bool Advise(Advice advice,
+              size_t offset = 0,
+              size_t len = std::string::npos) const noexcept {
+    if (!mapped_ || offset >= size_) return false;
+    // The range must start on a page boundary.
+    const size_t start = offset & ~(PageSize() - 1);
+    const size_t end = len < size_ - offset ? offset + len : size_;
+    return ::madvise(const_cast<char*>(data_) + start,
+                     end - start,
+                     ToMadvise(advice)) == 0;
+  }
+
+ private:
+  static size_t PageSize() noexcept {
+    static const auto page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return page;
+  }
+
+  static size_t RoundUpToPage(size_t n) noexcept {
+    return (n + PageSize() - 1) & ~(PageSize() - 1);
+  }
+
+  // Reads up to `n` bytes from `offset` into `p`, stopping early only if the
+  // file has been truncated, and returns the number read.
+  static size_t ReadTail(int fd,
+                         char* p,
+                         size_t n,
+                         size_t offset,
+                         cstring_view path) {
+    size_t done = 0;
+    while (done < n) {
+      const auto got = ::pread(fd, p + done, n - done, offset + done);
+      if (got < 0 && errno == EINTR) continue;
+      if (got < 0) ThrowSystemError("pread", path);
+      if (got == 0) break;
+      done += static_cast<size_t>(got);
+    }
+    return done;
+  }
+
+  static int ToMadvise(Advice advice) noexcept {
+    switch (advice) {
+      case Advice::kSequential:
+        return MADV_SEQUENTIAL;
+      case Advice::kRandom:
+        return MADV_RANDOM;
+      case Advice::kWillNeed:
+        return MADV_WILLNEED;
+      case Advice::kHugePage:
+#ifdef MADV_HUGEPAGE
+        return MADV_HUGEPAGE;
+#else
+        return MADV_NORMAL;
+#endif
+      case Advice::kNormal:
+        break;
+    }
+    return MADV_NORMAL;
+  }
+
+  [[noreturn]] static void ThrowSystemError(const char* call,
+                                            cstring_view path) {
+    throw std::system_error(errno,
+                            std::generic_category(),
+                            std::string("MappedFile: ") + call + " " +
+                                std::string(path));
+  }
+
+  void Unmap() noexcept {
+    if (mapped_) ::munmap(const_cast<char*>(data_), mapped_);
+  }
+
+  // An empty file points to a literal, so that it's still terminated.
+  const char* data_ = "";
+  size_t size_ = 0;
+  // Length of the whole reservation, or 0 if nothing is mapped.
+  size_t mapped_ = 0;
+};
+
+}  // namespace beeswax::nectar
@@ -0,0 +1,149 @@
+// Recycling of erased nodes for node-based maps.
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "collections.h"
+
+namespace beeswax::nectar {
+
+// A NodePool keeps nodes erased from a node-based map, such as std::map,
+// StringMap or std::unordered_map, so that later inserts can reuse them
+// instead of allocating.
+//
+// Erasing through the pool extracts the node, rather than freeing it, and
+// parks it on a free list. Inserting through the pool takes a parked node,
+// assigns the new key and value over the old ones and links it back in. Since
+// the key and value are assigned rather than constructed, a std::string key
+// or value also reuses its buffer, so steady insert/erase churn, such as a
+// session table or an order book, runs without touching the heap at all.
+//
+// Usage:
+//    NodePool<StringMap<Session>> pool;
+//    pool.Erase(sessions, expired_id);
+//    erase_if(sessions, [&](auto& kv) { return kv.second.Expired(); }, pool);
+//    MakeMapKey(sessions, id, pool).Assign(session);
+//    insert(sessions, id, session, pool);
+//
+// Example without helper:
+//    sessions.erase(expired_id);
+//    MakeMapKey(sessions, id).Assign(session);
+//
+// Parked nodes keep their old keys and values alive until reused or cleared,
+// so hold heavy resources in values with care. At most `capacity` nodes are
+// parked; beyond that, erased nodes are freed as usual. Nodes may be moved
+// between maps of the same type, as long as their allocators compare equal,
+// which std::allocator always does. Not thread-safe.
+template <typename MapT>
+class NodePool {
+ public:
+  using map_type = MapT;
+  using node_type = typename MapT::node_type;
+  using size_type = std::size_t;
+
+  static constexpr size_type kDefaultCapacity = 1024;
+
+  // Constructs an empty pool, parking at most `capacity` nodes.
+  explicit NodePool(size_type capacity = kDefaultCapacity)
+      : capacity_(capacity) {}
+
+  NodePool(const NodePool&) = delete;
+  NodePool& operator=(const NodePool&) = delete;
+  NodePool(NodePool&&) = default;
+  NodePool& operator=(NodePool&&) = default;
+
+  // Returns the number of parked nodes.
+  size_type size() const noexcept { return nodes_.size(); }
+
+  bool empty() const noexcept { return nodes_.empty(); }
+
+  size_type capacity() const noexcept { return capacity_; }
+
+  // Frees all parked nodes.
+  void clear() noexcept { nodes_.clear(); }
+
+  // Parks node, if it's not empty and there's room. Otherwise, it's freed.
+  void Put(node_type&& node) {
+    if (node && nodes_.size() < capacity_) nodes_.push_back(std::move(node));
+  }
+
+  // Returns a parked node, or an empty one if none.
+  node_type Take() noexcept {
+    if (nodes_.empty()) return {};
+    auto node = std::move(nodes_.back());
+    nodes_.pop_back();
+    return node;
+  }
+
+  // Erases entry at position, parking its node. Returns the following
+  // position, like `map::erase`.
+  typename MapT::iterator Erase(MapT& m, typename MapT::iterator pos) {
+    auto next = std::next(pos);
+    Put(m.extract(pos));
+    return next;
+  }
+
+  // Erases entry for key, if any, parking its node. Returns number erased.
+  template <typename K>
+  size_type Erase(MapT& m, const K& k) {
+    auto it = m.find(k);
+    if (it == m.end()) return 0;
+    Put(m.extract(it));
+    return 1;
+  }
+
+ private:
+  std::vector<node_type> nodes_;
+  size_type capacity_;
+};
+
+// Use this helper to make MapKey instances that insert with nodes from the
+// pool, when it has any.
+template <typename MapT, typename FinderT>
+BasicMapKey<MapT, FinderT, NodePool<MapT>> MakeMapKey(MapT& m,
+                                                      FinderT&& key,
+                                                      NodePool<MapT>& pool) {
+  return BasicMapKey<MapT, FinderT, NodePool<MapT>>(
+      m, std::forward<FinderT>(key), &pool);
+}
+
+// Inserts key and value, if the key isn't already there, reusing a node from
+// the pool. Returns whether inserted.
+//
+// Usage:
+//    insert(sessions, id, session, pool);
+//
+// Example without helper:
+//    sessions.try_emplace(id, session);
+template <typename MapT, typename K, typename M>
+bool insert(MapT& m, K&& k, M&& value, NodePool<MapT>& pool) {
+  auto mk = MakeMapKey(m, std::forward<K>(k), pool);
+  return !mk && mk.Emplace(std::forward<M>(value));
+}
+
+// Erases every entry matching predicate, parking the nodes in the pool.
+// Returns the number erased.
+//
+// Usage:
+//    erase_if(sessions, [&](auto& kv) { return kv.second.Expired(); }, pool);
+//
+// Example without helper:
+//    erase_if(sessions, [&](auto& kv) { return kv.second.Expired(); });
+template <typename MapT, typename Pred>
+typename MapT::size_type erase_if(MapT& m, Pred pred, NodePool<MapT>& pool) {
+  typename MapT::size_type n = 0;
+  for (auto it = m.begin(); it != m.end();) {
+    if (pred(*it)) {
+      it = pool.Erase(m, it);
+      ++n;
+    } else {
+      ++it;
+    }
+  }
+  return n;
+}
+
+}  // namespace beeswax::nectar
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstddef>
+#include <cstring>
 #include <functional>
+#include <new>
+#include <type_traits>
 #include <utility>
 
 namespace beeswax::nectar {
@@ -57,4 +61,291 @@ class Scoper {
   std::function<void()> cleanup_cb_;
 };
 
+// RAII ScopeGuard
+//
+// Like Scoper, but holds the closer by value, as its own type, rather than in
+// a std::function. So there's no type erasure, no indirect call and no heap
+// allocation, however large the closer's captures, and nothing it does can
+// throw, short of the callbacks themselves. Cancelling just clears a flag.
+//
+// Usage:
+//    auto unlock = MakeScopeGuard([&] { mu.unlock(); });
+//    auto timer = MakeScopeGuard([&] { start = Now(); },
+//                                [&] { latency.Add(Now() - start); });
+//    if (ScopeGuard guard{[&] { Release(slot); }}) { ... }
+//
+// The API matches Scoper, so that switching is a matter of changing the type,
+// except that a guard can't be default-constructed or assigned, since its
+// closer type can't be replaced. Use Scoper where a closer must be chosen at
+// runtime. The closer must not throw.
+template <typename CloseCb>
+class ScopeGuard {
+ public:
+  explicit ScopeGuard(CloseCb close_cb, bool do_it = true) noexcept(
+      std::is_nothrow_move_constructible_v<CloseCb>)
+      : close_cb_(std::move(close_cb)), active_(do_it) {}
+
+  template <typename OpenCb,
+            typename C = CloseCb,
+            std::enable_if_t<std::is_invocable_v<C&>, int> = 0>
+  ScopeGuard(OpenCb open_cb, CloseCb close_cb, bool do_it = true) noexcept(
+      std::is_nothrow_move_constructible_v<CloseCb> &&
+      std::is_nothrow_invocable_v<OpenCb&>)
+      : close_cb_(std::move(close_cb)), active_(do_it) {
+    if (do_it) open_cb();
+  }
+
+  ScopeGuard(ScopeGuard&& scope) noexcept(
+      std::is_nothrow_move_constructible_v<CloseCb>)
+      : close_cb_(std::move(scope.close_cb_)),
+        active_(std::exchange(scope.active_, false)) {}
+
+  ScopeGuard(const ScopeGuard&) = delete;
+  ScopeGuard& operator=(const ScopeGuard&) = delete;
+  ScopeGuard& operator=(ScopeGuard&&) = delete;
+
+  ~ScopeGuard() {
+    if (active_) close_cb_();
+  }
+
+  explicit operator bool() const noexcept { return true; }
+
+  void Cancel() noexcept { active_ = false; }
+
+ private:
+  CloseCb close_cb_;
+  bool active_;
+};
+
+// Use this helper to make ScopeGuard instances from a closer.
+template <typename CloseCb>
+ScopeGuard<std::decay_t<CloseCb>> MakeScopeGuard(CloseCb&& close_cb,
+                                                 bool do_it = true) {
+  return ScopeGuard<std::decay_t<CloseCb>>(std::forward<CloseCb>(close_cb),
+                                           do_it);
+}
+
+// Use this helper to make ScopeGuard instances from an opener and closer.
+template <typename OpenCb,
+          typename CloseCb,
+          std::enable_if_t<std::is_invocable_v<std::decay_t<CloseCb>&>, int> =
+              0>
+ScopeGuard<std::decay_t<CloseCb>> MakeScopeGuard(OpenCb&& open_cb,
+                                                 CloseCb&& close_cb,
+                                                 bool do_it = true) {
+  return ScopeGuard<std::decay_t<CloseCb>>(
+      std::forward<OpenCb>(open_cb), std::forward<CloseCb>(close_cb), do_it);
+}
+
+// Internal implementation details; do not use.
+namespace details {
+// Type-erased operations on a closer stored in a ScopeStack.
+struct ScopeStackOps {
+  // Runs the closer, then destroys it.
+  void (*run)(void* p) noexcept;
+  // Destroys the closer without running it.
+  void (*destroy)(void* p) noexcept;
+  // Move-constructs the closer at `to` from `from`, then destroys `from`.
+  void (*relocate)(void* to, void* from) noexcept;
+};
+
+template <typename CloseCb>
+inline constexpr ScopeStackOps kScopeStackOps = {
+    [](void* p) noexcept {
+      auto* f = static_cast<CloseCb*>(p);
+      (*f)();
+      f->~CloseCb();
+    },
+    [](void* p) noexcept { static_cast<CloseCb*>(p)->~CloseCb(); },
+    [](void* to, void* from) noexcept {
+      auto* f = static_cast<CloseCb*>(from);
+      ::new (to) CloseCb(std::move(*f));
+      f->~CloseCb();
+    },
+};
+
+// Trails each closer in a ScopeStack, so that the stack can be walked from the
+// top down.
+struct alignas(std::max_align_t) ScopeStackFooter {
+  const ScopeStackOps* ops;
+  // Size of the whole entry, closer and footer.
+  size_t size;
+};
+
+// Returns the space taken by an object of the specified size, rounded up so
+// that whatever follows it is aligned for anything.
+constexpr size_t ScopeStackRoundUp(size_t size) {
+  constexpr size_t kAlign = alignof(std::max_align_t);
+  return (size + kAlign - 1) / kAlign * kAlign;
+}
+}  // namespace details
+
+// RAII ScopeStack
+//
+// Collects any number of closers, of any types, and runs them in reverse order
+// on destruction, like a stack of Scopers or ScopeGuards, but in one object.
+//
+// Closers are moved, one after the other, into a single buffer, which is held
+// inline up to `kInlineSize` bytes, so the common case makes no allocations at
+// all. Past that, the buffer moves to the heap, doubling as needed.
+//
+// Usage:
+//    ScopeStack cleanup;
+//    for (auto& shard : shards) {
+//      shard.mutex.lock();
+//      cleanup.Push([&] { shard.mutex.unlock(); });
+//    }
+//    cleanup.Push([&] { ++open_files; }, [&] { --open_files; });
+//    if (!ok) return;  // Runs closers, newest first.
+//    handoff = std::move(cleanup);  // Transfers them all.
+//
+// Cancel() drops every closer at once, without running it, and moving the
+// stack transfers every closer at once. Closers must not throw, since they run
+// from the destructor, and must be nothrow-movable, since the buffer may move.
+// They also must not push onto the stack running them.
+template <size_t kInlineSize>
+class BasicScopeStack {
+  static_assert(kInlineSize > 0, "Inline buffer must not be empty");
+
+ public:
+  BasicScopeStack() noexcept = default;
+
+  BasicScopeStack(BasicScopeStack&& other) noexcept { TakeFrom(other); }
+
+  // Runs this stack's closers, then takes the other's.
+  BasicScopeStack& operator=(BasicScopeStack&& other) noexcept {
+    if (this != &other) {
+      Close();
+      TakeFrom(other);
+    }
+    return *this;
+  }
+
+  BasicScopeStack(const BasicScopeStack&) = delete;
+  BasicScopeStack& operator=(const BasicScopeStack&) = delete;
+
+  ~BasicScopeStack() {
+    Close();
+    FreeHeap();
+  }
+
+  // Returns the number of closers pending.
+  size_t size() const noexcept { return count_; }
+
+  bool empty() const noexcept { return count_ == 0; }
+
+  // Adds closer, to run before those already added. If there's no room and
+  // growing the buffer throws, the closer is run before rethrowing, so that
+  // whatever it cleans up isn't leaked.
+  template <typename CloseCb>
+  void Push(CloseCb&& close_cb) {
+    using F = std::decay_t<CloseCb>;
+    static_assert(alignof(F) <= alignof(std::max_align_t),
+                  "Closer is over-aligned");
+    static_assert(std::is_nothrow_move_constructible_v<F>,
+                  "Closer must be nothrow-movable");
+    constexpr size_t kClosed = details::ScopeStackRoundUp(sizeof(F));
+    constexpr size_t kEntry = kClosed + sizeof(details::ScopeStackFooter);
+    if (capacity_ - used_ < kEntry) {
+      try {
+        Grow(kEntry);
+      } catch (...) {
+        close_cb();
+        throw;
+      }
+    }
+    ::new (data_ + used_) F(std::forward<CloseCb>(close_cb));
+    ::new (data_ + used_ + kClosed)
+        details::ScopeStackFooter{&details::kScopeStackOps<F>, kEntry};
+    used_ += kEntry;
+    ++count_;
+  }
+
+  // Runs opener, then adds closer.
+  template <typename OpenCb, typename CloseCb>
+  void Push(OpenCb&& open_cb, CloseCb&& close_cb) {
+    open_cb();
+    Push(std::forward<CloseCb>(close_cb));
+  }
+
+  // Runs all closers now, newest first, leaving the stack empty.
+  void Close() noexcept {
+    while (used_) {
+      auto [ops, close_cb] = Pop();
+      ops->run(close_cb);
+    }
+  }
+
+  // Drops all closers without running them.
+  void Cancel() noexcept {
+    while (used_) {
+      auto [ops, close_cb] = Pop();
+      ops->destroy(close_cb);
+    }
+  }
+
+ private:
+  // Removes the top entry, returning its operations and closer.
+  std::pair<const details::ScopeStackOps*, void*> Pop() noexcept {
+    auto* footer = reinterpret_cast<details::ScopeStackFooter*>(
+        data_ + used_ - sizeof(details::ScopeStackFooter));
+    used_ -= footer->size;
+    --count_;
+    return {footer->ops, data_ + used_};
+  }
+
+  // Moves every entry to the same offset in another buffer.
+  void RelocateTo(char* to) noexcept {
+    for (size_t top = used_; top;) {
+      auto* footer = reinterpret_cast<details::ScopeStackFooter*>(
+          data_ + top - sizeof(details::ScopeStackFooter));
+      top -= footer->size;
+      footer->ops->relocate(to + top, data_ + top);
+      std::memcpy(to + top + footer->size - sizeof(*footer), footer,
+                  sizeof(*footer));
+    }
+  }
+
+  // Moves entries to a heap buffer with room for at least `bytes` more.
+  void Grow(size_t bytes) {
+    size_t capacity = capacity_ * 2;
+    while (capacity - used_ < bytes) capacity *= 2;
+    auto* data = static_cast<char*>(::operator new(capacity));
+    RelocateTo(data);
+    FreeHeap();
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  void FreeHeap() noexcept {
+    if (data_ != inline_) ::operator delete(data_);
+  }
+
+  // Takes other's closers, leaving it empty. This must be empty.
+  void TakeFrom(BasicScopeStack& other) noexcept {
+    FreeHeap();
+    if (other.data_ == other.inline_) {
+      data_ = inline_;
+      capacity_ = kInlineSize;
+      other.RelocateTo(inline_);
+    } else {
+      data_ = other.data_;
+      capacity_ = other.capacity_;
+      other.data_ = other.inline_;
+      other.capacity_ = kInlineSize;
+    }
+    used_ = std::exchange(other.used_, 0);
+    count_ = std::exchange(other.count_, 0);
+  }
+
+  char* data_ = inline_;
+  size_t capacity_ = kInlineSize;
+  size_t used_ = 0;
+  size_t count_ = 0;
+  alignas(std::max_align_t) char inline_[kInlineSize];
+};
+
+// ScopeStack with room for a few dozen small closers before allocating.
+using ScopeStack = BasicScopeStack<512>;
+
 }  // namespace beeswax::nectar
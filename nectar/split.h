@@ -0,0 +1,258 @@
+// Zero-copy splitting of a mutable buffer into terminated pieces.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "cstring_view.h"
+#include "string_search.h"
+
+namespace beeswax::nectar {
+
+// Internal implementation details; do not use.
+namespace details {
+// Delimiters are found a block at a time, as a bitmask.
+inline constexpr size_t kSplitBlock = 64;
+
+// Set of delimiter characters, as both a list, for SIMD comparisons, and a
+// table, for scalar lookup.
+struct DelimiterSet {
+  explicit DelimiterSet(std::string_view set) noexcept : size(set.size()) {
+    for (size_t j = 0; j < set.size(); ++j) {
+      if (j < kMaxSimdSetSize) chars[j] = set[j];
+      table[static_cast<unsigned char>(set[j])] = true;
+    }
+  }
+
+  char chars[kMaxSimdSetSize] = {};
+  size_t size;
+  bool table[256] = {};
+};
+
+// Each kernel returns a bit for each of the 64 bytes at `p` that is in the set.
+// The SIMD kernels only handle sets of 1 to kMaxSimdSetSize characters.
+using DelimiterMaskFn = uint64_t (*)(const char* p,
+                                     const DelimiterSet& set) noexcept;
+
+inline uint64_t DelimiterMaskScalar(const char* p,
+                                    const DelimiterSet& set) noexcept {
+  uint64_t mask = 0;
+  for (size_t i = 0; i < kSplitBlock; ++i)
+    mask |= uint64_t{set.table[static_cast<unsigned char>(p[i])]} << i;
+  return mask;
+}
+
+// The SIMD kernels load the block once and compare it against each delimiter
+// in turn, which keeps everything in registers.
+#ifdef __SSE2__
+inline uint64_t DelimiterMaskSse2(const char* p,
+                                  const DelimiterSet& set) noexcept {
+  __m128i data[4];
+  __m128i match[4];
+  for (size_t b = 0; b < 4; ++b) {
+    data[b] = LoadSse2(p + b * 16);
+    match[b] = _mm_setzero_si128();
+  }
+  for (size_t j = 0; j < set.size; ++j) {
+    const __m128i v = _mm_set1_epi8(set.chars[j]);
+    for (size_t b = 0; b < 4; ++b)
+      match[b] = _mm_or_si128(match[b], _mm_cmpeq_epi8(data[b], v));
+  }
+  uint64_t mask = 0;
+  for (size_t b = 0; b < 4; ++b)
+    mask |= uint64_t{static_cast<unsigned>(_mm_movemask_epi8(match[b]))}
+            << (b * 16);
+  return mask;
+}
+
+__attribute__((target("avx2"))) inline uint64_t DelimiterMaskAvx2(
+    const char* p,
+    const DelimiterSet& set) noexcept {
+  const __m256i lo = LoadAvx2(p);
+  const __m256i hi = LoadAvx2(p + 32);
+  __m256i match_lo = _mm256_setzero_si256();
+  __m256i match_hi = _mm256_setzero_si256();
+  for (size_t j = 0; j < set.size; ++j) {
+    const __m256i v = _mm256_set1_epi8(set.chars[j]);
+    match_lo = _mm256_or_si256(match_lo, _mm256_cmpeq_epi8(lo, v));
+    match_hi = _mm256_or_si256(match_hi, _mm256_cmpeq_epi8(hi, v));
+  }
+  return uint64_t{static_cast<unsigned>(_mm256_movemask_epi8(match_lo))} |
+         uint64_t{static_cast<unsigned>(_mm256_movemask_epi8(match_hi))} << 32;
+}
+#endif
+
+// Returns the fastest kernel this CPU supports for the set.
+inline DelimiterMaskFn GetDelimiterMask(const DelimiterSet& set) noexcept {
+  static const DelimiterMaskFn simd = []() -> DelimiterMaskFn {
+#ifdef __SSE2__
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return &DelimiterMaskAvx2;
+    return &DelimiterMaskSse2;
+#else
+    return &DelimiterMaskScalar;
+#endif
+  }();
+  if (set.size == 0 || set.size > kMaxSimdSetSize) return &DelimiterMaskScalar;
+  return simd;
+}
+}  // namespace details
+
+// Tokenizer that splits a mutable, terminated buffer on any of a set of
+// delimiter characters, overwriting each delimiter it passes with a NUL, so
+// that every piece is itself a terminated cstring_view into the buffer. Use
+// SplitInPlace to make these.
+//
+// Pieces are found lazily, as the tokenizer is iterated, and nothing is
+// allocated or copied. Empty pieces, between adjacent delimiters, are kept,
+// and splitting an empty buffer yields a single empty piece, as with CSV
+// fields.
+//
+// Delimiters are located 64 bytes at a time, as a bitmask, using SSE2 or
+// AVX2 as the CPU allows, for sets of up to 8 characters, or a lookup table
+// for larger ones. Finding each piece is then just taking the lowest bit.
+//
+// The buffer must outlive the pieces, and once split, no longer reads as the
+// original string, since each delimiter passed has been overwritten.
+class InPlaceSplitter {
+ public:
+  class iterator;
+
+  // Splits the `n` bytes at `p`, which must be followed by a NUL, throwing
+  // otherwise.
+  InPlaceSplitter(char* p, size_t n, std::string_view delimiters)
+      : p_(p),
+        n_(n),
+        set_(delimiters),
+        mask_fn_(details::GetDelimiterMask(set_)) {
+    if (!p_ || p_[n_] != '\0')
+      throw std::logic_error("Unterminated input to SplitInPlace");
+    mask_ = BlockMask(0);
+  }
+
+  InPlaceSplitter(std::string& s, std::string_view delimiters)
+      : InPlaceSplitter(s.data(), s.size(), delimiters) {}
+
+  // Sets `piece` to the next piece, terminating it. Returns false when there
+  // are no more.
+  bool Next(cstring_view& piece) {
+    if (done_) return false;
+    while (!mask_) {
+      base_ += details::kSplitBlock;
+      if (base_ >= n_) {
+        piece = cstring_view(p_ + pos_, n_ - pos_);
+        done_ = true;
+        return true;
+      }
+      mask_ = BlockMask(base_);
+    }
+    const size_t end = base_ + __builtin_ctzll(mask_);
+    mask_ &= mask_ - 1;
+    p_[end] = '\0';
+    piece = cstring_view(p_ + pos_, end - pos_);
+    pos_ = end + 1;
+    return true;
+  }
+
+  // Iterating consumes the pieces, so begin once.
+  iterator begin();
+  iterator end();
+
+ private:
+  // Returns the delimiter bits for the block at `base`. A partial last block
+  // is copied out, so as not to read past the buffer.
+  uint64_t BlockMask(size_t base) const noexcept {
+    if (base + details::kSplitBlock <= n_) return mask_fn_(p_ + base, set_);
+    const size_t rest = n_ - base;
+    char block[details::kSplitBlock] = {};
+    std::memcpy(block, p_ + base, rest);
+    return mask_fn_(block, set_) & ((uint64_t{1} << rest) - 1);
+  }
+
+  char* p_;
+  size_t n_;
+  details::DelimiterSet set_;
+  details::DelimiterMaskFn mask_fn_;
+  // Start of the next piece.
+  size_t pos_ = 0;
+  // Start of the current block, and its delimiters not yet passed.
+  size_t base_ = 0;
+  uint64_t mask_ = 0;
+  bool done_ = false;
+};
+
+// Input iterator over the pieces.
+class InPlaceSplitter::iterator {
+ public:
+  using iterator_category = std::input_iterator_tag;
+  using value_type = cstring_view;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const cstring_view*;
+  using reference = const cstring_view&;
+
+  iterator() = default;
+
+  reference operator*() const { return piece_; }
+  pointer operator->() const { return &piece_; }
+
+  iterator& operator++() {
+    if (!splitter_->Next(piece_)) splitter_ = nullptr;
+    return *this;
+  }
+
+  bool operator==(const iterator& o) const { return splitter_ == o.splitter_; }
+  bool operator!=(const iterator& o) const { return splitter_ != o.splitter_; }
+
+ private:
+  friend class InPlaceSplitter;
+
+  explicit iterator(InPlaceSplitter* splitter) : splitter_(splitter) {
+    ++*this;
+  }
+
+  InPlaceSplitter* splitter_ = nullptr;
+  cstring_view piece_;
+};
+
+inline InPlaceSplitter::iterator InPlaceSplitter::begin() {
+  return iterator(this);
+}
+
+inline InPlaceSplitter::iterator InPlaceSplitter::end() { return iterator(); }
+
+// Splits a mutable string on any of the delimiter characters, without copying,
+// yielding each piece as a terminated cstring_view into the string. Each
+// delimiter is overwritten with a NUL as the pieces are iterated. See
+// InPlaceSplitter.
+//
+// Usage:
+//    for (cstring_view field : SplitInPlace(line, ','))
+//      Ingest(field.c_str());
+//
+// Example without helper:
+//    std::stringstream in(line);
+//    for (std::string field; std::getline(in, field, ',');)
+//      Ingest(field.c_str());
+inline InPlaceSplitter SplitInPlace(std::string& s,
+                                    std::string_view delimiters) {
+  return InPlaceSplitter(s, delimiters);
+}
+
+inline InPlaceSplitter SplitInPlace(std::string& s, char delimiter) {
+  return InPlaceSplitter(s, std::string_view(&delimiter, 1));
+}
+
+// Splits the `n` bytes at `p`, which must be followed by a NUL, as when read
+// into a buffer and terminated. Throws std::logic_error if it isn't.
+inline InPlaceSplitter SplitInPlace(char* p,
+                                    size_t n,
+                                    std::string_view delimiters) {
+  return InPlaceSplitter(p, n, delimiters);
+}
+
+}  // namespace beeswax::nectar
@@ -0,0 +1,496 @@
+// Fast substring and character search.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "cstring_view.h"
+
+namespace beeswax::nectar {
+
+// Internal implementation details; do not use.
+namespace details {
+// Sets with more characters than this are searched with a lookup table,
+// rather than one SIMD comparison per character.
+inline constexpr size_t kMaxSimdSetSize = 8;
+
+// Below this, SIMD setup and dispatch cost more than they save.
+inline constexpr size_t kMinSimdSearchLen = 16;
+
+// Find follows the needle's first character with memchr, as
+// std::string_view::find does, which is fastest while that character is rare.
+// After this many places where it isn't followed by the rest of the needle,
+// it's taken to be common, and the kernels, which match the first and last
+// characters together, take over.
+inline constexpr size_t kMaxFalseStarts = 4;
+
+// Below this, Find doesn't switch, since dispatching to a kernel costs more
+// than it saves.
+inline constexpr size_t kMinSimdFindLen = 128;
+
+// Each kernel searches `n` bytes at `p`, returning the offset found, or `n`
+// if there isn't one. Kernels for the same search return the same result;
+// they differ only in speed.
+
+constexpr size_t FindByteScalar(const char* p, size_t n, char c) noexcept {
+  for (size_t i = 0; i < n; ++i)
+    if (p[i] == c) return i;
+  return n;
+}
+
+// Returns whether the middle of the needle, between its first and last
+// characters, is at `p`.
+inline bool MiddleAt(const char* p, const char* s, size_t m) noexcept {
+  return m <= 2 || !std::memcmp(p + 1, s + 1, m - 2);
+}
+
+// Returns whether the needle is at `p`. The first and last characters are
+// checked first, since those filter best.
+constexpr bool NeedleAt(const char* p, const char* s, size_t m) noexcept {
+  return p[0] == s[0] && p[m - 1] == s[m - 1] &&
+         (m <= 2 || std::char_traits<char>::compare(p + 1, s + 1, m - 2) == 0);
+}
+
+constexpr size_t FindScalar(const char* p,
+                            size_t n,
+                            const char* s,
+                            size_t m) noexcept {
+  for (size_t i = 0; i + m <= n; ++i)
+    if (NeedleAt(p + i, s, m)) return i;
+  return n;
+}
+
+constexpr size_t RFindScalar(const char* p,
+                             size_t n,
+                             const char* s,
+                             size_t m) noexcept {
+  for (size_t i = n - m + 1; i-- > 0;)
+    if (NeedleAt(p + i, s, m)) return i;
+  return n;
+}
+
+constexpr size_t FindFirstOfScalar(const char* p,
+                                   size_t n,
+                                   const char* set,
+                                   size_t k) noexcept {
+  bool table[256] = {};
+  for (size_t j = 0; j < k; ++j) table[static_cast<unsigned char>(set[j])] = 1;
+  for (size_t i = 0; i < n; ++i)
+    if (table[static_cast<unsigned char>(p[i])]) return i;
+  return n;
+}
+
+// Like FindFirstOfScalar, but relies on `p[n]` being NUL to stop the scan,
+// instead of checking bounds on every character.
+inline size_t FindFirstOfTerminated(const char* p,
+                                    size_t n,
+                                    const char* set,
+                                    size_t k) noexcept {
+  bool table[256] = {};
+  for (size_t j = 0; j < k; ++j) table[static_cast<unsigned char>(set[j])] = 1;
+  const bool nul_in_set = table[0];
+  table[0] = 1;
+  for (size_t i = 0;; ++i) {
+    while (!table[static_cast<unsigned char>(p[i])]) ++i;
+    if (i >= n) return n;
+    if (p[i] || nul_in_set) return i;
+  }
+}
+
+// The SIMD kernels test a block of candidate offsets at a time. Rather than
+// finishing with a scalar loop, the last block is moved back to end exactly at
+// the end of the input, overlapping the one before it, and the overlap is
+// masked off.
+#ifdef __SSE2__
+inline __m128i LoadSse2(const char* p) noexcept {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+// Returns a bit for each of the 16 offsets from `p` where the first and last
+// characters of the needle match.
+inline unsigned MatchEndsSse2(const char* p,
+                              __m128i first,
+                              __m128i last,
+                              size_t m) noexcept {
+  return _mm_movemask_epi8(
+      _mm_and_si128(_mm_cmpeq_epi8(LoadSse2(p), first),
+                    _mm_cmpeq_epi8(LoadSse2(p + m - 1), last)));
+}
+
+inline unsigned MatchSetSse2(const char* p,
+                             const __m128i* v,
+                             size_t k) noexcept {
+  const __m128i data = LoadSse2(p);
+  __m128i match = _mm_cmpeq_epi8(data, v[0]);
+  for (size_t j = 1; j < k; ++j)
+    match = _mm_or_si128(match, _mm_cmpeq_epi8(data, v[j]));
+  return _mm_movemask_epi8(match);
+}
+
+inline size_t FindByteSse2(const char* p, size_t n, char c) noexcept {
+  if (n < 16) return FindByteScalar(p, n, c);
+  const __m128i v = _mm_set1_epi8(c);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(LoadSse2(p + i), v));
+    if (mask) return i + __builtin_ctz(mask);
+  }
+  if (i == n) return n;
+  auto j = n - 16;
+  unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(LoadSse2(p + j), v)) &
+                  (0xFFFFU << (i - j));
+  return mask ? j + __builtin_ctz(mask) : n;
+}
+
+inline size_t FindSse2(const char* p,
+                       size_t n,
+                       const char* s,
+                       size_t m) noexcept {
+  // Candidates are the offsets [0, end).
+  const size_t end = n - m + 1;
+  if (end < 16) return FindScalar(p, n, s, m);
+  const __m128i first = _mm_set1_epi8(s[0]);
+  const __m128i last = _mm_set1_epi8(s[m - 1]);
+  size_t i = 0;
+  for (; i + 16 <= end; i += 16) {
+    for (auto mask = MatchEndsSse2(p + i, first, last, m); mask;
+         mask &= mask - 1) {
+      auto j = i + __builtin_ctz(mask);
+      if (MiddleAt(p + j, s, m)) return j;
+    }
+  }
+  if (i >= end) return n;
+  auto b = end - 16;
+  for (auto mask = MatchEndsSse2(p + b, first, last, m) & (0xFFFFU << (i - b));
+       mask;
+       mask &= mask - 1) {
+    auto j = b + __builtin_ctz(mask);
+    if (MiddleAt(p + j, s, m)) return j;
+  }
+  return n;
+}
+
+inline size_t RFindSse2(const char* p,
+                        size_t n,
+                        const char* s,
+                        size_t m) noexcept {
+  // Candidates are the offsets [0, end), searched a block at a time from the
+  // end.
+  size_t end = n - m + 1;
+  if (end < 16) return RFindScalar(p, n, s, m);
+  const __m128i first = _mm_set1_epi8(s[0]);
+  const __m128i last = _mm_set1_epi8(s[m - 1]);
+  for (;;) {
+    const size_t b = end >= 16 ? end - 16 : 0;
+    auto mask = MatchEndsSse2(p + b, first, last, m);
+    if (end < 16) mask &= (1U << end) - 1;
+    while (mask) {
+      auto bit = 31 - __builtin_clz(mask);
+      if (MiddleAt(p + b + bit, s, m)) return b + bit;
+      mask &= ~(1U << bit);
+    }
+    if (b == 0) return n;
+    end = b;
+  }
+}
+
+inline size_t FindFirstOfSse2(const char* p,
+                              size_t n,
+                              const char* set,
+                              size_t k) noexcept {
+  if (n < 16) return FindFirstOfScalar(p, n, set, k);
+  __m128i v[kMaxSimdSetSize];
+  for (size_t j = 0; j < k; ++j) v[j] = _mm_set1_epi8(set[j]);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    unsigned mask = MatchSetSse2(p + i, v, k);
+    if (mask) return i + __builtin_ctz(mask);
+  }
+  if (i == n) return n;
+  auto j = n - 16;
+  unsigned mask = MatchSetSse2(p + j, v, k) & (0xFFFFU << (i - j));
+  return mask ? j + __builtin_ctz(mask) : n;
+}
+#endif
+
+// The AVX2 kernels hand inputs too short for a full block to SSE2, which every
+// x86 CPU with AVX2 also has.
+#ifdef __SSE2__
+__attribute__((target("avx2"))) inline __m256i LoadAvx2(
+    const char* p) noexcept {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+__attribute__((target("avx2"))) inline unsigned MatchEndsAvx2(
+    const char* p,
+    __m256i first,
+    __m256i last,
+    size_t m) noexcept {
+  return _mm256_movemask_epi8(
+      _mm256_and_si256(_mm256_cmpeq_epi8(LoadAvx2(p), first),
+                       _mm256_cmpeq_epi8(LoadAvx2(p + m - 1), last)));
+}
+
+__attribute__((target("avx2"))) inline unsigned MatchSetAvx2(
+    const char* p,
+    const __m256i* v,
+    size_t k) noexcept {
+  const __m256i data = LoadAvx2(p);
+  __m256i match = _mm256_cmpeq_epi8(data, v[0]);
+  for (size_t j = 1; j < k; ++j)
+    match = _mm256_or_si256(match, _mm256_cmpeq_epi8(data, v[j]));
+  return _mm256_movemask_epi8(match);
+}
+
+__attribute__((target("avx2"))) inline size_t FindByteAvx2(const char* p,
+                                                          size_t n,
+                                                          char c) noexcept {
+  if (n < 32) return FindByteSse2(p, n, c);
+  const __m256i v = _mm256_set1_epi8(c);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(LoadAvx2(p + i), v));
+    if (mask) return i + __builtin_ctz(mask);
+  }
+  if (i == n) return n;
+  auto j = n - 32;
+  unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(LoadAvx2(p + j), v)) &
+                  (~0U << (i - j));
+  return mask ? j + __builtin_ctz(mask) : n;
+}
+
+__attribute__((target("avx2"))) inline size_t FindAvx2(const char* p,
+                                                      size_t n,
+                                                      const char* s,
+                                                      size_t m) noexcept {
+  const size_t end = n - m + 1;
+  if (end < 32) return FindSse2(p, n, s, m);
+  const __m256i first = _mm256_set1_epi8(s[0]);
+  const __m256i last = _mm256_set1_epi8(s[m - 1]);
+  size_t i = 0;
+  for (; i + 64 <= end; i += 64) {
+    uint64_t mask = MatchEndsAvx2(p + i, first, last, m) |
+                    uint64_t{MatchEndsAvx2(p + i + 32, first, last, m)} << 32;
+    for (; mask; mask &= mask - 1) {
+      auto j = i + __builtin_ctzll(mask);
+      if (MiddleAt(p + j, s, m)) return j;
+    }
+  }
+  for (; i + 32 <= end; i += 32) {
+    for (auto mask = MatchEndsAvx2(p + i, first, last, m); mask;
+         mask &= mask - 1) {
+      auto j = i + __builtin_ctz(mask);
+      if (MiddleAt(p + j, s, m)) return j;
+    }
+  }
+  if (i >= end) return n;
+  auto b = end - 32;
+  for (auto mask = MatchEndsAvx2(p + b, first, last, m) & (~0U << (i - b));
+       mask;
+       mask &= mask - 1) {
+    auto j = b + __builtin_ctz(mask);
+    if (MiddleAt(p + j, s, m)) return j;
+  }
+  return n;
+}
+
+__attribute__((target("avx2"))) inline size_t RFindAvx2(const char* p,
+                                                       size_t n,
+                                                       const char* s,
+                                                       size_t m) noexcept {
+  size_t end = n - m + 1;
+  if (end < 32) return RFindSse2(p, n, s, m);
+  const __m256i first = _mm256_set1_epi8(s[0]);
+  const __m256i last = _mm256_set1_epi8(s[m - 1]);
+  for (;;) {
+    const size_t b = end >= 32 ? end - 32 : 0;
+    auto mask = MatchEndsAvx2(p + b, first, last, m);
+    if (end < 32) mask &= (1U << end) - 1;
+    while (mask) {
+      auto bit = 31 - __builtin_clz(mask);
+      if (MiddleAt(p + b + bit, s, m)) return b + bit;
+      mask &= ~(1U << bit);
+    }
+    if (b == 0) return n;
+    end = b;
+  }
+}
+
+__attribute__((target("avx2"))) inline size_t FindFirstOfAvx2(
+    const char* p,
+    size_t n,
+    const char* set,
+    size_t k) noexcept {
+  if (n < 32) return FindFirstOfSse2(p, n, set, k);
+  __m256i v[kMaxSimdSetSize];
+  for (size_t j = 0; j < k; ++j) v[j] = _mm256_set1_epi8(set[j]);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    unsigned mask = MatchSetAvx2(p + i, v, k);
+    if (mask) return i + __builtin_ctz(mask);
+  }
+  if (i == n) return n;
+  auto j = n - 32;
+  unsigned mask = MatchSetAvx2(p + j, v, k) & (~0U << (i - j));
+  return mask ? j + __builtin_ctz(mask) : n;
+}
+#endif
+
+using FindByteFn = size_t (*)(const char*, size_t, char) noexcept;
+using FindFn = size_t (*)(const char*, size_t, const char*, size_t) noexcept;
+
+struct SearchKernels {
+  FindByteFn find_byte;
+  FindFn find;
+  FindFn rfind;
+  FindFn find_first_of;
+};
+
+// Returns the fastest kernels this CPU supports, chosen once at runtime.
+inline const SearchKernels& GetSearchKernels() noexcept {
+  static const SearchKernels kernels = []() -> SearchKernels {
+#ifdef __SSE2__
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return {&FindByteAvx2, &FindAvx2, &RFindAvx2, &FindFirstOfAvx2};
+    return {&FindByteSse2, &FindSse2, &RFindSse2, &FindFirstOfSse2};
+#else
+    return {&FindByteScalar, &FindScalar, &RFindScalar, &FindFirstOfScalar};
+#endif
+  }();
+  return kernels;
+}
+
+constexpr bool IsSearchConstantEvaluated() noexcept {
+  return __builtin_is_constant_evaluated();
+}
+
+// Searches `n` bytes at `p` for the needle, which is not empty and fits.
+// Always inlined, as std::string_view::find is, so that the comparisons with
+// a literal needle are folded.
+__attribute__((always_inline)) constexpr size_t FindIn(const char* p,
+                                                       size_t n,
+                                                       const char* s,
+                                                       size_t m) noexcept {
+  if (IsSearchConstantEvaluated())
+    return m == 1 ? FindByteScalar(p, n, *s) : FindScalar(p, n, s, m);
+  if (m == 1) {
+    return n < kMinSimdSearchLen ? FindByteScalar(p, n, *s)
+                                 : GetSearchKernels().find_byte(p, n, *s);
+  }
+  const size_t end = n - m + 1;
+  size_t i = 0;
+  for (size_t k = 0; k < kMaxFalseStarts || n < kMinSimdFindLen; ++k, ++i) {
+    if (i >= end) return n;
+    auto* q = static_cast<const char*>(std::memchr(p + i, *s, end - i));
+    if (!q) return n;
+    i = q - p;
+    if (NeedleAt(p + i, s, m)) return i;
+  }
+  if (i >= end) return n;
+  return i + GetSearchKernels().find(p + i, n - i, s, m);
+}
+}  // namespace details
+
+// Returns the offset of the first occurrence of the needle in the haystack at
+// or after `pos`, or npos. This is the same as `std::string_view::find`, using
+// SSE2 or AVX2 as the CPU allows.
+//
+// Usage:
+//    if (auto i = Find(url, "/creative/"); i != std::string_view::npos)
+//      creative_id = url.substr(i + 10);
+//
+// std::string_view::find stops at each occurrence of the needle's first
+// character, so it's slow when that character is common in the haystack, as
+// '/' is in a URL. Find starts out the same way, but once the first character
+// has turned up a few times without the rest of the needle, it switches to
+// matching the first and last characters together, a block at a time. On
+// haystacks of a few hundred bytes or more, that's several times faster.
+// When the first character is rare, as 'C' of "Chrome/" in a user agent, Find
+// never switches, and is as fast as std::string_view::find. Nor does it on
+// haystacks under 128 bytes.
+__attribute__((always_inline)) constexpr size_t Find(std::string_view haystack,
+                                                     std::string_view needle,
+                                                     size_t pos = 0) noexcept {
+  if (pos > haystack.size() || needle.size() > haystack.size() - pos)
+    return std::string_view::npos;
+  if (needle.empty()) return pos;
+  auto n = haystack.size() - pos;
+  auto i =
+      details::FindIn(haystack.data() + pos, n, needle.data(), needle.size());
+  return i == n ? std::string_view::npos : pos + i;
+}
+
+// Returns the offset of the last occurrence of the needle in the haystack that
+// starts at or before `pos`, or npos. This is the same as
+// `std::string_view::rfind`, only faster.
+constexpr size_t RFind(std::string_view haystack,
+                       std::string_view needle,
+                       size_t pos = std::string_view::npos) noexcept {
+  if (needle.size() > haystack.size()) return std::string_view::npos;
+  auto start = std::min(pos, haystack.size() - needle.size());
+  if (needle.empty()) return start;
+  // Only the part that could hold a match at or before `start` is searched.
+  auto n = start + needle.size();
+  const char* p = haystack.data();
+  size_t i = 0;
+  if (details::IsSearchConstantEvaluated() || n < details::kMinSimdSearchLen)
+    i = details::RFindScalar(p, n, needle.data(), needle.size());
+  else
+    i = details::GetSearchKernels().rfind(p, n, needle.data(), needle.size());
+  return i == n ? std::string_view::npos : i;
+}
+
+// Returns the offset of the first character in the haystack at or after `pos`
+// that is any of the characters in the set, or npos. This is the same as
+// `std::string_view::find_first_of`, only faster.
+//
+// Usage:
+//    auto path = url.substr(0, FindFirstOf(url, "?#"));
+constexpr size_t FindFirstOf(std::string_view haystack,
+                             std::string_view set,
+                             size_t pos = 0) noexcept {
+  if (pos >= haystack.size() || set.empty()) return std::string_view::npos;
+  const char* p = haystack.data() + pos;
+  auto n = haystack.size() - pos;
+  size_t i = 0;
+  if (set.size() == 1)
+    i = details::FindIn(p, n, set.data(), 1);
+  else if (details::IsSearchConstantEvaluated() ||
+           n < details::kMinSimdSearchLen ||
+           set.size() > details::kMaxSimdSetSize)
+    i = details::FindFirstOfScalar(p, n, set.data(), set.size());
+  else
+    i = details::GetSearchKernels().find_first_of(p, n, set.data(), set.size());
+  return i == n ? std::string_view::npos : pos + i;
+}
+
+// FindFirstOf for a terminated string. Large sets are scanned with the
+// terminating NUL as a sentinel, without checking bounds on every character.
+//
+// This is a template only so that it's preferred for cstring_view, but not
+// for anything that merely converts to both.
+template <typename T,
+          std::enable_if_t<std::is_same_v<T, cstring_view>, int> = 0>
+constexpr size_t FindFirstOf(const T& haystack,
+                             std::string_view set,
+                             size_t pos = 0) noexcept {
+  if (details::IsSearchConstantEvaluated() ||
+      set.size() <= details::kMaxSimdSetSize || pos >= haystack.size())
+    return FindFirstOf(static_cast<std::string_view>(haystack), set, pos);
+  auto n = haystack.size() - pos;
+  auto i = details::FindFirstOfTerminated(
+      haystack.data() + pos, n, set.data(), set.size());
+  return i == n ? std::string_view::npos : pos + i;
+}
+
+}  // namespace beeswax::nectar
@@ -0,0 +1,73 @@
+#include "test/alloc_counter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<size_t> g_allocations{0};
+
+// std::aligned_alloc needs a multiple of the alignment.
+void* AlignedAlloc(size_t n, std::align_val_t al) noexcept {
+  const auto a = static_cast<size_t>(al);
+  return std::aligned_alloc(a, n ? (n + a - 1) / a * a : a);
+}
+
+}  // namespace
+
+void* operator new(size_t n) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+
+// Also replaced, so that everything the replaced delete frees came from
+// malloc, as from std::stable_sort's temporary buffer.
+void* operator new(size_t n, const std::nothrow_t&) noexcept {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(n ? n : 1);
+}
+
+// Over-aligned types, such as FlatHashMap's slots, are allocated by these.
+void* operator new(size_t n, std::align_val_t al) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = AlignedAlloc(n, al)) return p;
+  throw std::bad_alloc();
+}
+
+void* operator new(size_t n,
+                   std::align_val_t al,
+                   const std::nothrow_t&) noexcept {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return AlignedAlloc(n, al);
+}
+
+// Out of line, so the compiler doesn't flag the malloc/free pairing.
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p,
+                                               std::align_val_t) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p,
+                                               size_t,
+                                               std::align_val_t) noexcept {
+  std::free(p);
+}
+
+namespace beeswax::nectar::test {
+
+size_t Allocations() noexcept {
+  return g_allocations.load(std::memory_order_relaxed);
+}
+
+}  // namespace beeswax::nectar::test
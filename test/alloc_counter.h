@@ -0,0 +1,19 @@
+// Counts heap allocations, for tests that check an operation makes none.
+//
+// Linking this in replaces the global operator new and delete.
+#pragma once
+
+#include <cstddef>
+
+namespace beeswax::nectar::test {
+
+// Returns the number of calls to the global operator new so far, from any
+// thread, including the nothrow and aligned forms.
+//
+// Usage:
+//    const auto before = test::Allocations();
+//    EXPECT_EQ(FindOrDefault(m, key), 1);
+//    EXPECT_EQ(test::Allocations(), before);
+size_t Allocations() noexcept;
+
+}  // namespace beeswax::nectar::test
@@ -0,0 +1,188 @@
+#include "nectar/arena.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "test/alloc_counter.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+// Long enough to defeat the small-string optimization.
+std::string LongKey(int i) { return std::string(40, 'k') + std::to_string(i); }
+
+TEST(ArenaTest, Allocate) {
+  Arena arena(64);
+  EXPECT_EQ(arena.BytesReserved(), 0U);
+
+  auto a = static_cast<char*>(arena.Allocate(1, 1));
+  auto b = static_cast<char*>(arena.Allocate(1, 1));
+  EXPECT_EQ(b, a + 1);
+  EXPECT_EQ(arena.BytesReserved(), 64U);
+
+  for (size_t align : {2, 4, 8, 16, 64, 256}) {
+    auto p = arena.Allocate(3, align);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % align, 0U) << align;
+  }
+
+  // Larger than a block gets a block to itself.
+  auto big = static_cast<char*>(arena.Allocate(10000));
+  std::fill(big, big + 10000, 'x');
+  EXPECT_GE(arena.BytesReserved(), 10000U);
+
+  arena.Release();
+  EXPECT_EQ(arena.BytesReserved(), 0U);
+  EXPECT_NE(arena.Allocate(8), nullptr);
+}
+
+TEST(ArenaTest, ResetReusesBlocks) {
+  Arena arena(128);
+  std::vector<void*> first;
+  for (int i = 0; i < 100; ++i) first.push_back(arena.Allocate(24));
+  auto reserved = arena.BytesReserved();
+
+  arena.Reset();
+  auto before = test::Allocations();
+  for (int i = 0; i < 100; ++i) EXPECT_EQ(arena.Allocate(24), first[i]) << i;
+  EXPECT_EQ(test::Allocations(), before);
+  EXPECT_EQ(arena.BytesReserved(), reserved);
+}
+
+TEST(ArenaTest, Allocator) {
+  Arena arena;
+  std::vector<int, ArenaAllocator<int>> v(&arena);
+  for (int i = 0; i < 100; ++i) v.push_back(i);
+  EXPECT_EQ(v[99], 99);
+  EXPECT_EQ(v.get_allocator().arena(), &arena);
+
+  // Without an arena, it's the heap.
+  auto before = test::Allocations();
+  std::vector<int, ArenaAllocator<int>> heap{1, 2, 3};
+  EXPECT_EQ(test::Allocations(), before + 1);
+  EXPECT_EQ(heap.get_allocator().arena(), nullptr);
+
+  EXPECT_EQ(ArenaAllocator<int>(&arena), ArenaAllocator<char>(&arena));
+  EXPECT_NE(ArenaAllocator<int>(&arena), ArenaAllocator<int>());
+}
+
+TEST(ArenaTest, StringMap) {
+  Arena arena;
+  std::vector<std::string> keys;
+  for (int i = 0; i < 100; ++i) keys.push_back(LongKey(i));
+
+  // The first round grows the arena; after that, rounds don't use the heap.
+  for (int round = 0; round < 3; ++round) {
+    auto before = test::Allocations();
+    {
+      ArenaStringMap<int> m(&arena);
+      for (int i = 0; i < 50; ++i) m.emplace(keys[i], i);
+      for (int i = 50; i < 100; ++i)
+        MakeMapKey(m, std::string_view(keys[i])).Assign(i);
+      EXPECT_FALSE(MakeMapKey(m, keys[7].c_str()).Assign(-7));
+
+      EXPECT_EQ(m.size(), 100U);
+      EXPECT_EQ(FindOrDefault(m, keys[7]), -7);
+      EXPECT_EQ(FindOrDefault(m, std::string_view(keys[99])), 99);
+      EXPECT_EQ(FindPtr(m, "missing"), nullptr);
+      EXPECT_EQ(m.begin()->first.get_allocator().arena(), &arena);
+    }
+    if (round > 0) {
+      EXPECT_EQ(test::Allocations(), before) << round;
+    }
+    arena.Reset();
+  }
+
+  // Keys converted to temporaries still end up in the arena.
+  ArenaStringMap<ArenaString> m(&arena);
+  m[LongKey(1).c_str()] = LongKey(2).c_str();
+  m.emplace(LongKey(3), LongKey(4));
+  EXPECT_EQ(m.begin()->first.get_allocator().arena(), &arena);
+  EXPECT_EQ(m.begin()->second.get_allocator().arena(), &arena);
+  EXPECT_EQ(std::string_view(FindOrDefault(m, LongKey(3))), LongKey(4));
+
+  // Copies share the arena.
+  auto copy = m;
+  EXPECT_EQ(copy, m);
+  EXPECT_EQ(copy.begin()->first.get_allocator().arena(), &arena);
+}
+
+TEST(ArenaTest, StringArena) {
+  StringArena strings(256);
+  std::string long_key = LongKey(1);
+  auto a = strings.Store("abc");
+  auto b = strings.Concat(std::string_view("x"), ':', long_key, "/y");
+  auto c = strings.Format("%s-%08x", "id", 0xbeefU);
+  auto d = strings.Store("");
+  auto builder = strings.Build();
+  builder.Append("n=").AppendInt(-42).Append(',').AppendInt(uint64_t{1} << 63);
+  builder.AppendFormat(",%.1f", 2.5);
+  auto e = builder.Finish();
+
+  // Strings are terminated, and packed one after the other.
+  EXPECT_EQ(a, "abc");
+  EXPECT_EQ(a.c_str()[3], '\0');
+  EXPECT_EQ(b, "x:" + long_key + "/y");
+  EXPECT_EQ(b.data(), a.data() + 4);
+  EXPECT_EQ(c, "id-0000beef");
+  EXPECT_EQ(c.data(), b.data() + b.size() + 1);
+  EXPECT_EQ(d, "");
+  EXPECT_EQ(e, "n=-42,9223372036854775808,2.5");
+  EXPECT_EQ(e.c_str()[e.size()], '\0');
+
+  // Strings that outgrow the chunk move, leaving the earlier ones intact.
+  std::string big(10000, 'b');
+  auto f = strings.Concat("<", big, ">");
+  EXPECT_EQ(f, "<" + big + ">");
+  auto g = strings.Format("%s%s", big.c_str(), big.c_str());
+  EXPECT_EQ(g, big + big);
+  auto h = strings.Build();
+  for (int i = 0; i < 2000; ++i) h.AppendInt(i % 10);
+  EXPECT_EQ(h.size(), 2000U);
+  auto digits = h.Finish();
+  EXPECT_TRUE(digits.starts_with("012345678901"));
+  EXPECT_EQ(a, "abc");
+  EXPECT_EQ(e, "n=-42,9223372036854775808,2.5");
+
+  // After a reset, the chunks are reused without going back to the heap.
+  const auto reserved = strings.BytesReserved();
+  const auto big_big = big + big;
+  strings.Reset();
+  auto before = test::Allocations();
+  EXPECT_EQ(strings.Store(long_key), long_key);
+  EXPECT_EQ(strings.Concat(big, big), big_big);
+  EXPECT_EQ(test::Allocations(), before);
+  EXPECT_EQ(strings.BytesReserved(), reserved);
+}
+
+TEST(ArenaTest, StringArenaMap) {
+  StringArena strings;
+  std::vector<std::string> names;
+  for (int i = 0; i < 50; ++i) names.push_back(LongKey(i));
+
+  // The first round grows the arena; after that, rounds don't use the heap.
+  for (int round = 0; round < 3; ++round) {
+    auto before = test::Allocations();
+    {
+      StringArenaMap<int> m(strings.arena());
+      for (int i = 0; i < 100; ++i) {
+        std::string_view name = names[i % 50];
+        auto it = m.find(name);
+        if (it == m.end()) it = m.emplace(strings.Store(name), 0).first;
+        ++it->second;
+      }
+      EXPECT_EQ(m.size(), 50U);
+      EXPECT_EQ(FindOrDefault(m, names[7]), 2);
+      EXPECT_EQ(FindPtr(m, "missing"), nullptr);
+      EXPECT_EQ(m.begin()->first.c_str()[m.begin()->first.size()], '\0');
+    }
+    if (round > 0) {
+      EXPECT_EQ(test::Allocations(), before) << round;
+    }
+    strings.Reset();
+  }
+}
+
+}  // namespace
@@ -0,0 +1,166 @@
+// Test for ConcurrentStringCache.
+#include "nectar/cache.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nectar/cstring_view.h"
+
+namespace {
+
+using std::literals::operator""sv;
+using namespace beeswax::nectar;  // NOLINT
+
+// A clock that only moves when told to.
+struct FakeClock {
+  using rep = int64_t;
+  using period = std::milli;
+  using duration = std::chrono::duration<rep, period>;
+  using time_point = std::chrono::time_point<FakeClock>;
+  static constexpr bool is_steady = true;
+
+  static time_point now() noexcept { return time_point(duration(now_ms)); }
+
+  static inline int64_t now_ms = 1000;
+};
+
+TEST(CacheTest, Basics) {
+  ConcurrentStringCache<int> c(100);
+  EXPECT_EQ(c.shard_count(), 16U);
+  EXPECT_EQ(c.capacity(), 112U);
+  EXPECT_TRUE(c.empty());
+
+  int calls = 0;
+  auto compute = [&] { return ++calls * 10; };
+  EXPECT_EQ(c.GetOrCompute("abc"sv, compute), 10);
+  EXPECT_EQ(c.GetOrCompute(std::string("abc"), compute), 10);
+  EXPECT_EQ(c.GetOrCompute("abc"_sz, compute), 10);
+  EXPECT_EQ(c.GetOrCompute(HashedStringView("abc"), compute), 10);
+  EXPECT_EQ(calls, 1);
+  EXPECT_EQ(c.GetOrCompute("def", compute), 20);
+  EXPECT_EQ(c.size(), 2U);
+
+  EXPECT_EQ(c.Find("abc"), 10);
+  EXPECT_EQ(c.Find("ghi"), std::nullopt);
+  c.Put("abc", 5);
+  c.Put("ghi"sv, 6);
+  EXPECT_EQ(c.Find("abc"), 5);
+  EXPECT_EQ(c.GetOrCompute("ghi", compute), 6);
+
+  EXPECT_EQ(c.erase("abc"), 1U);
+  EXPECT_EQ(c.erase("abc"), 0U);
+  EXPECT_EQ(c.Find("abc"), std::nullopt);
+  EXPECT_EQ(c.size(), 2U);
+
+  auto stats = c.stats();
+  EXPECT_EQ(stats.hits, 6);
+  EXPECT_EQ(stats.misses, 4);
+  EXPECT_EQ(stats.evictions, 0);
+
+  c.clear();
+  EXPECT_TRUE(c.empty());
+  EXPECT_EQ(c.stats().hits, 6);
+
+  // Shards are rounded up to a power of two, and small caches have fewer.
+  EXPECT_EQ(ConcurrentStringCache<int>(100, {}, 5).shard_count(), 8U);
+  EXPECT_EQ(ConcurrentStringCache<int>(5).shard_count(), 8U);
+  EXPECT_EQ(ConcurrentStringCache<int>(5).capacity(), 8U);
+  EXPECT_EQ(ConcurrentStringCache<int>(1).shard_count(), 1U);
+  EXPECT_EQ(ConcurrentStringCache<int>(1).capacity(), 1U);
+  EXPECT_THROW(ConcurrentStringCache<int>(0), std::invalid_argument);
+}
+
+TEST(CacheTest, ClockEviction) {
+  ConcurrentStringCache<int> c(4, {}, 1);
+  for (int i = 0; i < 4; ++i) c.Put(std::to_string(i), i);
+
+  // The hand passes over those referenced since it last did, evicting the
+  // first that wasn't.
+  EXPECT_EQ(c.Find("0"), 0);
+  EXPECT_EQ(c.Find("2"), 2);
+  c.Put("4", 4);
+  EXPECT_EQ(c.Find("1"), std::nullopt);
+  EXPECT_EQ(c.size(), 4U);
+  EXPECT_EQ(c.stats().evictions, 1);
+
+  c.Put("5", 5);
+  EXPECT_EQ(c.Find("3"), std::nullopt);
+  // Now every bit is clear, so the hand takes the next entry, "0".
+  EXPECT_EQ(c.Find("4"), 4);
+  c.Put("6", 6);
+  EXPECT_EQ(c.Find("0"), std::nullopt);
+  EXPECT_EQ(c.Find("2"), 2);
+  EXPECT_EQ(c.Find("4"), 4);
+  EXPECT_EQ(c.Find("5"), 5);
+  EXPECT_EQ(c.Find("6"), 6);
+  EXPECT_EQ(c.stats().evictions, 3);
+
+  // Erased entries' slots are reused before evicting.
+  c.erase("5");
+  c.Put("7", 7);
+  EXPECT_EQ(c.size(), 4U);
+  EXPECT_EQ(c.stats().evictions, 3);
+}
+
+TEST(CacheTest, Ttl) {
+  using namespace std::chrono_literals;
+  ConcurrentStringCache<int, FakeClock> c(8, 100ms, 1);
+  int calls = 0;
+  auto compute = [&] { return ++calls; };
+  EXPECT_EQ(c.GetOrCompute("abc", compute), 1);
+  c.Put("forever", 9, 0ms);
+  c.Put("long", 8, 1000ms);
+
+  FakeClock::now_ms += 99;
+  EXPECT_EQ(c.GetOrCompute("abc", compute), 1);
+  FakeClock::now_ms += 1;
+  EXPECT_EQ(c.Find("abc"), std::nullopt);
+  EXPECT_EQ(c.GetOrCompute("abc", compute), 2);
+  EXPECT_EQ(c.stats().expirations, 1);
+  EXPECT_EQ(c.GetOrCompute("short", compute, 10ms), 3);
+
+  FakeClock::now_ms += 500;
+  EXPECT_EQ(c.Find("forever"), 9);
+  EXPECT_EQ(c.Find("long"), 8);
+  EXPECT_EQ(c.Find("short"), std::nullopt);
+
+  // Expired entries are replaced before live ones are evicted.
+  for (int i = 0; i < 6; ++i) c.Put(std::to_string(i), i);
+  EXPECT_EQ(c.Find("forever"), 9);
+  EXPECT_EQ(c.Find("long"), 8);
+  EXPECT_EQ(c.stats().expirations, 3);
+  EXPECT_EQ(c.stats().evictions, 0);
+}
+
+TEST(CacheTest, Threads) {
+  ConcurrentStringCache<std::string> c(256);
+  std::vector<std::string> keys;
+  for (int i = 0; i < 1000; ++i) keys.push_back("key-" + std::to_string(i));
+
+  std::atomic<int> wrong{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 20000; ++i) {
+        // Mostly a hot set, sometimes any key.
+        const auto& k = keys[(i * 7 + t) % (i % 4 ? 100 : 1000)];
+        if (c.GetOrCompute(k, [&] { return k + "!"; }) != k + "!") ++wrong;
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  EXPECT_EQ(wrong, 0);
+  EXPECT_LE(c.size(), c.capacity());
+  const auto stats = c.stats();
+  EXPECT_EQ(stats.hits + stats.misses, 8 * 20000);
+  EXPECT_GT(stats.hits, stats.misses);
+  EXPECT_GT(stats.evictions, 0);
+}
+
+}  // namespace
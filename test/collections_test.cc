@@ -1,8 +1,16 @@
 #include "nectar/collections.h"
+#include <algorithm>
+#include <bitset>
+#include <iterator>
 #include <memory>
+#include <set>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "gtest/gtest.h"
+#include "test/alloc_counter.h"
 
 namespace {
 
@@ -93,6 +101,226 @@ TEST_F(CollectionsTest, FindPtrTest) {
   ASSERT_TRUE(found);
 }
 
+TEST_F(CollectionsTest, FindPtrBatch) {
+  // StringMap has no batched lookup, so this is just the loop.
+  std::vector<std::string_view> keys{"def", "bbb", "abc"};
+  std::vector<int*> found(keys.size());
+  FindPtrBatch(dict, keys, found);
+  EXPECT_EQ(found, (std::vector<int*>{&dict["def"], nullptr, &dict["abc"]}));
+
+  const auto& kdict = dict;
+  const int* cfound[3];
+  FindPtrBatch(kdict, keys, cfound);
+  EXPECT_EQ(cfound[0], &dict["def"]);
+  EXPECT_EQ(cfound[1], nullptr);
+
+  int values[3];
+  FindOrDefaultBatch(kdict, keys, values, -1);
+  EXPECT_EQ(std::vector<int>(values, values + 3), (std::vector<int>{2, -1, 1}));
+  FindOrDefaultBatch(kdict, keys, values);
+  EXPECT_EQ(values[1], 0);
+
+  std::unordered_map<int, std::string> names{{1, "one"}, {3, "three"}};
+  std::string strs[4];
+  FindOrDefaultBatch(names, std::vector<int>{1, 2, 3, 4}, strs, "none");
+  EXPECT_EQ(strs[0], "one");
+  EXPECT_EQ(strs[1], "none");
+  EXPECT_EQ(strs[2], "three");
+  EXPECT_EQ(strs[3], "none");
+}
+
+// Counts comparisons, to check that sorted input is merged in one pass.
+struct CountingLess {
+  using is_transparent = void;
+
+  template <typename T, typename U>
+  bool operator()(const T& l, const U& r) const {
+    ++*count;
+    return TransparentLessString{}(l, r);
+  }
+
+  size_t* count;
+};
+
+TEST_F(CollectionsTest, BulkUpsert) {
+  std::vector<std::pair<std::string, int>> feed{
+      {"aaa", 1}, {"abc", 2}, {"bbb", 3}, {"zzz", 4}};
+  EXPECT_EQ(BulkUpsert(dict, feed), 3U);
+  EXPECT_EQ(dict, (StringMap<int>{{"aaa", 1},
+                                  {"abc", 2},
+                                  {"bbb", 3},
+                                  {"def", 2},
+                                  {"zzz", 4}}));
+
+  // Unsorted and duplicate keys still work, and later values win.
+  std::vector<std::pair<std::string_view, int>> unsorted{
+      {"def", 5}, {"ccc", 6}, {"aaa", 7}, {"ccc", 8}};
+  EXPECT_EQ(BulkUpsert(dict, unsorted.begin(), unsorted.end()), 1U);
+  EXPECT_EQ(dict, (StringMap<int>{{"aaa", 7},
+                                  {"abc", 2},
+                                  {"bbb", 3},
+                                  {"ccc", 8},
+                                  {"def", 5},
+                                  {"zzz", 4}}));
+
+  // Values are moved from move iterators.
+  StringMap<std::unique_ptr<int>> ptrs;
+  std::vector<std::pair<std::string, std::unique_ptr<int>>> owned;
+  owned.emplace_back("a", std::make_unique<int>(1));
+  BulkUpsert(ptrs,
+             std::make_move_iterator(owned.begin()),
+             std::make_move_iterator(owned.end()));
+  EXPECT_EQ(*ptrs.at("a"), 1);
+  EXPECT_EQ(owned[0].second, nullptr);
+
+  // Loading sorted input, into a map with entries between, is linear in the
+  // comparisons, rather than n log n.
+  size_t count = 0;
+  std::map<std::string, int, CountingLess> m(CountingLess{&count});
+  std::vector<std::pair<std::string, int>> sorted;
+  for (int i = 0; i < 10000; ++i) {
+    auto key = std::to_string(100000 + i);
+    if (i % 2)
+      sorted.emplace_back(key, i);
+    else
+      m.emplace(key, i);
+  }
+  count = 0;
+  EXPECT_EQ(BulkUpsert(m, sorted), 5000U);
+  EXPECT_EQ(m.size(), 10000U);
+  EXPECT_LT(count, 8U * 5000U);
+}
+
+TEST_F(CollectionsTest, MergeInto) {
+  StringMap<int> other{{"aaa", 10}, {"abc", 20}, {"zzz", 30}};
+  EXPECT_EQ(MergeInto(dict, other), 2U);
+  EXPECT_EQ(dict, (StringMap<int>{
+                      {"aaa", 10}, {"abc", 1}, {"def", 2}, {"zzz", 30}}));
+
+  EXPECT_EQ(MergeInto(dict, other, [](int& l, int r) { l += r; }), 0U);
+  EXPECT_EQ(dict, (StringMap<int>{
+                      {"aaa", 20}, {"abc", 21}, {"def", 2}, {"zzz", 60}}));
+
+  StringMap<std::unique_ptr<int>> ptrs;
+  StringMap<std::unique_ptr<int>> more;
+  more.emplace("a", std::make_unique<int>(1));
+  EXPECT_EQ(MergeInto(ptrs, std::move(more)), 1U);
+  EXPECT_EQ(*ptrs.at("a"), 1);
+}
+
+TEST_F(CollectionsTest, IntersectAndSubtractKeys) {
+  StringMap<int> m{{"a", 1}, {"b", 2}, {"c", 3}, {"d", 4}, {"e", 5}};
+  auto copy = m;
+
+  EXPECT_EQ(IntersectKeys(m, StringMap<int>{{"b", 0}, {"d", 0}, {"f", 0}}),
+            3U);
+  EXPECT_EQ(m, (StringMap<int>{{"b", 2}, {"d", 4}}));
+  EXPECT_EQ(IntersectKeys(m, std::vector<std::string_view>{}), 2U);
+  EXPECT_TRUE(m.empty());
+
+  m = copy;
+  EXPECT_EQ(SubtractKeys(m, std::set<std::string>{"0", "a", "c", "e", "f"}),
+            3U);
+  EXPECT_EQ(m, (StringMap<int>{{"b", 2}, {"d", 4}}));
+  EXPECT_EQ(SubtractKeys(m, std::vector<std::string>{"d"}), 1U);
+  EXPECT_EQ(SubtractKeys(m, copy), 1U);
+  EXPECT_TRUE(m.empty());
+}
+
+// Sparse keys over a large map search rather than walk, and consecutive
+// matches are erased together.
+TEST_F(CollectionsTest, SubtractKeysSparse) {
+  std::map<int, int> m;
+  for (int i = 0; i < 1000; ++i) m.emplace(i, i);
+  EXPECT_EQ(SubtractKeys(m, std::vector<int>{-1, 3, 4, 5, 500, 998, 999, 1000}),
+            6U);
+  EXPECT_EQ(m.size(), 994U);
+  EXPECT_EQ(m.count(4), 0U);
+  EXPECT_EQ(m.count(6), 1U);
+  EXPECT_EQ(m.count(500), 0U);
+  EXPECT_EQ(m.count(997), 1U);
+  EXPECT_EQ(SubtractKeys(m, std::vector<int>{2, 2, 6}), 2U);
+  EXPECT_EQ(m.begin()->first, 0);
+  EXPECT_EQ(std::next(m.begin(), 2)->first, 7);
+}
+
+TEST_F(CollectionsTest, RetainAndEraseKeys) {
+  std::map<int64_t, int> m;
+  for (int64_t i = 0; i < 100; ++i) m.emplace(i, 0);
+  auto copy = m;
+
+  // Merged with an ordered set or sorted range.
+  EXPECT_EQ(RetainKeys(m, std::set<int64_t>{1, 2, 3, 50, 200}), 96U);
+  EXPECT_EQ(m.size(), 4U);
+  EXPECT_EQ(EraseKeys(m, std::vector<int64_t>{2, 3}), 2U);
+  EXPECT_EQ(m.size(), 2U);
+
+  // Looked up in a hash set.
+  m = copy;
+  std::unordered_set<int64_t> odd;
+  for (int64_t i = 1; i < 200; i += 2) odd.insert(i);
+  EXPECT_EQ(RetainKeys(m, odd), 50U);
+  EXPECT_TRUE(std::all_of(m.begin(), m.end(), [](auto& kv) {
+    return kv.first % 2;
+  }));
+  EXPECT_EQ(EraseKeys(m, std::unordered_set<int64_t>{1, 3, 4}), 2U);
+  EXPECT_EQ(EraseKeys(m, odd), 48U);
+  EXPECT_TRUE(m.empty());
+
+  // Tested against a bitset, by key.
+  m = copy;
+  m.emplace(-1, 0);
+  std::vector<bool> bits(50);
+  for (size_t i = 0; i < bits.size(); i += 5) bits[i] = true;
+  EXPECT_EQ(RetainKeys(m, bits), 91U);
+  EXPECT_EQ(m.size(), 10U);
+  std::bitset<64> low;
+  low.set(0).set(5).set(7);
+  EXPECT_EQ(EraseKeys(m, low), 2U);
+  EXPECT_EQ(m.begin()->first, 10);
+
+  // Ids ordered otherwise are looked up, not merged.
+  std::map<int, int> small{{1, 1}, {2, 2}, {3, 3}, {4, 4}};
+  auto small_copy = small;
+  EXPECT_EQ(RetainKeys(small, std::set<int, std::greater<>>{4, 3, 1}), 1U);
+  EXPECT_EQ(small, (std::map<int, int>{{1, 1}, {3, 3}, {4, 4}}));
+  small = small_copy;
+  EXPECT_EQ(EraseKeys(small, std::set<int, std::greater<>>{4, 3, 1}), 3U);
+  EXPECT_EQ(small, (std::map<int, int>{{2, 2}}));
+
+  // As are ranges, into a map that isn't ordered by `<`.
+  std::map<int, int, std::greater<>> desc(small_copy.begin(),
+                                          small_copy.end());
+  EXPECT_EQ(RetainKeys(desc, std::vector<int>{1, 3, 4}), 1U);
+  EXPECT_EQ(desc.size(), 3U);
+  EXPECT_EQ(desc.count(2), 0U);
+
+  // Comparators that both order by `<` are merged.
+  StringMap<int> names{{"a", 1}, {"b", 2}, {"c", 3}};
+  EXPECT_EQ(RetainKeys(names, std::set<std::string>{"a", "c", "d"}), 1U);
+  EXPECT_EQ(EraseKeys(names, std::set<std::string>{"c"}), 1U);
+  EXPECT_EQ(names.begin()->first, "a");
+  EXPECT_EQ(names.size(), 1U);
+}
+
+TEST_F(CollectionsTest, RetainAndEraseKeysUnordered) {
+  StringUnorderedMap<int> m;
+  for (int i = 0; i < 100; ++i) m.emplace(std::to_string(i), i);
+  auto copy = m;
+
+  EXPECT_EQ(RetainKeys(m, std::vector<std::string>{"1", "10", "2", "x"}),
+            97U);
+  EXPECT_EQ(m.size(), 3U);
+  EXPECT_EQ(EraseKeys(m, std::set<std::string>{"10", "x"}), 1U);
+  EXPECT_EQ(m.size(), 2U);
+
+  m = copy;
+  StringUnorderedSet<> ids{"5", "50", "500"};
+  EXPECT_EQ(EraseKeys(m, ids), 2U);
+  EXPECT_EQ(RetainKeys(m, ids), 98U);
+  EXPECT_TRUE(m.empty());
+}
+
 enum TargetType {
   AIRPORT,
   AUTONOMOUS_COMMUNITY,
@@ -217,4 +445,67 @@ TEST_F(CollectionsTest, DerefOrDefaultTest) {
   ASSERT_EQ(nosniff::FindOrDefaultCb(mss, "dog", GetKilled), "cat");
 }
 
-}  // namespace
\ No newline at end of file
+TEST_F(CollectionsTest, MapKeyTest) {
+  auto mk = MakeMapKey(dict, "bbb");
+  EXPECT_FALSE(mk);
+  EXPECT_EQ(mk.get(), nullptr);
+  EXPECT_TRUE(mk.Assign(3));
+  EXPECT_TRUE(mk);
+  EXPECT_EQ(*mk, 3);
+  EXPECT_EQ(dict.at("bbb"), 3);
+
+  auto mk2 = MakeMapKey(dict, "abc");
+  EXPECT_TRUE(mk2);
+  EXPECT_EQ(*mk2.get(), 1);
+  EXPECT_FALSE(mk2.Assign(4));
+  EXPECT_EQ(dict.at("abc"), 4);
+
+  // Lvalue keys are copied, not moved from.
+  std::string key{"ccc"};
+  EXPECT_EQ(MakeMapKey(dict, key).DefaultValue(), 0);
+  EXPECT_EQ(key, "ccc");
+  EXPECT_EQ(MakeMapKey(dict, std::string("ddd")).DefaultValue(5), 5);
+  EXPECT_EQ(MakeMapKey(dict, "ddd").DefaultValue(6), 5);
+  EXPECT_EQ(MakeMapKey(dict, "eee").DefaultValueCb([] { return 7; }), 7);
+  EXPECT_EQ(MakeMapKey(dict, "eee").DefaultValueCb([] { return 8; }), 7);
+  EXPECT_TRUE(MakeMapKey(dict, "fff").Emplace(9));
+  // Keys that only explicitly convert to the key type work too.
+  EXPECT_TRUE(MakeMapKey(dict, "ggg"sv).Assign(10));
+  EXPECT_EQ(MakeMapKey(dict, "ggg"sv).DefaultValue(), 10);
+  EXPECT_EQ(dict.size(), 8U);
+}
+
+TEST_F(CollectionsTest, StringUnorderedLookup) {
+  // Keys are too long for the small-string optimization, so a std::string
+  // temporary would have to allocate.
+  const std::string k1(64, 'a');
+  const std::string k2(64, 'b');
+  StringUnorderedMap<int> m{{k1, 1}, {k2, 2}};
+  StringUnorderedSet<> s{k1};
+
+  EXPECT_EQ(StringHash{}(k1), StringHash{}(std::string_view(k1)));
+  EXPECT_EQ(StringHash{}(k1), StringHash{}(k1.c_str()));
+  EXPECT_TRUE(StringEqual{}(k1, std::string_view(k1)));
+  EXPECT_FALSE(StringEqual{}(k1, k2.c_str()));
+
+  EXPECT_EQ(FindOrDefault(m, k1), 1);
+  EXPECT_EQ(FindOrDefault(m, k2.c_str()), 2);
+  EXPECT_EQ(s.count(k1.c_str()), 1U);
+
+#if defined(__cpp_lib_generic_unordered_lookup)
+  const std::string_view sv2{k2};
+  const std::string_view missing{k2.data(), 63};
+  auto before = test::Allocations();
+  EXPECT_EQ(FindOrDefault(m, std::string_view(k1)), 1);
+  EXPECT_EQ(FindOrDefault(m, sv2), 2);
+  EXPECT_EQ(FindPtr(m, missing), nullptr);
+  EXPECT_EQ(FindPtr(m, k2.c_str()), FindPtr(m, k2));
+  EXPECT_EQ(s.count(std::string_view(k1)), 1U);
+  EXPECT_EQ(s.count(sv2), 0U);
+  EXPECT_EQ(test::Allocations(), before);
+#else
+  GTEST_SKIP() << "Transparent unordered lookup requires C++20.";
+#endif
+}
+
+}  // namespace
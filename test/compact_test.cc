@@ -0,0 +1,159 @@
+// Test for stable compaction.
+#include "nectar/compact.h"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nectar/cpp20.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+// Returns `n` values with a `rate` of them odd.
+template <typename T>
+std::vector<T> MakeValues(size_t n, double rate, uint64_t seed = 1) {
+  std::mt19937_64 rng(seed);
+  std::bernoulli_distribution odd(rate);
+  std::vector<T> v;
+  for (size_t i = 0; i < n; ++i) v.push_back(static_cast<T>(i * 2 + odd(rng)));
+  return v;
+}
+
+template <typename T>
+std::vector<T> RemoveOdd(std::vector<T> v) {
+  auto odd = [](T e) { return int64_t(e) % 2; };
+  v.erase(std::remove_if(v.begin(), v.end(), odd), v.end());
+  return v;
+}
+
+// Runs kernel over `v` in place, for the mask of its even elements.
+template <typename T>
+std::vector<T> Compact(details::CompactFn fn, std::vector<T> v) {
+  std::vector<uint64_t> keep((v.size() + 63) / 64);
+  for (size_t i = 0; i < v.size(); ++i)
+    keep[i / 64] |= uint64_t{int64_t(v[i]) % 2 == 0} << (i % 64);
+  auto* p = reinterpret_cast<char*>(v.data());
+  v.resize(fn(p, p, keep.data(), v.size()));
+  return v;
+}
+
+// Every kernel this CPU supports matches std::remove_if, over sizes around
+// the vector widths and selectivities from none to all.
+template <typename T>
+void ExpectKernelsMatch(const std::vector<details::CompactFn>& fns) {
+  for (size_t n : {0, 1, 3, 4, 7, 8, 9, 15, 16, 17, 63, 64, 65, 200, 512}) {
+    for (double rate : {0.0, 0.1, 0.5, 0.9, 1.0}) {
+      auto v = MakeValues<T>(n, rate);
+      auto expected = RemoveOdd(v);
+      for (auto fn : fns) EXPECT_EQ(Compact(fn, v), expected) << n << rate;
+    }
+  }
+}
+
+TEST(CompactTest, Kernels) {
+  ExpectKernelsMatch<int32_t>({&details::CompactScalar<4>});
+  ExpectKernelsMatch<int64_t>({&details::CompactScalar<8>});
+  ExpectKernelsMatch<int16_t>({&details::CompactScalar<2>});
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    ExpectKernelsMatch<int32_t>({&details::Compact32Avx2});
+    ExpectKernelsMatch<int64_t>({&details::Compact64Avx2});
+    ExpectKernelsMatch<float>({&details::Compact32Avx2});
+    ExpectKernelsMatch<double>({&details::Compact64Avx2});
+  }
+  if (__builtin_cpu_supports("avx512f")) {
+    ExpectKernelsMatch<int32_t>({&details::Compact32Avx512});
+    ExpectKernelsMatch<int64_t>({&details::Compact64Avx512});
+  }
+#endif
+}
+
+TEST(CompactTest, EraseIf) {
+  for (size_t n : {0, 1, 100, 511, 512, 513, 5000}) {
+    for (double rate : {0.0, 0.01, 0.5, 1.0}) {
+      auto v = MakeValues<int64_t>(n, rate);
+      auto expected = RemoveOdd(v);
+      EXPECT_EQ(erase_if(v, [](int64_t e) { return e % 2; }),
+                n - expected.size());
+      EXPECT_EQ(v, expected);
+
+      auto w = MakeValues<uint8_t>(n, rate);
+      auto expected_w = RemoveOdd(w);
+      EXPECT_EQ(erase_if(w, [](uint8_t e) { return e % 2; }),
+                n - expected_w.size());
+      EXPECT_EQ(w, expected_w);
+    }
+  }
+}
+
+TEST(CompactTest, EraseIfStruct) {
+  struct Bid {
+    int32_t campaign;
+    double price;
+    bool operator==(const Bid& o) const {
+      return campaign == o.campaign && price == o.price;
+    }
+  };
+  std::vector<Bid> v;
+  for (int32_t i = 0; i < 1000; ++i) v.push_back({i, i * 0.5});
+  EXPECT_EQ(erase_if(v, [](const Bid& b) { return b.campaign % 3; }), 666U);
+  ASSERT_EQ(v.size(), 334U);
+  for (size_t i = 0; i < v.size(); ++i) EXPECT_EQ(v[i].campaign, i * 3);
+}
+
+// The predicate is called once per element, in order, as with remove_if.
+TEST(CompactTest, EraseIfCallsInOrder) {
+  std::vector<int32_t> v(1500);
+  for (size_t i = 0; i < v.size(); ++i) v[i] = i;
+  std::vector<int32_t> seen;
+  erase_if(v, [&](int32_t e) {
+    seen.push_back(e);
+    return e % 7 == 0;
+  });
+  ASSERT_EQ(seen.size(), 1500U);
+  for (size_t i = 0; i < seen.size(); ++i) EXPECT_EQ(seen[i], i);
+  EXPECT_EQ(v.size(), 1500U - 215);
+}
+
+TEST(CompactTest, EraseRowsIf) {
+  std::vector<int64_t> price;
+  std::vector<int32_t> campaign;
+  std::vector<std::string> creative;
+  for (int i = 0; i < 2000; ++i) {
+    price.push_back(i % 10);
+    campaign.push_back(i);
+    creative.push_back("creative-" + std::to_string(i));
+  }
+  EXPECT_EQ(
+      EraseRowsIf(price, [](int64_t p) { return p < 3; }, campaign, creative),
+      600U);
+  ASSERT_EQ(price.size(), 1400U);
+  ASSERT_EQ(campaign.size(), 1400U);
+  ASSERT_EQ(creative.size(), 1400U);
+  for (size_t i = 0; i < price.size(); ++i) {
+    EXPECT_GE(price[i], 3);
+    EXPECT_EQ(price[i], campaign[i] % 10);
+    EXPECT_EQ(creative[i], "creative-" + std::to_string(campaign[i]));
+  }
+  EXPECT_TRUE(std::is_sorted(campaign.begin(), campaign.end()));
+
+  EXPECT_EQ(EraseRowsIf(price, [](int64_t) { return false; }, campaign), 0U);
+  EXPECT_EQ(campaign.size(), 1400U);
+}
+
+TEST(CompactTest, EraseRowsIfSizeMismatch) {
+  std::vector<int64_t> a(10);
+  std::vector<int64_t> b(9);
+  EXPECT_THROW(EraseRowsIf(a, [](int64_t) { return true; }, b),
+               std::invalid_argument);
+  EXPECT_EQ(a.size(), 10U);
+  EXPECT_EQ(b.size(), 9U);
+}
+
+}  // namespace
@@ -0,0 +1,129 @@
+// Test for ConcurrentStringMap.
+#include "nectar/concurrent_map.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nectar/cstring_view.h"
+
+namespace {
+
+using std::literals::operator""sv;
+using namespace beeswax::nectar;  // NOLINT
+
+TEST(ConcurrentMapTest, Basics) {
+  ConcurrentStringMap<int> m;
+  EXPECT_EQ(m.shard_count(), ConcurrentStringMap<int>::kDefaultShards);
+  EXPECT_TRUE(m.empty());
+
+  EXPECT_TRUE(m.Upsert("abc"sv, 1));
+  EXPECT_FALSE(m.Upsert(std::string("abc"), 2));
+  EXPECT_TRUE(m.Upsert("def", 3));
+  EXPECT_EQ(m.size(), 2U);
+
+  EXPECT_EQ(m.Find("abc"_sz), 2);
+  EXPECT_EQ(m.Find("bbb"), std::nullopt);
+  EXPECT_TRUE(m.contains("def"sv));
+  EXPECT_FALSE(m.contains("ghi"sv));
+  EXPECT_EQ(m.FindOrDefault("def"), 3);
+  EXPECT_EQ(m.FindOrDefault("ghi"), 0);
+  EXPECT_EQ(m.FindOrDefault("ghi", -1), -1);
+
+  int seen = 0;
+  EXPECT_TRUE(m.Visit("abc", [&](const int& v) { seen = v; }));
+  EXPECT_EQ(seen, 2);
+  EXPECT_FALSE(m.Visit("ghi", [&](const int&) { seen = -1; }));
+  EXPECT_EQ(seen, 2);
+  EXPECT_TRUE(m.Update("abc", [](int& v) { v *= 10; }));
+  EXPECT_FALSE(m.Update("ghi", [](int& v) { v *= 10; }));
+  EXPECT_EQ(m.Find("abc"), 20);
+
+  EXPECT_EQ(m.DefaultValueCb("abc", [] { return 5; }), 20);
+  EXPECT_EQ(m.DefaultValueCb("ghi"sv, [] { return 5; }), 5);
+  EXPECT_EQ(m.Find("ghi"), 5);
+
+  auto bigger = m.WithMapKey("ghi", [](auto& mk) {
+    if (!mk || *mk < 7) mk.Assign(7);
+    return *mk;
+  });
+  EXPECT_EQ(bigger, 7);
+  m.WithMapKey("jkl", [](auto& mk) { *mk += 4; });
+  EXPECT_EQ(m.Find("jkl"), 4);
+
+  // Keys that carry their hash find the same shard.
+  EXPECT_TRUE(m.Upsert(HashedStringView("mno"), 6));
+  EXPECT_EQ(m.Find("mno"sv), 6);
+  EXPECT_EQ(m.Find(HashedStringView("jkl")), 4);
+  EXPECT_EQ(m.erase(HashedStringView("mno")), 1U);
+
+  EXPECT_EQ(m.erase("jkl"), 1U);
+  EXPECT_EQ(m.erase("jkl"), 0U);
+  EXPECT_EQ(m.size(), 3U);
+  m.clear();
+  EXPECT_TRUE(m.empty());
+}
+
+TEST(ConcurrentMapTest, Shards) {
+  EXPECT_EQ(ConcurrentStringMap<int>(1).shard_count(), 1U);
+  EXPECT_EQ(ConcurrentStringMap<int>(0).shard_count(), 1U);
+  EXPECT_EQ(ConcurrentStringMap<int>(5).shard_count(), 8U);
+
+  ConcurrentStringMap<int> m(16);
+  for (int i = 0; i < 1000; ++i) m.Upsert(std::to_string(i), i);
+
+  // Every entry is in exactly one shard, and they're spread out.
+  size_t total = 0;
+  size_t shards = 0;
+  std::vector<bool> seen(1000);
+  const auto& km = m;
+  km.ForEachShard([&](const auto& shard) {
+    total += shard.size();
+    shards += !shard.empty();
+    for (const auto& [k, v] : shard) {
+      EXPECT_EQ(k, std::to_string(v));
+      EXPECT_FALSE(seen[v]);
+      seen[v] = true;
+    }
+  });
+  EXPECT_EQ(total, 1000U);
+  EXPECT_EQ(shards, 16U);
+
+  m.ForEachShard([](auto& shard) {
+    for (auto& kv : shard) kv.second = -kv.second;
+  });
+  EXPECT_EQ(m.Find("999"), -999);
+}
+
+TEST(ConcurrentMapTest, Threads) {
+  constexpr int kThreads = 8;
+  constexpr int kKeys = 1000;
+  ConcurrentStringMap<int> m;
+  std::atomic<int> calls{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < kKeys; ++i) {
+        auto key = std::to_string(i);
+        // The callback only runs once per key, however many threads race.
+        auto v = m.DefaultValueCb(key, [&] {
+          ++calls;
+          return i;
+        });
+        EXPECT_EQ(v % kKeys, i);
+        m.WithMapKey("count"sv, [](auto& mk) { ++*mk; });
+        m.Update(key, [&](int& v) { v += kKeys; });
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  EXPECT_EQ(calls, kKeys);
+  EXPECT_EQ(m.Find("count"), kThreads * kKeys);
+  EXPECT_EQ(m.size(), kKeys + 1U);
+  for (int i = 0; i < kKeys; ++i)
+    EXPECT_EQ(m.Find(std::to_string(i)), i + kThreads * kKeys);
+}
+
+}  // namespace
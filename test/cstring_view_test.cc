@@ -5,6 +5,8 @@
 #include <memory>
 #include <set>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -111,4 +113,50 @@ TEST(CstringviewTest, Hashable) {
   }
 }
 
+TEST(CstringviewTest, ToCString) {
+  using beeswax::nectar::cstring_view;
+  using beeswax::nectar::ToCString;
+  using beeswax::nectar::TerminatedCopy;
+
+  // Slices are copied inline.
+  std::string_view path = "/etc/hosts:/etc/passwd";
+  auto hosts = ToCString(path.substr(0, 10));
+  EXPECT_STREQ(hosts.c_str(), "/etc/hosts");
+  EXPECT_EQ(hosts.size(), 10U);
+  EXPECT_NE(hosts.c_str(), path.data());
+  auto inline_begin = reinterpret_cast<const char*>(&hosts);
+  EXPECT_GE(hosts.c_str(), inline_begin);
+  EXPECT_LT(hosts.c_str(), inline_begin + sizeof(hosts));
+  cstring_view view = hosts;
+  EXPECT_EQ(view, "/etc/hosts");
+
+  // Long ones go to the heap.
+  std::string long_str(1000, 'x');
+  auto copy = ToCString(std::string_view(long_str).substr(0, 999));
+  EXPECT_EQ(copy.view(), std::string(999, 'x'));
+  auto copy_begin = reinterpret_cast<const char*>(&copy);
+  EXPECT_TRUE(copy.c_str() < copy_begin ||
+              copy.c_str() >= copy_begin + sizeof(copy));
+  EXPECT_EQ(ToCString(std::string_view(long_str).substr(0, 255)).size(), 255U);
+  EXPECT_EQ(ToCString(std::string_view(long_str).substr(0, 256)).size(), 256U);
+
+  // Terminated strings aren't copied.
+  EXPECT_EQ(ToCString(long_str).c_str(), long_str.c_str());
+  const char* literal = "literal";
+  EXPECT_EQ(ToCString(literal).c_str(), literal);
+  EXPECT_EQ(ToCString(literal).size(), 7U);
+  cstring_view cs = long_str;
+  EXPECT_EQ(ToCString(cs).c_str(), long_str.c_str());
+
+  // Temporaries are copied, since the result may outlive them.
+  auto make_path = [] { return std::string("/var/log/syslog"); };
+  auto path_copy = ToCString(make_path());
+  EXPECT_STREQ(path_copy.c_str(), "/var/log/syslog");
+  auto long_copy = ToCString(std::string(long_str));
+  EXPECT_EQ(long_copy.view(), long_str);
+  EXPECT_NE(long_copy.c_str(), long_str.c_str());
+
+  EXPECT_STREQ(ToCString(std::string_view()).c_str(), "");
+}
+
 }  // namespace
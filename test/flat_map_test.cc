@@ -0,0 +1,190 @@
+// Test for StringFlatMap.
+#include "nectar/flat_map.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nectar/cpp20.h"
+#include "nectar/cstring_view.h"
+
+namespace {
+
+using std::literals::operator""sv;
+using namespace beeswax::nectar;  // NOLINT
+
+class FlatMapTest : public ::testing::Test {
+ public:
+  StringFlatMap<int> dict{{"def", 2}, {"abc", 1}, {"ghi", 3}, {"abc", 9}};
+};
+
+TEST_F(FlatMapTest, ConstructsSorted) {
+  ASSERT_EQ(dict.size(), 3U);
+  EXPECT_EQ(dict.keys(), (std::vector<std::string>{"abc", "def", "ghi"}));
+  // First duplicate wins, as with std::map.
+  EXPECT_EQ(dict.values(), (std::vector<int>{1, 2, 3}));
+
+  std::vector<std::string> keys;
+  for (const auto& kv : dict) keys.push_back(kv.first);
+  EXPECT_EQ(keys, dict.keys());
+}
+
+TEST_F(FlatMapTest, TransparentLookup) {
+  static const std::string k1{"abc"};
+  constexpr auto k2{"def"sv};
+  constexpr char k3[] = "ghi";
+  auto k4 = "ghi"_sz;
+
+  auto it = dict.find(k1);
+  ASSERT_NE(it, dict.end());
+  EXPECT_EQ(it->second, 1);
+  it = dict.find(k2);
+  ASSERT_NE(it, dict.end());
+  EXPECT_EQ(it->second, 2);
+  it = dict.find(k3);
+  ASSERT_NE(it, dict.end());
+  EXPECT_EQ(it->second, 3);
+  it = dict.find(k4);
+  ASSERT_NE(it, dict.end());
+  EXPECT_EQ((*it).first, "ghi");
+
+  EXPECT_EQ(dict.find("bbb"), dict.end());
+  EXPECT_EQ(dict.find(""), dict.end());
+  EXPECT_EQ(dict.find("zzz"), dict.end());
+  EXPECT_TRUE(contains(dict, "abc"sv));
+  EXPECT_FALSE(contains(dict, "abcd"sv));
+  EXPECT_EQ(dict.count("def"), 1U);
+  EXPECT_EQ(dict.at("def"), 2);
+  EXPECT_THROW(dict.at("zzz"), std::out_of_range);
+}
+
+TEST_F(FlatMapTest, FindPtrAndDefault) {
+  auto v = FindPtr(dict, "abc"sv);
+  ASSERT_NE(v, nullptr);
+  *v = 5;
+  EXPECT_EQ(dict.at("abc"), 5);
+  EXPECT_EQ(FindPtr(dict, "bbb"), nullptr);
+
+  const auto& kdict = dict;
+  const int* cv = FindPtr(kdict, "def");
+  ASSERT_NE(cv, nullptr);
+  EXPECT_EQ(*cv, 2);
+
+  EXPECT_EQ(FindOrDefault(kdict, "ghi"), 3);
+  EXPECT_EQ(FindOrDefault(kdict, "nope"), 0);
+  const int kSeven = 7;
+  EXPECT_EQ(FindOrDefault(kdict, "nope", kSeven), 7);
+  EXPECT_EQ(nosniff::FindOrDefaultCb(kdict, "nope", [] { return 8; }), 8);
+}
+
+TEST_F(FlatMapTest, FindPtrBatch) {
+  std::vector<std::string_view> keys{"ghi", "", "abc", "zzz", "def", "bbb"};
+  std::vector<int*> found(keys.size());
+  FindPtrBatch(dict, keys, found);
+  for (size_t i = 0; i < keys.size(); ++i)
+    EXPECT_EQ(found[i], FindPtr(dict, keys[i])) << keys[i];
+
+  const auto& kdict = dict;
+  std::vector<int> values(keys.size());
+  FindOrDefaultBatch(kdict, keys, values, -1);
+  EXPECT_EQ(values, (std::vector<int>{3, -1, 1, -1, 2, -1}));
+
+  const StringFlatMap<int> empty;
+  FindOrDefaultBatch(empty, keys, values);
+  EXPECT_EQ(values, std::vector<int>(keys.size()));
+
+  // Every size of map, so every depth of search, and more keys than a batch.
+  StringFlatMap<int> m;
+  std::vector<std::string> all;
+  for (int i = 0; i < 100; ++i) all.push_back(std::to_string(i));
+  values.resize(all.size());
+  for (int i = 0; i < 100; i += 2) {
+    m.try_emplace(all[i], i);
+    FindOrDefaultBatch(m, all, values, -1);
+    for (int j = 0; j < 100; ++j)
+      EXPECT_EQ(values[j], j <= i && j % 2 == 0 ? j : -1) << i << " " << j;
+  }
+}
+
+TEST_F(FlatMapTest, InsertAndErase) {
+  auto [it, inserted] = dict.try_emplace("bbb"sv, 4);
+  EXPECT_TRUE(inserted);
+  EXPECT_EQ(it->first, "bbb");
+  EXPECT_EQ(dict.keys(),
+            (std::vector<std::string>{"abc", "bbb", "def", "ghi"}));
+  EXPECT_EQ(dict.values(), (std::vector<int>{1, 4, 2, 3}));
+
+  std::tie(it, inserted) = dict.try_emplace("bbb", 6);
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(it->second, 4);
+
+  std::tie(it, inserted) = dict.insert_or_assign("bbb", 6);
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(it->second, 6);
+
+  dict["zzz"] = 26;
+  EXPECT_EQ(dict.keys().back(), "zzz");
+  EXPECT_EQ(dict["zzz"], 26);
+
+  // A wrong hint still inserts in the right place.
+  it = dict.insert_or_assign(dict.begin(), "yyy", 25);
+  EXPECT_EQ(it->first, "yyy");
+  EXPECT_EQ(
+      dict.keys(),
+      (std::vector<std::string>{"abc", "bbb", "def", "ghi", "yyy", "zzz"}));
+
+  EXPECT_EQ(dict.erase("bbb"), 1U);
+  EXPECT_EQ(dict.erase("bbb"), 0U);
+  it = dict.erase(dict.find("def"));
+  EXPECT_EQ(it->first, "ghi");
+  dict.erase(dict.find("yyy"), dict.end());
+  EXPECT_EQ(dict.keys(), (std::vector<std::string>{"abc", "ghi"}));
+  EXPECT_EQ(dict.values(), (std::vector<int>{1, 3}));
+}
+
+TEST_F(FlatMapTest, MapKey) {
+  auto mk = MakeMapKey(dict, "bbb"sv);
+  EXPECT_FALSE(mk);
+  EXPECT_EQ(mk.get(), nullptr);
+  EXPECT_TRUE(mk.Assign(4));
+  EXPECT_TRUE(mk);
+  EXPECT_EQ(*mk, 4);
+  EXPECT_EQ(dict.at("bbb"), 4);
+
+  auto mk2 = MakeMapKey(dict, std::string("def"));
+  EXPECT_TRUE(mk2);
+  EXPECT_FALSE(mk2.Assign(7));
+  EXPECT_EQ(dict.at("def"), 7);
+
+  EXPECT_EQ(MakeMapKey(dict, "ccc").DefaultValue(), 0);
+  EXPECT_EQ(MakeMapKey(dict, "ddd").DefaultValueCb([] { return 9; }), 9);
+  EXPECT_EQ(MakeMapKey(dict, "ddd").DefaultValueCb([] { return 10; }), 9);
+  EXPECT_EQ(MakeMapKey(dict, "eee").DefaultValueEmplace(11), 11);
+  EXPECT_EQ(dict.keys(),
+            (std::vector<std::string>{
+                "abc", "bbb", "ccc", "ddd", "def", "eee", "ghi"}));
+}
+
+TEST_F(FlatMapTest, SameAsStringMap) {
+  // Switching is just a matter of changing the type.
+  StringMap<int> tree{{"def", 2}, {"abc", 1}, {"ghi", 3}};
+  ASSERT_EQ(tree.size(), dict.size());
+  auto it = tree.begin();
+  for (const auto& kv : dict) {
+    EXPECT_EQ(kv.first, it->first);
+    EXPECT_EQ(kv.second, it->second);
+    ++it;
+  }
+}
+
+TEST_F(FlatMapTest, RetainAndEraseKeys) {
+  StringFlatMap<int> m{{"a", 1}, {"b", 2}, {"c", 3}, {"d", 4}, {"e", 5},
+                       {"f", 6}};
+  EXPECT_EQ(RetainKeys(m, std::vector<std::string_view>{"a", "e", "f"}), 3U);
+  EXPECT_EQ(m.keys(), (std::vector<std::string>{"a", "e", "f"}));
+  EXPECT_EQ(EraseKeys(m, StringUnorderedSet<>{"e", "f", "z"}), 2U);
+  EXPECT_EQ(m.keys(), (std::vector<std::string>{"a"}));
+  EXPECT_EQ(m.at("a"), 1);
+}
+
+}  // namespace
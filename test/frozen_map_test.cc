@@ -0,0 +1,101 @@
+#include "nectar/frozen_map.h"
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "nectar/collections.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+enum class Method { kUnknown, kGet, kHead, kPost, kPut, kDelete };
+
+constexpr auto kMethods = MakeFrozenMap<Method>({
+    {"GET"_sz, Method::kGet},
+    {"HEAD"_sz, Method::kHead},
+    {"POST"_sz, Method::kPost},
+    {"PUT"_sz, Method::kPut},
+    {"DELETE"_sz, Method::kDelete},
+});
+
+// Lookups work at compile time too.
+static_assert(kMethods.size() == 5);
+static_assert(kMethods.at("POST") == Method::kPost);
+static_assert(!kMethods.contains("PATCH"));
+static_assert(kMethods.at("PUT"_hashed) == Method::kPut);
+
+TEST(FrozenMapTest, Find) {
+  EXPECT_EQ(kMethods.find("GET")->second, Method::kGet);
+  EXPECT_EQ(kMethods.find(std::string("PUT"))->second, Method::kPut);
+  EXPECT_EQ(kMethods.find("get"), kMethods.end());
+  EXPECT_EQ(kMethods.find(""), kMethods.end());
+  EXPECT_EQ(kMethods.count("HEAD"_sz), 1U);
+  EXPECT_EQ(kMethods.count(std::string_view("HEADER", 4)), 1U);
+  EXPECT_EQ(kMethods.at("DELETE"), Method::kDelete);
+  EXPECT_THROW(kMethods.at("PATCH"), std::out_of_range);
+  const std::string del = "DELETE";
+  EXPECT_EQ(kMethods.find(HashedStringView(del))->second, Method::kDelete);
+
+  // Keys keep their termination.
+  EXPECT_STREQ(kMethods.find("POST")->first.c_str(), "POST");
+
+  // Iteration is in the order given.
+  std::string order;
+  for (auto& [k, v] : kMethods) order += k;
+  EXPECT_EQ(order, "GETHEADPOSTPUTDELETE");
+}
+
+TEST(FrozenMapTest, Helpers) {
+  EXPECT_EQ(*FindPtr(kMethods, "HEAD"), Method::kHead);
+  EXPECT_EQ(FindPtr(kMethods, "TRACE"), nullptr);
+  EXPECT_EQ(FindOrDefault(kMethods, "PUT"), Method::kPut);
+  EXPECT_EQ(FindOrDefault(kMethods, "TRACE"), Method::kUnknown);
+  EXPECT_EQ(FindOrDefault(kMethods, "TRACE", Method::kGet), Method::kGet);
+}
+
+TEST(FrozenMapTest, StringViewKeys) {
+  constexpr auto kCodes = MakeFrozenMap<int, std::string_view>({
+      {"us", 840},
+      {"ca", 124},
+      {"mx", 484},
+  });
+  EXPECT_EQ(FindOrDefault(kCodes, "ca"), 124);
+  EXPECT_EQ(FindOrDefault(kCodes, "uk"), 0);
+
+  constexpr auto kOne = MakeFrozenMap<int>({{"one", 1}});
+  EXPECT_EQ(FindOrDefault(kOne, "one"), 1);
+  EXPECT_EQ(FindOrDefault(kOne, "two"), 0);
+}
+
+// Enough keys to exercise buckets with several members.
+#define NECTAR_KEYS(X)                                                     \
+  X(a0) X(a1) X(a2) X(a3) X(a4) X(a5) X(a6) X(a7) X(a8) X(a9) X(b0) X(b1) \
+  X(b2) X(b3) X(b4) X(b5) X(b6) X(b7) X(b8) X(b9) X(c0) X(c1) X(c2) X(c3) \
+  X(c4) X(c5) X(c6) X(c7) X(c8) X(c9) X(d0) X(d1) X(d2) X(d3) X(d4) X(d5) \
+  X(d6) X(d7) X(d8) X(d9) X(e0) X(e1) X(e2) X(e3) X(e4) X(e5) X(e6) X(e7) \
+  X(e8) X(e9) X(f0) X(f1) X(f2) X(f3) X(f4) X(f5) X(f6) X(f7) X(f8) X(f9) \
+  X(g0) X(g1) X(g2) X(g3) X(g4) X(g5) X(g6) X(g7) X(g8) X(g9) X(h0) X(h1) \
+  X(h2) X(h3) X(h4) X(h5) X(h6) X(h7) X(h8) X(h9) X(i0) X(i1) X(i2) X(i3) \
+  X(i4) X(i5) X(i6) X(i7) X(i8) X(i9) X(j0) X(j1) X(j2) X(j3) X(j4) X(j5) \
+  X(j6) X(j7) X(j8) X(j9)
+#define NECTAR_KEY(k) #k "_key",
+
+TEST(FrozenSetTest, Set) {
+  constexpr auto kHopByHop =
+      MakeFrozenSet({"connection"_sz, "keep-alive"_sz, "te"_sz, "upgrade"_sz});
+  static_assert(kHopByHop.contains("te"));
+  EXPECT_TRUE(kHopByHop.contains("upgrade"));
+  EXPECT_FALSE(kHopByHop.contains("host"));
+  EXPECT_STREQ(kHopByHop.find("connection")->c_str(), "connection");
+
+  constexpr auto kMany = MakeFrozenSet({NECTAR_KEYS(NECTAR_KEY)});
+  EXPECT_EQ(kMany.size(), 100U);
+  for (auto& key : kMany) {
+    EXPECT_EQ(kMany.find(key), &key);
+    EXPECT_EQ(kMany.count(std::string(key)), 1U);
+    EXPECT_FALSE(kMany.contains(std::string(key) + "x"));
+  }
+}
+
+}  // namespace
@@ -0,0 +1,217 @@
+// Test for PersistentStringMap and AtomicPersistentStringMap.
+#include "nectar/hamt_map.h"
+#include <atomic>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nectar/cpp20.h"
+#include "nectar/cstring_view.h"
+
+namespace {
+
+using std::literals::operator""sv;
+using namespace beeswax::nectar;  // NOLINT
+
+// Checks that the map has exactly the expected entries, by lookup and by
+// iteration.
+template <typename V, typename Hash>
+void ExpectSame(const PersistentStringMap<V, Hash>& m,
+                const std::map<std::string, V>& expected) {
+  ASSERT_EQ(m.size(), expected.size());
+  for (const auto& [k, v] : expected) {
+    auto p = FindPtr(m, k);
+    ASSERT_NE(p, nullptr) << k;
+    EXPECT_EQ(*p, v);
+  }
+  std::map<std::string, V> seen(m.begin(), m.end());
+  EXPECT_EQ(seen, expected);
+}
+
+TEST(HamtMapTest, Basics) {
+  const PersistentStringMap<int> empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(empty.begin(), empty.end());
+  EXPECT_EQ(FindPtr(empty, "abc"), nullptr);
+
+  PersistentStringMap<int> v1{{"abc", 1}, {"def", 2}, {"abc", 9}};
+  auto v2 = v1.Set("ghi"sv, 3);
+  auto v3 = v2.Set(std::string("abc"), 4);
+  auto v4 = v3.Erase("def"_sz);
+
+  ExpectSame(v1, {{"abc", 1}, {"def", 2}});
+  ExpectSame(v2, {{"abc", 1}, {"def", 2}, {"ghi", 3}});
+  ExpectSame(v3, {{"abc", 4}, {"def", 2}, {"ghi", 3}});
+  ExpectSame(v4, {{"abc", 4}, {"ghi", 3}});
+
+  // Transparent lookup.
+  EXPECT_EQ(FindOrDefault(v4, "abc"sv), 4);
+  EXPECT_EQ(FindOrDefault(v4, "abc"_sz), 4);
+  EXPECT_EQ(FindOrDefault(v4, "def"), 0);
+  EXPECT_TRUE(contains(v4, "ghi"sv));
+  EXPECT_EQ(v4.count("def"), 0U);
+  EXPECT_EQ(v4.at("ghi"), 3);
+  EXPECT_THROW(v4.at("def"), std::out_of_range);
+
+  // Erasing a missing key changes nothing.
+  auto v5 = v4.Erase("zzz");
+  EXPECT_TRUE(v5.SameVersion(v4));
+  EXPECT_FALSE(v5.SameVersion(v3));
+  EXPECT_TRUE(v4.Erase("abc").Erase("ghi").empty());
+}
+
+TEST(HamtMapTest, MatchesStdMap) {
+  // Random changes, keeping every version, checked against std::map.
+  std::mt19937 rng(42);
+  std::vector<PersistentStringMap<int>> versions(1);
+  std::vector<std::map<std::string, int>> expected(1);
+  for (int i = 0; i < 20000; ++i) {
+    if (i % 1000 == 0) {
+      versions.push_back(versions.back());
+      expected.push_back(expected.back());
+    }
+    auto key = std::to_string(rng() % 3000);
+    if (rng() % 4) {
+      versions.back() = versions.back().Set(key, i);
+      expected.back()[key] = i;
+    } else {
+      versions.back() = versions.back().Erase(key);
+      expected.back().erase(key);
+    }
+  }
+  for (size_t i = 0; i < versions.size(); ++i)
+    ExpectSame(versions[i], expected[i]);
+
+  // Erasing everything leaves an empty map.
+  auto m = versions.back();
+  for (const auto& [k, v] : expected.back()) m = m.Erase(k);
+  EXPECT_TRUE(m.empty());
+  EXPECT_EQ(m.begin(), m.end());
+}
+
+TEST(HamtMapTest, Iterator) {
+  PersistentStringMap<int> m;
+  for (int i = 0; i < 1000; ++i) m = m.Set(std::to_string(i), i);
+
+  // Iterating from a found entry visits the rest.
+  auto it = m.find("500");
+  ASSERT_NE(it, m.end());
+  EXPECT_EQ(it->second, 500);
+  size_t after = 0;
+  for (; it != m.end(); ++it) ++after;
+  size_t before = 0;
+  for (auto i = m.begin(); i != m.find("500"); ++i) ++before;
+  EXPECT_EQ(before + after, 1000U);
+}
+
+// Spreads keys over three hashes, which differ only in their top two bits. So
+// keys take the trie's full depth before they part, and most then share a
+// collision node with others of the same hash.
+struct CollidingHash {
+  template <typename K>
+  size_t operator()(const K& k) const {
+    return static_cast<uint64_t>(StringHash{}(k) % 3) << 62;
+  }
+};
+
+TEST(HamtMapTest, Collisions) {
+  using CollidingMap = PersistentStringMap<int, CollidingHash>;
+  CollidingMap v1{{"a", 1}, {"b", 2}, {"c", 3}, {"d", 4}, {"e", 5}};
+  auto v2 = v1.Set("a"sv, 10).Set("f", 6);
+  auto v3 = v2.Erase("b").Erase("zzz");
+  ExpectSame(v1, {{"a", 1}, {"b", 2}, {"c", 3}, {"d", 4}, {"e", 5}});
+  ExpectSame(v2, {{"a", 10}, {"b", 2}, {"c", 3}, {"d", 4}, {"e", 5}, {"f", 6}});
+  ExpectSame(v3, {{"a", 10}, {"c", 3}, {"d", 4}, {"e", 5}, {"f", 6}});
+  EXPECT_TRUE(v3.Erase("zzz").SameVersion(v3));
+
+  // Iterating on from an entry found in a collision node.
+  size_t after = 0;
+  for (auto it = v3.find("e"_sz); it != v3.end(); ++it) ++after;
+  size_t before = 0;
+  for (auto it = v3.begin(); it != v3.find("e"); ++it) ++before;
+  EXPECT_EQ(before + after, 5U);
+
+  // Random changes, as in MatchesStdMap. Erasing all but one key of a hash
+  // folds it back up the trie, so the last key is still found.
+  std::mt19937 rng(7);
+  CollidingMap m;
+  std::map<std::string, int> expected;
+  for (int i = 0; i < 3000; ++i) {
+    auto key = std::to_string(rng() % 60);
+    if (rng() % 3) {
+      m = m.Set(key, i);
+      expected[key] = i;
+    } else {
+      m = m.Erase(key);
+      expected.erase(key);
+    }
+    if (i % 100 == 0) ExpectSame(m, expected);
+  }
+  ExpectSame(m, expected);
+  while (!expected.empty()) {
+    m = m.Erase(expected.begin()->first);
+    expected.erase(expected.begin());
+    ExpectSame(m, expected);
+  }
+  EXPECT_TRUE(m.empty());
+  EXPECT_EQ(m.begin(), m.end());
+}
+
+TEST(HamtMapTest, Atomic) {
+  AtomicPersistentStringMap<int> table;
+  EXPECT_TRUE(table.Load()->empty());
+
+  auto before = table.Load();
+  table.Update([](const auto& m) { return m.Set("abc", 1); });
+  EXPECT_TRUE(before->empty());
+  EXPECT_EQ(FindOrDefault(*table.Load(), "abc"), 1);
+
+  AtomicPersistentStringMap<int>::Reader reader(table);
+  EXPECT_EQ(FindOrDefault(reader.Get(), "abc"), 1);
+  const auto* cached = &reader.Get();
+  EXPECT_EQ(&reader.Get(), cached);
+  table.Store(PersistentStringMap<int>{{"def", 2}});
+  EXPECT_EQ(FindOrDefault(reader.Get(), "abc"), 0);
+  EXPECT_EQ(FindOrDefault(reader.Get(), "def"), 2);
+}
+
+TEST(HamtMapTest, AtomicThreads) {
+  // Writers add keys while readers check that each snapshot is consistent:
+  // every key below its size is there.
+  constexpr int kWriters = 2;
+  constexpr int kKeys = 2000;
+  AtomicPersistentStringMap<int> table;
+  std::atomic<bool> done{false};
+  std::atomic<int> next{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      AtomicPersistentStringMap<int>::Reader reader(table);
+      while (!done) {
+        const auto& m = reader.Get();
+        for (int i = 0; i < static_cast<int>(m.size()); i += 97)
+          ASSERT_EQ(FindOrDefault(m, std::to_string(i), -1), i);
+      }
+    });
+  }
+  for (int t = 0; t < kWriters; ++t) {
+    threads.emplace_back([&] {
+      while (next++ < kKeys) {
+        table.Update([&](const auto& m) {
+          // Keys are added in order, since updates are serialized.
+          auto key = static_cast<int>(m.size());
+          return m.Set(std::to_string(key), key);
+        });
+      }
+    });
+  }
+  for (int t = 4; t < 4 + kWriters; ++t) threads[t].join();
+  done = true;
+  for (int t = 0; t < 4; ++t) threads[t].join();
+  EXPECT_EQ(table.Load()->size(), static_cast<size_t>(kKeys));
+}
+
+}  // namespace
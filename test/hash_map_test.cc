@@ -0,0 +1,310 @@
+// Test for FlatHashMap and StringHashMap.
+#include "nectar/hash_map.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nectar/cpp20.h"
+#include "nectar/cstring_view.h"
+#include "test/alloc_counter.h"
+
+namespace {
+
+using std::literals::operator""sv;
+using namespace beeswax::nectar;  // NOLINT
+
+class HashMapTest : public ::testing::Test {
+ public:
+  StringHashMap<int> dict{{"abc", 1}, {"def", 2}, {"abc", 9}};
+};
+
+TEST_F(HashMapTest, HeterogeneousLookup) {
+  ASSERT_EQ(dict.size(), 2U);
+
+  static const std::string k1{"abc"};
+  auto it = dict.find(k1);
+  ASSERT_NE(it, dict.end());
+  EXPECT_EQ(it->first, "abc");
+  EXPECT_EQ(it->second, 1);
+
+  it = dict.find("def"sv);
+  ASSERT_NE(it, dict.end());
+  EXPECT_EQ(it->second, 2);
+
+  constexpr char k3[] = "def";
+  EXPECT_NE(dict.find(k3), dict.end());
+  const char* k4 = "abc";
+  EXPECT_NE(dict.find(k4), dict.end());
+  EXPECT_NE(dict.find("abc"_sz), dict.end());
+
+  EXPECT_EQ(dict.find("bbb"), dict.end());
+  EXPECT_EQ(dict.find(""), dict.end());
+  EXPECT_TRUE(dict.contains("abc"));
+  EXPECT_TRUE(contains(dict, "def"sv));
+  EXPECT_FALSE(contains(dict, "ghi"sv));
+  EXPECT_EQ(dict.count("def"), 1U);
+  EXPECT_EQ(dict.at("def"), 2);
+  EXPECT_THROW(dict.at("zzz"), std::out_of_range);
+}
+
+TEST_F(HashMapTest, HashedLookup) {
+  const std::string abc = "abc";
+  const HashedStringView key(abc);
+  StringHashMap<int> other{{"abc", 3}};
+  EXPECT_EQ(FindOrDefault(dict, key), 1);
+  EXPECT_EQ(FindOrDefault(other, key), 3);
+  EXPECT_EQ(StringHash{}(key), StringHash{}(abc));
+  EXPECT_TRUE(dict.contains("def"_hashed));
+  EXPECT_FALSE(dict.contains("ghi"_hashed));
+  dict.erase(key);
+  EXPECT_FALSE(dict.contains(abc));
+
+#ifndef NDEBUG
+  // A wrong hash is caught in debug builds.
+  const HashedStringView wrong(abc, Hash64("def"));
+  EXPECT_DEATH(dict.find(wrong), "hash");
+#endif
+}
+
+TEST_F(HashMapTest, FindPtrAndDefault) {
+  auto v = FindPtr(dict, "abc"sv);
+  ASSERT_NE(v, nullptr);
+  *v = 5;
+  EXPECT_EQ(dict.at("abc"), 5);
+  EXPECT_EQ(FindPtr(dict, "bbb"), nullptr);
+
+  const auto& kdict = dict;
+  const int* cv = FindPtr(kdict, "def"_sz);
+  ASSERT_NE(cv, nullptr);
+  EXPECT_EQ(*cv, 2);
+
+  EXPECT_EQ(FindOrDefault(kdict, "def"), 2);
+  EXPECT_EQ(FindOrDefault(kdict, "nope"), 0);
+  const int kSeven = 7;
+  EXPECT_EQ(FindOrDefault(kdict, "nope", kSeven), 7);
+  EXPECT_EQ(nosniff::FindOrDefaultCb(kdict, "nope", [] { return 8; }), 8);
+}
+
+TEST_F(HashMapTest, MapKey) {
+  auto mk = MakeMapKey(dict, "bbb"sv);
+  EXPECT_FALSE(mk);
+  EXPECT_EQ(mk.get(), nullptr);
+  EXPECT_TRUE(mk.Assign(4));
+  EXPECT_TRUE(mk);
+  EXPECT_EQ(*mk, 4);
+  EXPECT_EQ(dict.at("bbb"), 4);
+
+  auto mk2 = MakeMapKey(dict, "def");
+  EXPECT_TRUE(mk2);
+  EXPECT_FALSE(mk2.Assign(7));
+  EXPECT_EQ(dict.at("def"), 7);
+
+  EXPECT_EQ(MakeMapKey(dict, "ccc").DefaultValue(), 0);
+  EXPECT_EQ(MakeMapKey(dict, "ddd").DefaultValueCb([] { return 9; }), 9);
+  EXPECT_EQ(MakeMapKey(dict, "ddd").DefaultValueCb([] { return 10; }), 9);
+  EXPECT_EQ(MakeMapKey(dict, "eee").DefaultValueEmplace(11), 11);
+  EXPECT_EQ(dict.size(), 6U);
+}
+
+TEST_F(HashMapTest, InsertAndErase) {
+  auto [it, inserted] = dict.try_emplace("bbb"sv, 4);
+  EXPECT_TRUE(inserted);
+  EXPECT_EQ(it->first, "bbb");
+  std::tie(it, inserted) = dict.try_emplace("bbb", 6);
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(it->second, 4);
+  std::tie(it, inserted) = dict.insert_or_assign("bbb", 6);
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(it->second, 6);
+  dict["zzz"] = 26;
+  EXPECT_EQ(dict["zzz"], 26);
+  EXPECT_EQ(dict.size(), 4U);
+
+  EXPECT_EQ(dict.erase("bbb"), 1U);
+  EXPECT_EQ(dict.erase("bbb"), 0U);
+  EXPECT_EQ(dict.size(), 3U);
+  for (auto i = dict.begin(); i != dict.end();) {
+    if (i->second > 1)
+      i = dict.erase(i);
+    else
+      ++i;
+  }
+  EXPECT_EQ(dict.size(), 1U);
+  EXPECT_EQ(dict.begin()->first, "abc");
+
+  dict.clear();
+  EXPECT_TRUE(dict.empty());
+  EXPECT_EQ(dict.begin(), dict.end());
+  EXPECT_EQ(dict.find("abc"), dict.end());
+}
+
+TEST(HashMapBasicTest, Empty) {
+  StringHashMap<int> m;
+  EXPECT_TRUE(m.empty());
+  EXPECT_EQ(m.capacity(), 0U);
+  EXPECT_EQ(m.begin(), m.end());
+  EXPECT_EQ(m.find("a"), m.end());
+  EXPECT_EQ(m.erase("a"), 0U);
+  m.clear();
+  StringHashMap<int> moved(std::move(m));
+  EXPECT_TRUE(moved.empty());
+}
+
+TEST(HashMapBasicTest, GrowsAndMatchesStd) {
+  // Random inserts and erases, checked against std::unordered_map.
+  std::mt19937 rng(42);
+  StringHashMap<int> m;
+  std::unordered_map<std::string, int> expected;
+  for (int i = 0; i < 200000; ++i) {
+    auto key = std::to_string(rng() % 5000);
+    if (rng() % 3) {
+      m[key] = i;
+      expected[key] = i;
+    } else {
+      EXPECT_EQ(m.erase(key), expected.erase(key));
+    }
+  }
+  ASSERT_EQ(m.size(), expected.size());
+  size_t seen = 0;
+  for (const auto& [k, v] : m) {
+    ++seen;
+    auto p = FindPtr(expected, k);
+    ASSERT_NE(p, nullptr);
+    EXPECT_EQ(*p, v);
+  }
+  EXPECT_EQ(seen, expected.size());
+  for (const auto& [k, v] : expected) EXPECT_EQ(FindOrDefault(m, k, -1), v);
+
+  m.reserve(100000);
+  EXPECT_GE(m.capacity(), 100000U);
+  EXPECT_EQ(m.size(), expected.size());
+}
+
+TEST(HashMapBasicTest, CopyAndMove) {
+  StringHashMap<std::string> m;
+  for (int i = 0; i < 100; ++i)
+    m.try_emplace(std::to_string(i), std::string(50, 'a' + i % 26));
+
+  auto copy = m;
+  EXPECT_EQ(copy.size(), 100U);
+  EXPECT_EQ(copy.at("27"), std::string(50, 'b'));
+  copy.at("27") = "changed";
+  EXPECT_EQ(m.at("27"), std::string(50, 'b'));
+
+  auto moved = std::move(copy);
+  EXPECT_EQ(moved.size(), 100U);
+  EXPECT_EQ(moved.at("27"), "changed");
+
+  copy = moved;
+  EXPECT_EQ(copy.at("27"), "changed");
+  moved = std::move(m);
+  EXPECT_EQ(moved.at("27"), std::string(50, 'b'));
+}
+
+TEST(HashMapBasicTest, MoveOnlyValues) {
+  StringHashMap<std::unique_ptr<int>> m;
+  for (int i = 0; i < 1000; ++i)
+    m.try_emplace(std::to_string(i), std::make_unique<int>(i));
+  EXPECT_EQ(*m.at("999"), 999);
+  EXPECT_EQ(*DerefOrDefault(FindPtr(m, "500")), 500);
+}
+
+TEST(HashMapBasicTest, FindPtrBatch) {
+  FlatHashMap<int, int> m;
+  std::vector<int> keys{1, 2, 3};
+  std::vector<int> values(keys.size());
+  FindOrDefaultBatch(m, keys, values, -1);
+  EXPECT_EQ(values, (std::vector<int>{-1, -1, -1}));
+
+  // Big enough to be batched, with more keys than a batch, half of them
+  // present.
+  for (int i = 0; i < 600000; i += 2) m[i] = i * 2;
+  keys.clear();
+  for (int i = 999; i >= 0; --i) keys.push_back(i * 601);
+  std::vector<int*> found(keys.size());
+  FindPtrBatch(m, keys, found);
+  for (size_t i = 0; i < keys.size(); ++i)
+    EXPECT_EQ(found[i], FindPtr(m, keys[i])) << keys[i];
+
+  StringHashMap<int> strs{{"abc", 1}, {"def", 2}};
+  const auto& kstrs = strs;
+  const int* cfound[3];
+  FindPtrBatch(kstrs, std::vector<cstring_view>{"def"_sz, "x"_sz, "abc"_sz},
+               cfound);
+  EXPECT_EQ(cfound[0], &strs.at("def"));
+  EXPECT_EQ(cfound[1], nullptr);
+  EXPECT_EQ(cfound[2], &strs.at("abc"));
+}
+
+TEST(HashMapBasicTest, NonStringKeys) {
+  FlatHashMap<int, int> m;
+  for (int i = 0; i < 1000; ++i) m[i] = i * 2;
+  EXPECT_EQ(m.size(), 1000U);
+  EXPECT_EQ(FindOrDefault(m, 321), 642);
+  EXPECT_EQ(FindPtr(m, 1000), nullptr);
+}
+
+// std::hash is the identity for integers, so sequential keys only spread out
+// because the map mixes the hash.
+TEST(HashMapBasicTest, SequentialIntegerKeys) {
+  FlatHashMap<uint64_t, uint64_t> m;
+  for (uint64_t i = 0; i < 100000; ++i) m[i] = i;
+  for (uint64_t i = 0; i < 100000; i += 2) m.erase(i);
+  EXPECT_EQ(m.size(), 50000U);
+  for (uint64_t i = 0; i < 100000; ++i)
+    ASSERT_EQ(FindPtr(m, i) != nullptr, i % 2 == 1) << i;
+  EXPECT_EQ(FindOrDefault(m, uint64_t{99999}), 99999U);
+}
+
+// The slots follow the control bytes, which must be padded out to the value's
+// alignment.
+TEST(HashMapBasicTest, OverAlignedValues) {
+  struct alignas(64) Big {
+    int x = 0;
+  };
+  FlatHashMap<int, Big> m;
+  auto before = test::Allocations();
+  for (int i = 0; i < 1000; ++i) m[i].x = i;
+  // Allocated with the aligned operator new, which is counted too.
+  EXPECT_GT(test::Allocations(), before);
+  for (const auto& [k, v] : m) {
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(&v) % alignof(Big), 0U) << k;
+    EXPECT_EQ(v.x, k);
+  }
+  EXPECT_EQ(m.size(), 1000U);
+}
+
+TEST(HashMapBasicTest, PreparedInsert) {
+  StringHashMap<int> m{{"abc", 1}};
+  auto [it, prepared] = m.find_or_prepare_insert("abc"sv);
+  EXPECT_EQ(it->second, 1);
+
+  auto [missing, p] = m.find_or_prepare_insert("def"sv);
+  EXPECT_EQ(missing, m.end());
+  auto inserted = m.emplace_prepared(p, "def"sv, 2);
+  EXPECT_EQ(inserted->first, "def");
+  EXPECT_EQ(m.at("def"), 2);
+
+  // After a change, the key is looked up again, and an entry added since is
+  // left alone.
+  auto [missing2, p2] = m.find_or_prepare_insert("ghi"sv);
+  EXPECT_EQ(missing2, m.end());
+  m["ghi"] = 3;
+  for (int i = 0; i < 100; ++i) m[std::to_string(i)] = i;
+  EXPECT_EQ(m.emplace_prepared(p2, "ghi"sv, 4)->second, 3);
+  EXPECT_EQ(m.size(), 103U);
+
+  // MapKey inserts where its lookup left off.
+  FlatHashMap<int, int> ints;
+  for (int i = 0; i < 1000; ++i) EXPECT_TRUE(MakeMapKey(ints, i).Assign(i));
+  for (int i = 0; i < 1000; ++i) EXPECT_FALSE(MakeMapKey(ints, i).Assign(-i));
+  EXPECT_EQ(ints.size(), 1000U);
+  EXPECT_EQ(ints.at(7), -7);
+}
+
+}  // namespace
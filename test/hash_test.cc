@@ -0,0 +1,164 @@
+// Test for Hash64 and Hasher64.
+#include "nectar/hash.h"
+#include <random>
+#include <string>
+#include <unordered_set>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+std::string RandomBytes(std::mt19937_64& rng, size_t len) {
+  std::string s(len, '\0');
+  for (auto& c : s) c = static_cast<char>(rng());
+  return s;
+}
+
+std::string Alphabet(size_t len) {
+  std::string s;
+  for (size_t i = 0; i < len; ++i) s.push_back('a' + i % 26);
+  return s;
+}
+
+TEST(HashTest, Stable) {
+  // These values must never change, since hashes may be persisted.
+  EXPECT_EQ(Hash64(""), 0x4097b44814aedc14ULL);
+  EXPECT_EQ(Hash64("a"), 0xef9e686e2c03faf4ULL);
+  EXPECT_EQ(Hash64("abc"), 0x6818688dbb55d0efULL);
+  EXPECT_EQ(Hash64("abcd"), 0xa70d6cc8648546ccULL);
+  EXPECT_EQ(Hash64("abcdefgh"), 0x7e1df0fa67da9634ULL);
+  EXPECT_EQ(Hash64("abcdefghijklmnop"), 0x27dc32b2f2e6ea08ULL);
+  EXPECT_EQ(Hash64(Alphabet(17)), 0x873185e0c278a124ULL);
+  EXPECT_EQ(Hash64(Alphabet(100)), 0x28c480ebdfa50827ULL);
+  EXPECT_EQ(Hash64(Alphabet(128)), 0xaa19f2de04f625d6ULL);
+  EXPECT_EQ(Hash64(Alphabet(129)), 0x6bfe5fbd84af17afULL);
+  EXPECT_EQ(Hash64(Alphabet(1000)), 0x6cf327d7f1606360ULL);
+  EXPECT_EQ(Hash64(Alphabet(1000), 42), 0x0345a915ca5900b6ULL);
+}
+
+TEST(HashTest, Constexpr) {
+  constexpr auto kShort = Hash64("abcdefgh");
+  static_assert(kShort == 0x7e1df0fa67da9634ULL);
+  constexpr std::string_view kText =
+      "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrst"
+      "uvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmn"
+      "opqrstuvwxyzabcdefghijklmnopqrstuvwxyzab";
+  static_assert(kText.size() > details::kHashMaxShortLen);
+  constexpr auto kLong = Hash64(kText);
+  EXPECT_EQ(kLong, Hash64(Alphabet(kText.size())));
+  constexpr auto kSeeded = Hash64("abcdefgh", 7);
+  EXPECT_EQ(kSeeded, Hash64(Alphabet(8), 7));
+}
+
+TEST(HashTest, HashedStringView) {
+  constexpr auto kKey = "segment"_hashed;
+  static_assert(kKey.hash() == Hash64("segment"));
+  static_assert(std::string_view(kKey) == "segment");
+  static_assert(kKey.size() == 7);
+
+  const std::string text = Alphabet(200);
+  const HashedStringView key(text);
+  EXPECT_EQ(key.hash(), Hash64(text));
+  EXPECT_EQ(key.data(), text.data());
+  EXPECT_EQ(key, HashedStringView(text, Hash64(text)));
+  EXPECT_NE(key, kKey);
+  EXPECT_LT(key, kKey);
+
+  const HashedStringView empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(empty.hash(), Hash64(""));
+  EXPECT_EQ(empty, ""_hashed);
+}
+
+TEST(HashTest, KernelsAgree) {
+  std::mt19937_64 rng(1);
+  for (size_t len = details::kHashMaxShortLen + 1; len < 5000; len += 37) {
+    auto s = RandomBytes(rng, len);
+    for (uint64_t seed : {uint64_t{0}, rng()}) {
+      auto secret = details::MakeHashSecret(seed);
+      auto expected = details::HashLong(
+          s.data(), len, secret, details::HashAccumulateScalar);
+#ifdef __SSE2__
+      EXPECT_EQ(
+          details::HashLong(s.data(), len, secret, details::HashAccumulateSse2),
+          expected);
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+      if (__builtin_cpu_supports("avx2")) {
+        EXPECT_EQ(details::HashLong(
+                      s.data(), len, secret, details::HashAccumulateAvx2),
+                  expected);
+      }
+#endif
+      EXPECT_EQ(Hash64(s, seed), expected);
+    }
+  }
+}
+
+TEST(HashTest, StreamingMatchesOneShot) {
+  std::mt19937_64 rng(2);
+  for (size_t len : {0, 1, 15, 64, 128, 129, 255, 256, 257, 300, 511, 512, 513,
+                     1000, 1024, 1025, 4096, 10000}) {
+    auto s = RandomBytes(rng, len);
+    for (uint64_t seed : {uint64_t{0}, uint64_t{99}}) {
+      auto expected = Hash64(s, seed);
+      // Whole, byte at a time, and random pieces.
+      EXPECT_EQ(Hasher64(seed).Update(s).Digest(), expected) << len;
+      Hasher64 bytes(seed);
+      for (char c : s) bytes.Update(std::string_view(&c, 1));
+      EXPECT_EQ(bytes.Digest(), expected) << len;
+      for (int trial = 0; trial < 10; ++trial) {
+        Hasher64 pieces(seed);
+        for (size_t pos = 0; pos < len;) {
+          size_t n = std::min<size_t>(len - pos, rng() % 700);
+          pieces.Update(std::string_view(s).substr(pos, n));
+          pos += n;
+        }
+        EXPECT_EQ(pieces.Digest(), expected) << len;
+      }
+    }
+  }
+
+  // Digest doesn't disturb further updates, and Reset starts over.
+  Hasher64 hasher;
+  auto s = Alphabet(1000);
+  hasher.Update(std::string_view(s).substr(0, 300));
+  EXPECT_EQ(hasher.Digest(), Hash64(std::string_view(s).substr(0, 300)));
+  hasher.Update(std::string_view(s).substr(300));
+  EXPECT_EQ(hasher.Digest(), Hash64(s));
+  hasher.Reset();
+  EXPECT_EQ(hasher.Digest(), Hash64(""));
+}
+
+TEST(HashTest, Distinct) {
+  std::unordered_set<uint64_t> seen;
+  for (int i = 0; i < 100000; ++i) seen.insert(Hash64(std::to_string(i)));
+  EXPECT_EQ(seen.size(), 100000U);
+
+  // Lengths of zeros, which catches length not being mixed in.
+  seen.clear();
+  std::string zeros(600, '\0');
+  for (size_t len = 0; len <= zeros.size(); ++len)
+    seen.insert(Hash64(std::string_view(zeros).substr(0, len)));
+  EXPECT_EQ(seen.size(), zeros.size() + 1);
+
+  // Single bit flips anywhere in the input.
+  seen.clear();
+  auto base = Alphabet(300);
+  seen.insert(Hash64(base));
+  for (size_t i = 0; i < base.size(); ++i) {
+    for (int bit = 0; bit < 8; ++bit) {
+      auto flipped = base;
+      flipped[i] ^= 1 << bit;
+      seen.insert(Hash64(flipped));
+    }
+  }
+  EXPECT_EQ(seen.size(), base.size() * 8 + 1);
+
+  EXPECT_NE(Hash64("abc", 1), Hash64("abc", 2));
+  EXPECT_NE(Hash64(base, 1), Hash64(base, 2));
+}
+
+}  // namespace
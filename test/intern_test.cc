@@ -0,0 +1,113 @@
+#include "nectar/intern.h"
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+TEST(InternTest, Intern) {
+  InternPool pool;
+  auto a = pool.Intern("example.com");
+  auto b = pool.Intern(std::string("example.com"));
+  auto c = pool.Intern("example.org");
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(a.data(), b.data());
+  EXPECT_NE(a, c);
+  EXPECT_EQ(pool.size(), 2U);
+
+  EXPECT_EQ(std::string_view(a), "example.com");
+  EXPECT_EQ(a.size(), 11U);
+  EXPECT_STREQ(a.c_str(), "example.com");
+  cstring_view sz = a;
+  EXPECT_STREQ(sz.c_str(), "example.com");
+  EXPECT_EQ(a.hash(), Hash64("example.com"));
+  EXPECT_TRUE(a < c);
+  EXPECT_FALSE(c < a);
+  EXPECT_FALSE(a < b);
+
+  // Interning doesn't keep a reference to the argument.
+  std::string temp(100, 'x');
+  auto t = pool.Intern(temp);
+  temp.assign(100, 'y');
+  EXPECT_EQ(std::string_view(t), std::string(100, 'x'));
+}
+
+TEST(InternTest, Empty) {
+  InternPool pool;
+  InternedString empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_STREQ(empty.c_str(), "");
+  EXPECT_EQ(empty.hash(), Hash64(""));
+  EXPECT_EQ(pool.Intern(""), empty);
+  EXPECT_EQ(Intern(""), empty);
+  EXPECT_EQ(pool.size(), 0U);
+}
+
+TEST(InternTest, Find) {
+  InternPool pool;
+  EXPECT_EQ(pool.Find("us"), std::nullopt);
+  auto us = pool.Intern("us");
+  EXPECT_EQ(pool.Find("us"), us);
+  EXPECT_EQ(pool.Find(""), InternedString());
+  EXPECT_EQ(pool.size(), 1U);
+}
+
+TEST(InternTest, Global) {
+  EXPECT_EQ(Intern("segment"), Intern(std::string("segment")));
+  EXPECT_EQ(InternPool::Global().Find("segment"), Intern("segment"));
+}
+
+TEST(InternTest, Keys) {
+  InternPool pool;
+  auto us = pool.Intern("us");
+  auto ca = pool.Intern("ca");
+
+  // Lookup in string maps.
+  StringMap<int> sm{{"us", 1}, {"ca", 2}};
+  EXPECT_EQ(FindOrDefault(sm, us), 1);
+  StringHashMap<int> shm{{"us", 1}, {"ca", 2}};
+  EXPECT_EQ(FindOrDefault(shm, ca), 2);
+  EXPECT_EQ(StringHash{}(us), StringHash{}("us"));
+  MakeMapKey(sm, pool.Intern("mx")).Assign(3);
+  EXPECT_EQ(sm.at("mx"), 3);
+
+  // As keys themselves.
+  FlatHashMap<InternedString, int> hm{{us, 1}};
+  hm[ca] = 2;
+  EXPECT_EQ(hm.at(us), 1);
+  EXPECT_EQ(FindOrDefault(hm, pool.Intern("ca")), 2);
+  std::unordered_map<InternedString, int> um{{us, 1}};
+  EXPECT_EQ(um.count(pool.Intern("us")), 1U);
+  std::map<InternedString, int> m{{us, 1}, {ca, 2}};
+  EXPECT_EQ(m.begin()->first, ca);
+}
+
+TEST(InternTest, Threads) {
+  InternPool pool;
+  constexpr int kThreads = 8;
+  constexpr int kStrings = 1000;
+  std::vector<std::vector<InternedString>> results(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&pool, &results, t] {
+      for (int i = 0; i < kStrings; ++i)
+        results[t].push_back(pool.Intern("string-" + std::to_string(i)));
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  EXPECT_EQ(pool.size(), size_t{kStrings});
+  for (int t = 1; t < kThreads; ++t) EXPECT_EQ(results[t], results[0]);
+  std::set<const char*> distinct;
+  for (auto s : results[0]) distinct.insert(s.data());
+  EXPECT_EQ(distinct.size(), size_t{kStrings});
+}
+
+}  // namespace
@@ -0,0 +1,100 @@
+// Test for MappedFile.
+#include "nectar/mapped_file.h"
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+class MappedFileTest : public ::testing::Test {
+ public:
+  ~MappedFileTest() override { std::remove(path_.c_str()); }
+
+  // Writes contents to the temporary file, returning its path.
+  const std::string& Write(const std::string& contents) {
+    FILE* f = std::fopen(path_.c_str(), "wb");
+    std::fwrite(contents.data(), 1, contents.size(), f);
+    std::fclose(f);
+    return path_;
+  }
+
+ private:
+  std::string path_ = ::testing::TempDir() + "mapped_file_test." +
+                      std::to_string(::getpid());
+};
+
+TEST_F(MappedFileTest, Terminated) {
+  const size_t page = ::sysconf(_SC_PAGESIZE);
+  for (size_t n : {size_t{0}, size_t{1}, page - 1, page, page + 1, 3 * page}) {
+    std::string contents;
+    for (size_t i = 0; i < n; ++i) contents.push_back('a' + i % 26);
+    MappedFile file(Write(contents));
+    ASSERT_EQ(file.size(), n);
+    EXPECT_EQ(file.empty(), n == 0);
+    EXPECT_EQ(std::string(file.data(), file.size()), contents);
+    EXPECT_EQ(file.data()[n], '\0');
+    EXPECT_EQ(std::strlen(file.view().c_str()), n);
+    EXPECT_EQ(file.view(), contents);
+  }
+}
+
+// Data appended while mapped would land on the last page, after the NUL.
+TEST_F(MappedFileTest, Appended) {
+  const size_t page = ::sysconf(_SC_PAGESIZE);
+  for (size_t n : {size_t{10}, page + 10, page}) {
+    const std::string contents(n, 'a');
+    const auto& path = Write(contents);
+    MappedFile file(path);
+    FILE* f = std::fopen(path.c_str(), "ab");
+    std::fputs("appended", f);
+    std::fclose(f);
+    EXPECT_EQ(file.data()[n], '\0');
+    EXPECT_EQ(file.view(), contents);
+    EXPECT_EQ(std::strlen(file.view().c_str()), n);
+  }
+}
+
+TEST_F(MappedFileTest, Advise) {
+  MappedFile file(Write(std::string(100000, 'x')));
+  EXPECT_TRUE(file.Advise(MappedFile::Advice::kSequential));
+  EXPECT_TRUE(file.Advise(MappedFile::Advice::kWillNeed, 5000, 20000));
+  EXPECT_TRUE(file.Advise(MappedFile::Advice::kRandom, 99999));
+  EXPECT_TRUE(file.Advise(MappedFile::Advice::kNormal));
+  // Huge pages may or may not be supported for files, but are harmless.
+  file.Advise(MappedFile::Advice::kHugePage);
+  EXPECT_FALSE(file.Advise(MappedFile::Advice::kNormal, 100000));
+  EXPECT_FALSE(MappedFile().Advise(MappedFile::Advice::kNormal));
+}
+
+TEST_F(MappedFileTest, Move) {
+  MappedFile file(Write("hello"));
+  MappedFile moved(std::move(file));
+  EXPECT_EQ(moved.view(), "hello");
+  EXPECT_TRUE(file.empty());  // NOLINT
+  EXPECT_EQ(file.view(), "");
+
+  file = MappedFile(Write("bye"));
+  moved = std::move(file);
+  EXPECT_EQ(moved.view(), "bye");
+  EXPECT_TRUE(file.empty());  // NOLINT
+}
+
+TEST_F(MappedFileTest, Missing) {
+  EXPECT_THROW(MappedFile("/nonexistent/mapped_file_test"), std::system_error);
+  try {
+    MappedFile("/nonexistent/mapped_file_test");
+  } catch (const std::system_error& e) {
+    EXPECT_EQ(e.code(), std::errc::no_such_file_or_directory);
+    EXPECT_NE(std::string(e.what()).find("/nonexistent"), std::string::npos);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,149 @@
+// Test for Counter, Histogram, ScopedTimer and MetricsRegistry.
+#include "nectar/metrics.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+TEST(MetricsTest, Counter) {
+  Counter c;
+  EXPECT_EQ(c.Value(), 0);
+  c.Add();
+  c.Add(10);
+  c.Add(-3);
+  EXPECT_EQ(c.Value(), 8);
+
+  // Adds from many threads, more than there are slots, all count.
+  constexpr int kThreads = 2 * details::kMetricSlots;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&c] {
+      for (int i = 0; i < 10000; ++i) c.Add();
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  EXPECT_EQ(c.Value(), 8 + kThreads * 10000);
+}
+
+TEST(MetricsTest, Buckets) {
+  using H = HistogramSnapshot;
+  // Small values are exact, and every value is within its bucket's bounds.
+  for (uint64_t v = 0; v < 8; ++v) EXPECT_EQ(H::BucketFor(v), v);
+  size_t last = 0;
+  for (uint64_t v = 1; v < (uint64_t{1} << 40); v += v / 7 + 1) {
+    auto b = H::BucketFor(v);
+    ASSERT_LT(b, H::kBuckets);
+    EXPECT_GE(b, last);
+    last = b;
+    EXPECT_LE(H::BucketMin(b), v);
+    EXPECT_GE(H::BucketMax(b), v);
+    if (b + 1 < H::kBuckets) {
+      // Buckets are at most 12.5% wide.
+      EXPECT_LE(H::BucketMax(b) - H::BucketMin(b), H::BucketMin(b) / 8) << v;
+      EXPECT_EQ(H::BucketFor(H::BucketMin(b)), b);
+      EXPECT_EQ(H::BucketFor(H::BucketMax(b)), b);
+    }
+  }
+  EXPECT_EQ(H::BucketFor(UINT64_MAX), H::kBuckets - 1);
+  EXPECT_EQ(H::BucketMax(H::kBuckets - 1), UINT64_MAX);
+}
+
+TEST(MetricsTest, Histogram) {
+  Histogram h;
+  EXPECT_EQ(h.Snapshot().count(), 0U);
+  EXPECT_EQ(h.Snapshot().Percentile(0.5), 0U);
+
+  for (uint64_t v = 1; v <= 1000; ++v) h.Record(v);
+  auto s = h.Snapshot();
+  EXPECT_EQ(s.count(), 1000U);
+  EXPECT_EQ(s.sum(), 500500U);
+  EXPECT_DOUBLE_EQ(s.Mean(), 500.5);
+  // Percentiles are accurate to the bucket.
+  for (double q : {0.0, 0.1, 0.5, 0.9, 0.99, 1.0}) {
+    auto expected = std::max<uint64_t>(1, q * 1000);
+    auto p = s.Percentile(q);
+    EXPECT_GE(p, expected) << q;
+    EXPECT_LE(p, expected + expected / 8 + 1) << q;
+  }
+
+  auto twice = s;
+  twice += s;
+  EXPECT_EQ(twice.count(), 2000U);
+  EXPECT_EQ(twice.Percentile(0.5), s.Percentile(0.5));
+}
+
+TEST(MetricsTest, HistogramThreads) {
+  Histogram h;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&h, t] {
+      for (uint64_t i = 0; i < 10000; ++i) h.Record(t);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  auto s = h.Snapshot();
+  EXPECT_EQ(s.count(), 40000U);
+  EXPECT_EQ(s.sum(), 60000U);
+  for (size_t t = 0; t < 4; ++t) EXPECT_EQ(s.buckets()[t], 10000U);
+}
+
+TEST(MetricsTest, ScopedTimer) {
+  Histogram h;
+  if (ScopedTimer timer{h}) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  auto s = h.Snapshot();
+  EXPECT_EQ(s.count(), 1U);
+  EXPECT_GE(s.sum(), 2000000U);
+
+  {
+    ScopedTimer timer(h);
+    timer.Cancel();
+  }
+  { ScopedTimer timer(h, false); }
+  EXPECT_EQ(h.Snapshot().count(), 1U);
+
+  {
+    ScopedTimer timer(h);
+    ScopedTimer moved(std::move(timer));
+  }
+  EXPECT_EQ(h.Snapshot().count(), 2U);
+}
+
+TEST(MetricsTest, Registry) {
+  MetricsRegistry registry;
+  auto& requests = registry.GetCounter("requests");
+  EXPECT_EQ(&registry.GetCounter("requests"_sz), &requests);
+  // Names are copied.
+  auto& errors = registry.GetCounter(std::string("errors"));
+  EXPECT_NE(&errors, &requests);
+  auto& latency = registry.GetHistogram("latency");
+  // Counters and histograms have separate names.
+  registry.GetHistogram("requests");
+
+  requests.Add(5);
+  errors.Add();
+  latency.Record(100);
+  auto snapshot = registry.Snapshot();
+  EXPECT_EQ(snapshot.counters.size(), 2U);
+  EXPECT_EQ(FindOrDefault(snapshot.counters, "requests"), 5);
+  EXPECT_EQ(FindOrDefault(snapshot.counters, "errors"), 1);
+  EXPECT_EQ(snapshot.histograms.size(), 2U);
+  EXPECT_EQ(snapshot.histograms.at("latency").count(), 1U);
+  EXPECT_EQ(snapshot.histograms.at("requests").count(), 0U);
+  EXPECT_STREQ(snapshot.counters.begin()->first.c_str(), "errors");
+
+  // The snapshot is a copy.
+  requests.Add();
+  EXPECT_EQ(FindOrDefault(snapshot.counters, "requests"), 5);
+
+  EXPECT_EQ(&MetricsRegistry::Default(), &MetricsRegistry::Default());
+}
+
+}  // namespace
@@ -0,0 +1,142 @@
+// Test for NodePool.
+#include "nectar/node_pool.h"
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "test/alloc_counter.h"
+
+namespace {
+
+using std::literals::operator""sv;
+using namespace beeswax::nectar;  // NOLINT
+
+// Long enough that std::string allocates, and all the same length, so that a
+// recycled key always has room for the next.
+std::string SessionId(int i) {
+  auto digits = std::to_string(i);
+  return "session-" + std::string(24 - digits.size(), '0') + digits;
+}
+
+TEST(NodePoolTest, Basics) {
+  StringMap<int> m{{"abc", 1}, {"def", 2}, {"ghi", 3}};
+  NodePool<StringMap<int>> pool;
+  EXPECT_TRUE(pool.empty());
+  EXPECT_EQ(pool.capacity(), NodePool<StringMap<int>>::kDefaultCapacity);
+
+  EXPECT_EQ(pool.Erase(m, "abc"sv), 1U);
+  EXPECT_EQ(pool.Erase(m, "abc"sv), 0U);
+  auto next = pool.Erase(m, m.find("def"));
+  EXPECT_EQ(next->first, "ghi");
+  EXPECT_EQ(pool.size(), 2U);
+  EXPECT_EQ(m.size(), 1U);
+
+  // Inserting takes parked nodes; assigning over an existing entry doesn't.
+  EXPECT_TRUE(MakeMapKey(m, "jkl"sv, pool).Assign(4));
+  EXPECT_FALSE(MakeMapKey(m, "ghi"sv, pool).Assign(5));
+  EXPECT_EQ(pool.size(), 1U);
+  EXPECT_EQ(*MakeMapKey(m, "mno", pool), 0);
+  EXPECT_TRUE(pool.empty());
+
+  // With the pool empty, nodes are allocated as usual.
+  EXPECT_EQ(MakeMapKey(m, std::string("pqr"), pool).DefaultValue(6), 6);
+  EXPECT_EQ(m,
+            (StringMap<int>{{"ghi", 5}, {"jkl", 4}, {"mno", 0}, {"pqr", 6}}));
+
+  // Insert doesn't overwrite.
+  EXPECT_FALSE(insert(m, "ghi", 9, pool));
+  EXPECT_EQ(m["ghi"], 5);
+  EXPECT_TRUE(insert(m, "stu", 7, pool));
+  EXPECT_EQ(m["stu"], 7);
+
+  EXPECT_EQ(erase_if(m, [](auto& kv) { return kv.second > 4; }, pool), 3U);
+  EXPECT_EQ(m, (StringMap<int>{{"jkl", 4}, {"mno", 0}}));
+  EXPECT_EQ(pool.size(), 3U);
+  pool.clear();
+  EXPECT_TRUE(pool.empty());
+}
+
+TEST(NodePoolTest, Capacity) {
+  std::map<int, int> m;
+  for (int i = 0; i < 10; ++i) m[i] = i;
+  NodePool<std::map<int, int>> pool(4);
+  EXPECT_EQ(erase_if(m, [](auto&) { return true; }, pool), 10U);
+  EXPECT_TRUE(m.empty());
+  EXPECT_EQ(pool.size(), 4U);
+
+  // Empty nodes aren't parked.
+  pool.clear();
+  pool.Put(m.extract(0));
+  EXPECT_TRUE(pool.empty());
+  EXPECT_FALSE(pool.Take());
+}
+
+TEST(NodePoolTest, Emplace) {
+  std::map<std::string, std::pair<int, std::string>> m;
+  NodePool<decltype(m)> pool;
+  MakeMapKey(m, "abc", pool).Emplace(1, "one");
+  pool.Erase(m, "abc");
+  MakeMapKey(m, "def", pool).Emplace(2, "two");
+  EXPECT_TRUE(pool.empty());
+  EXPECT_EQ(m["def"], std::make_pair(2, std::string("two")));
+  EXPECT_EQ(MakeMapKey(m, "ghi", pool).DefaultValueEmplace(3, "three").first,
+            3);
+}
+
+TEST(NodePoolTest, Churn) {
+  // Once the pool is primed, churn doesn't allocate, even for keys and values
+  // too long to fit in std::string's small buffer.
+  constexpr int kLive = 100;
+  std::vector<std::string> ids;
+  for (int i = 0; i < 10 * kLive; ++i) ids.push_back(SessionId(i));
+  std::string value(100, 'x');
+  StringMap<std::string> m;
+  NodePool<StringMap<std::string>> pool;
+  for (int i = 0; i < kLive; ++i) MakeMapKey(m, ids[i], pool).Assign(value);
+  // Primes the pool's free list.
+  pool.Erase(m, ids[0]);
+  MakeMapKey(m, ids[0], pool).Assign(value);
+
+  auto before = test::Allocations();
+  for (int i = kLive; i < 10 * kLive; ++i) {
+    // Parks the node, with its key and value buffers.
+    EXPECT_EQ(pool.Erase(m, ids[i - kLive]), 1U);
+    std::string_view id = ids[i];
+    if (i % 2)
+      EXPECT_TRUE(MakeMapKey(m, id, pool).Assign(value));
+    else
+      EXPECT_TRUE(insert(m, id, value, pool));
+  }
+  EXPECT_EQ(test::Allocations(), before);
+  EXPECT_EQ(m.size(), static_cast<size_t>(kLive));
+  EXPECT_EQ(m.begin()->first, ids[9 * kLive]);
+  EXPECT_EQ(m.begin()->second, value);
+
+  // Bulk expiry parks nodes for the next wave.
+  EXPECT_EQ(erase_if(m, [](auto&) { return true; }, pool), 100U);
+  before = test::Allocations();
+  for (int i = 0; i < kLive; ++i)
+    MakeMapKey(m, std::string_view(ids[i]), pool).Assign("y"sv);
+  EXPECT_EQ(test::Allocations(), before);
+  EXPECT_EQ(m.size(), static_cast<size_t>(kLive));
+  EXPECT_EQ(m[ids[0]], "y");
+}
+
+TEST(NodePoolTest, UnorderedMap) {
+  std::unordered_map<int, std::string> m;
+  NodePool<std::unordered_map<int, std::string>> pool;
+  for (int i = 0; i < 100; ++i) m[i] = std::to_string(i);
+  EXPECT_EQ(erase_if(m, [](auto& kv) { return kv.first % 2; }, pool), 50U);
+  EXPECT_EQ(pool.size(), 50U);
+
+  auto before = test::Allocations();
+  for (int i = 100; i < 150; ++i) EXPECT_TRUE(insert(m, i, "x", pool));
+  EXPECT_EQ(test::Allocations(), before);
+  EXPECT_EQ(m.size(), 100U);
+  EXPECT_EQ(m[149], "x");
+  EXPECT_EQ(m.count(1), 0U);
+}
+
+}  // namespace
@@ -1,8 +1,13 @@
 #include "nectar/scoper.h"
+#include <new>
 #include <ostream>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
+#include "test/alloc_counter.h"
 
 namespace {
 
@@ -58,4 +63,168 @@ TEST(ScoperTest, SmokeTest) {
   EXPECT_EQ(i, 4);
 }
 
+TEST(ScoperTest, ScopeGuard) {
+  int i;
+
+  i = 0;
+  if (ScopeGuard scope{[&i] { i += 2; }}) {
+    EXPECT_EQ(i, 0);
+  }
+  EXPECT_EQ(i, 2);
+
+  i = 0;
+  if (ScopeGuard scope{[&i] { i += 2; }, false}) {
+    EXPECT_EQ(i, 0);
+  }
+  EXPECT_EQ(i, 0);
+
+  i = 0;
+  if (ScopeGuard scope{[&i] { i += 2; }, [&i] { i *= 2; }}) {
+    EXPECT_EQ(i, 2);
+  }
+  EXPECT_EQ(i, 4);
+
+  i = 0;
+  if (ScopeGuard scope{[&i] { i += 2; }, [&i] { i *= 2; }, false}) {
+    EXPECT_EQ(i, 0);
+  }
+  EXPECT_EQ(i, 0);
+
+  i = 0;
+  {
+    auto scope = MakeScopeGuard([&i] { i += 2; }, [&i] { i *= 2; });
+    EXPECT_EQ(i, 2);
+    scope.Cancel();
+  }
+  EXPECT_EQ(i, 2);
+
+  i = 0;
+  {
+    auto scope = MakeScopeGuard([&i] { i += 2; }, [&i] { i *= 2; });
+    EXPECT_EQ(i, 2);
+    auto other(std::move(scope));
+    EXPECT_EQ(i, 2);
+  }
+  EXPECT_EQ(i, 4);
+
+  i = 0;
+  { auto scope = MakeScopeGuard([&i] { i += 2; }, false); }
+  EXPECT_EQ(i, 0);
+}
+
+TEST(ScoperTest, ScopeGuardIsCheap) {
+  // Captures far too big for std::function's small buffer are stored inline.
+  std::string big(100, 'x');
+  std::string seen;
+  auto close = [&seen, big] { seen = big; };
+  {
+    auto before = test::Allocations();
+    auto scope = MakeScopeGuard(close);
+    EXPECT_EQ(test::Allocations(), before + 1);  // Copies `big`.
+    static_assert(sizeof(scope) == sizeof(close) + alignof(decltype(close)));
+    static_assert(std::is_nothrow_move_constructible_v<decltype(scope)>);
+    static_assert(noexcept(scope.Cancel()));
+  }
+  EXPECT_EQ(seen, big);
+
+  // Function pointers work too.
+  static int calls = 0;
+  calls = 0;
+  { ScopeGuard scope{+[] { ++calls; }}; }
+  EXPECT_EQ(calls, 1);
+}
+
+TEST(ScoperTest, ScopeStack) {
+  std::vector<int> order;
+  {
+    ScopeStack cleanup;
+    EXPECT_TRUE(cleanup.empty());
+    for (int i = 0; i < 3; ++i)
+      cleanup.Push([&order, i] { order.push_back(i); });
+    cleanup.Push([&order] { order.push_back(10); },
+                 [&order] { order.push_back(11); });
+    EXPECT_EQ(cleanup.size(), 4U);
+    EXPECT_EQ(order, std::vector<int>{10});
+  }
+  EXPECT_EQ(order, (std::vector<int>{10, 11, 2, 1, 0}));
+
+  order.clear();
+  {
+    ScopeStack cleanup;
+    cleanup.Push([&order] { order.push_back(0); });
+    cleanup.Cancel();
+    EXPECT_TRUE(cleanup.empty());
+    cleanup.Push([&order] { order.push_back(1); });
+  }
+  EXPECT_EQ(order, std::vector<int>{1});
+
+  order.clear();
+  {
+    ScopeStack cleanup;
+    cleanup.Push([&order] { order.push_back(0); });
+    cleanup.Close();
+    EXPECT_EQ(order, std::vector<int>{0});
+    cleanup.Push([&order] { order.push_back(1); });
+  }
+  EXPECT_EQ(order, (std::vector<int>{0, 1}));
+}
+
+TEST(ScoperTest, ScopeStackTransfer) {
+  std::vector<int> order;
+  {
+    ScopeStack outer;
+    outer.Push([&order] { order.push_back(0); });
+    {
+      ScopeStack inner;
+      inner.Push([&order] { order.push_back(1); });
+      inner.Push([&order] { order.push_back(2); });
+      // Runs outer's closer, then takes inner's.
+      outer = std::move(inner);
+      EXPECT_EQ(order, std::vector<int>{0});
+      EXPECT_TRUE(inner.empty());
+    }
+    ScopeStack last(std::move(outer));
+    EXPECT_EQ(last.size(), 2U);
+    EXPECT_EQ(order, std::vector<int>{0});
+  }
+  EXPECT_EQ(order, (std::vector<int>{0, 2, 1}));
+}
+
+TEST(ScoperTest, ScopeStackNoAllocations) {
+  // Closers are moved into the stack's inline buffer, however many there are,
+  // until it's full.
+  int open = 0;
+  auto before = test::Allocations();
+  {
+    ScopeStack cleanup;
+    for (int i = 0; i < 16; ++i)
+      cleanup.Push([&open] { ++open; }, [&open] { --open; });
+    EXPECT_EQ(open, 16);
+    ScopeStack moved(std::move(cleanup));
+  }
+  EXPECT_EQ(open, 0);
+  EXPECT_EQ(test::Allocations(), before);
+}
+
+TEST(ScoperTest, ScopeStackGrows) {
+  // Past the inline buffer, closers move to the heap, intact and in order.
+  std::vector<std::string> order;
+  order.reserve(1000);
+  {
+    BasicScopeStack<64> cleanup;
+    for (int i = 0; i < 1000; ++i) {
+      cleanup.Push([&order, s = std::to_string(i)] { order.push_back(s); });
+    }
+    EXPECT_EQ(cleanup.size(), 1000U);
+
+    // Moving a spilled stack just takes its buffer.
+    auto before = test::Allocations();
+    BasicScopeStack<64> moved(std::move(cleanup));
+    EXPECT_EQ(test::Allocations(), before);
+    EXPECT_TRUE(cleanup.empty());
+  }
+  ASSERT_EQ(order.size(), 1000U);
+  for (int i = 0; i < 1000; ++i) EXPECT_EQ(order[i], std::to_string(999 - i));
+}
+
 }  // namespace
\ No newline at end of file
@@ -0,0 +1,131 @@
+// Test for in-place splitting.
+#include "nectar/split.h"
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "test/alloc_counter.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+// Splits the usual way, for comparison.
+std::vector<std::string> Expected(std::string_view s, std::string_view set) {
+  std::vector<std::string> pieces;
+  size_t pos = 0;
+  for (size_t i; (i = s.find_first_of(set, pos)) != s.npos; pos = i + 1)
+    pieces.emplace_back(s.substr(pos, i - pos));
+  pieces.emplace_back(s.substr(pos));
+  return pieces;
+}
+
+// Splits a copy, checking that each piece is terminated in place.
+std::vector<std::string> Split(std::string s, std::string_view set) {
+  std::vector<std::string> pieces;
+  const char* begin = s.data();
+  for (cstring_view piece : SplitInPlace(s, set)) {
+    EXPECT_EQ(piece.c_str()[piece.size()], '\0');
+    EXPECT_GE(piece.data(), begin);
+    EXPECT_LE(piece.data() + piece.size(), begin + s.size());
+    pieces.emplace_back(piece);
+  }
+  return pieces;
+}
+
+TEST(SplitTest, Basics) {
+  using V = std::vector<std::string>;
+  EXPECT_EQ(Split("a,bc,,d", ","), (V{"a", "bc", "", "d"}));
+  EXPECT_EQ(Split("", ","), (V{""}));
+  EXPECT_EQ(Split(",", ","), (V{"", ""}));
+  EXPECT_EQ(Split("abc", ","), (V{"abc"}));
+  EXPECT_EQ(Split("abc", ""), (V{"abc"}));
+  EXPECT_EQ(Split("k=v;k2=v2", "=;"), (V{"k", "v", "k2", "v2"}));
+
+  std::string line = "2024-01-01\tGET\t/index.html\t200";
+  std::vector<std::string> fields;
+  for (auto& field : SplitInPlace(line, '\t')) fields.emplace_back(field);
+  EXPECT_EQ(fields, (V{"2024-01-01", "GET", "/index.html", "200"}));
+  EXPECT_EQ(std::string_view(line.c_str()), "2024-01-01");
+}
+
+TEST(SplitTest, Next) {
+  char buf[] = "x y  z";
+  auto splitter = SplitInPlace(buf, sizeof(buf) - 1, " ");
+  cstring_view piece;
+  ASSERT_TRUE(splitter.Next(piece));
+  EXPECT_EQ(piece, "x");
+  ASSERT_TRUE(splitter.Next(piece));
+  EXPECT_EQ(piece, "y");
+  ASSERT_TRUE(splitter.Next(piece));
+  EXPECT_EQ(piece, "");
+  ASSERT_TRUE(splitter.Next(piece));
+  EXPECT_EQ(piece, "z");
+  EXPECT_FALSE(splitter.Next(piece));
+  EXPECT_FALSE(splitter.Next(piece));
+}
+
+TEST(SplitTest, Unterminated) {
+  char buf[] = {'a', ',', 'b'};
+  EXPECT_THROW(SplitInPlace(buf, 2, ","), std::logic_error);
+  EXPECT_THROW(SplitInPlace(nullptr, 0, ","), std::logic_error);
+}
+
+// Random inputs of lengths around the block size, and delimiter sets small
+// and large, match splitting the usual way.
+TEST(SplitTest, MatchesExpected) {
+  std::mt19937 rng(1);
+  const std::string_view alphabet = ",;|\t abcdefghijklmnopqrstuvwxyz0123";
+  for (std::string_view set : {",", ",;", ",;|\t ", ",;|\t abcdefgh"}) {
+    for (size_t n : {1, 15, 63, 64, 65, 127, 128, 129, 1000}) {
+      for (int rep = 0; rep < 10; ++rep) {
+        std::string s;
+        for (size_t i = 0; i < n; ++i)
+          s.push_back(alphabet[rng() % alphabet.size()]);
+        EXPECT_EQ(Split(s, set), Expected(s, set)) << s << " / " << set;
+      }
+    }
+  }
+}
+
+// Every kernel this CPU supports agrees with the scalar one.
+TEST(SplitTest, Kernels) {
+  std::mt19937 rng(2);
+  std::string block(details::kSplitBlock, ' ');
+  std::vector<details::DelimiterMaskFn> fns;
+#ifdef __SSE2__
+  fns.push_back(&details::DelimiterMaskSse2);
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    fns.push_back(&details::DelimiterMaskAvx2);
+#endif
+  using namespace std::string_view_literals;
+  for (auto chars : {","sv, "\0,"sv, ",;|\t\n\r\"'"sv}) {
+    const details::DelimiterSet set(chars);
+    for (int rep = 0; rep < 100; ++rep) {
+      for (auto& c : block) c = "\0,;|\t\n\r\"'\xff ab"[rng() % 13];
+      const auto expected = details::DelimiterMaskScalar(block.data(), set);
+      for (auto fn : fns) EXPECT_EQ(fn(block.data(), set), expected);
+    }
+  }
+}
+
+TEST(SplitTest, NoAllocations) {
+  std::string line;
+  for (int i = 0; i < 100; ++i) line += "field" + std::to_string(i) + ",";
+  size_t count = 0;
+  size_t bytes = 0;
+  const auto before = test::Allocations();
+  for (auto& field : SplitInPlace(line, ',')) {
+    ++count;
+    bytes += field.size();
+  }
+  EXPECT_EQ(test::Allocations(), before);
+  EXPECT_EQ(count, 101U);
+  EXPECT_EQ(bytes, line.size() - 100);
+}
+
+}  // namespace
@@ -0,0 +1,132 @@
+// Test for string search.
+#include "nectar/string_search.h"
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+using namespace beeswax::nectar;  // NOLINT
+
+constexpr auto npos = std::string_view::npos;
+
+// Searches work at compile time too.
+static_assert(Find("hello world", "o w") == 4);
+static_assert(RFind("hello world", "o") == 7);
+static_assert(FindFirstOf("hello world", "wr") == 6);
+static_assert(FindFirstOf("hello world"_sz, "abcdefghijklm") == 0);
+
+TEST(StringSearchTest, Find) {
+  std::string_view url = "https://example.com/path/to/page?query=1#frag";
+  EXPECT_EQ(Find(url, "://"), 5U);
+  EXPECT_EQ(Find(url, "/", 8), 19U);
+  EXPECT_EQ(Find(url, "page?query"), 28U);
+  EXPECT_EQ(Find(url, "missing"), npos);
+  EXPECT_EQ(Find(url, ""), 0U);
+  EXPECT_EQ(Find(url, "", url.size()), url.size());
+  EXPECT_EQ(Find(url, "", url.size() + 1), npos);
+  EXPECT_EQ(Find(url, "frag", 42), npos);
+  EXPECT_EQ(Find("", "a"), npos);
+
+  EXPECT_EQ(RFind(url, "/"), 27U);
+  EXPECT_EQ(RFind(url, "/", 26), 24U);
+  EXPECT_EQ(RFind(url, "https"), 0U);
+  EXPECT_EQ(RFind(url, "https", 0), 0U);
+  EXPECT_EQ(RFind(url, ""), url.size());
+  EXPECT_EQ(RFind(url, "", 3), 3U);
+  EXPECT_EQ(RFind("ab", "abc"), npos);
+
+  EXPECT_EQ(FindFirstOf(url, "?#"), 32U);
+  EXPECT_EQ(FindFirstOf(url, "#", 33), 40U);
+  EXPECT_EQ(FindFirstOf(url, ""), npos);
+  EXPECT_EQ(FindFirstOf(url, "?", url.size()), npos);
+  EXPECT_EQ(FindFirstOf(url, "0123456789"), 39U);
+}
+
+TEST(StringSearchTest, Terminated) {
+  // Large sets use the NUL as a sentinel, including past embedded NULs.
+  std::string s("abc\0def\0ghi", 11);
+  cstring_view sz(s);
+  EXPECT_EQ(FindFirstOf(sz, "ihgxyzXYZ123"), 8U);
+  EXPECT_EQ(FindFirstOf(sz, std::string_view("\0xyzXYZ123", 10)), 3U);
+  EXPECT_EQ(FindFirstOf(sz, "jklmnopqrstu"), npos);
+  EXPECT_EQ(FindFirstOf(sz, "abcdefghi", 9), 9U);
+  EXPECT_EQ(FindFirstOf(sz, "ihgxyzXYZ123", 11), npos);
+  EXPECT_EQ(FindFirstOf(""_sz, "ihgxyzXYZ123"), npos);
+}
+
+// Checks every kernel against std::string_view on random inputs drawn from a
+// small alphabet, so that partial matches are common and Find switches to a
+// kernel, or in every other trial, a larger one, so that the needle's first
+// character is rare and it doesn't.
+TEST(StringSearchTest, KernelsAgree) {
+  std::mt19937 rng(1);
+  size_t alphabet = 5;
+  auto random_string = [&](size_t len) {
+    std::string s(len, 'a');
+    for (auto& c : s)
+      c = "abc\0\xff" "defghijklmnopqrstuvwxyz"[rng() % alphabet];
+    return s;
+  };
+
+  std::vector<details::SearchKernels> kernels{
+      {&details::FindByteScalar,
+       &details::FindScalar,
+       &details::RFindScalar,
+       &details::FindFirstOfScalar}};
+#ifdef __SSE2__
+  kernels.push_back({&details::FindByteSse2,
+                     &details::FindSse2,
+                     &details::RFindSse2,
+                     &details::FindFirstOfSse2});
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.push_back({&details::FindByteAvx2,
+                       &details::FindAvx2,
+                       &details::RFindAvx2,
+                       &details::FindFirstOfAvx2});
+  }
+#endif
+
+  auto to_pos = [](size_t i, size_t n) { return i == n ? npos : i; };
+  for (int trial = 0; trial < 3000; ++trial) {
+    alphabet = trial % 2 ? 5 : 28;
+    auto hay = random_string(rng() % 300);
+    std::string_view h(hay);
+    auto needle = random_string(1 + rng() % 6);
+    auto set = random_string(1 + rng() % details::kMaxSimdSetSize);
+    for (auto& k : kernels) {
+      EXPECT_EQ(to_pos(k.find_byte(h.data(), h.size(), needle[0]), h.size()),
+                h.find(needle[0]));
+      EXPECT_EQ(to_pos(k.find_first_of(h.data(), h.size(), set.data(),
+                                       set.size()),
+                       h.size()),
+                h.find_first_of(set));
+      if (needle.size() <= h.size()) {
+        EXPECT_EQ(to_pos(k.find(h.data(), h.size(), needle.data(),
+                                needle.size()),
+                         h.size()),
+                  h.find(needle))
+            << trial;
+        EXPECT_EQ(to_pos(k.rfind(h.data(), h.size(), needle.data(),
+                                 needle.size()),
+                         h.size()),
+                  h.rfind(needle))
+            << trial;
+      }
+    }
+
+    // And the public functions, with positions.
+    size_t pos = rng() % (hay.size() + 2);
+    EXPECT_EQ(Find(h, needle, pos), h.find(needle, pos));
+    EXPECT_EQ(RFind(h, needle, pos), h.rfind(needle, pos));
+    EXPECT_EQ(FindFirstOf(h, set, pos), h.find_first_of(set, pos));
+    auto big_set = random_string(20);
+    EXPECT_EQ(FindFirstOf(h, big_set, pos), h.find_first_of(big_set, pos));
+    EXPECT_EQ(FindFirstOf(cstring_view(hay), big_set, pos),
+              h.find_first_of(big_set, pos));
+  }
+}
+
+}  // namespace